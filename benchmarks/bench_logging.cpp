@@ -0,0 +1,81 @@
+#include "AsyncLogSink.h"
+#include "FileWatcher.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <easylogging++.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+INITIALIZE_EASYLOGGINGPP
+
+#define BENCH_EVENTS 200000
+
+/*! \brief the read of the watcher on a backlight change, with its debug
+ * statements
+ */
+double nsPerEvent(const std::filesystem::path &file_path, size_t events) {
+  auto mut = std::make_shared<std::mutex>();
+  auto content = std::make_shared<std::string>();
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < events; i++) {
+    if (!updateFileContent(mut, file_path, content)) {
+      return -1;
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - begin;
+  return elapsed.count() / events;
+}
+
+void report(const std::string &config, double ns) {
+  std::cout << std::left << std::setw(14) << config << std::fixed
+            << std::setprecision(1) << ns << " ns/event" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  size_t events = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 0;
+  if (events == 0) {
+    events = BENCH_EVENTS;
+  }
+  el::Loggers::addFlag(el::LoggingFlag::HierarchicalLogging);
+  el::Configurations conf;
+  conf.setToDefault();
+  conf.setGlobally(el::ConfigurationType::Format, "%datetime %level %msg");
+  conf.setGlobally(el::ConfigurationType::ToStandardOutput, "false");
+  conf.setGlobally(el::ConfigurationType::ToFile, "true");
+  conf.setGlobally(el::ConfigurationType::Filename, "/dev/null");
+  el::Loggers::reconfigureAllLoggers(conf);
+  std::filesystem::path file_path =
+      std::filesystem::temp_directory_path() /
+      ("bench_logging-" + std::to_string(getpid()));
+  std::ofstream(file_path) << "12345\n";
+
+#ifdef ELPP_DISABLE_DEBUG_LOGS
+  el::Loggers::setLoggingLevel(el::Level::Trace);
+  report("stripped", nsPerEvent(file_path, events));
+#else
+  // the daemon default, debug statements filtered at runtime
+  el::Loggers::setLoggingLevel(el::Level::Warning);
+  report("filtered", nsPerEvent(file_path, events));
+
+  el::Loggers::setLoggingLevel(el::Level::Trace);
+  report("debug sync", nsPerEvent(file_path, events));
+
+  int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  AsyncLogSink sink(null_fd);
+  sink.start();
+  report("debug async", nsPerEvent(file_path, events));
+  sink.stop();
+  std::cout << "async dropped " << sink.dropped() << " messages" << std::endl;
+  close(null_fd);
+#endif
+  std::filesystem::remove(file_path);
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include "BrightnessTargets.h"
+#include "ProfileGenerator.h"
+#include "ThreadScheduling.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <easylogging++.h>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+INITIALIZE_EASYLOGGINGPP
+
+#define BENCH_SAMPLES 2000
+#define BENCH_POST_INTERVAL std::chrono::milliseconds(2)
+
+/*! \brief wakeup latencies in us of a thread waiting on the targets like
+ * the generator stage, with the given scheduling
+ */
+std::vector<double> measure(const ThreadScheduling &scheduling,
+                            size_t samples, bool &applied) {
+  BrightnessTargets targets;
+  std::vector<double> latencies;
+  latencies.reserve(samples);
+  std::atomic_bool ready = false;
+  std::thread waiter([&]() {
+    applied = apply_thread_scheduling(scheduling);
+    ready = true;
+    while (std::optional<BrightnessTarget> target = targets.waitNext()) {
+      std::chrono::duration<double, std::micro> latency =
+          std::chrono::steady_clock::now() - target->issued;
+      latencies.push_back(latency.count());
+    }
+  });
+  while (!ready) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  for (size_t i = 0; i < samples; i++) {
+    targets.post(0, i % (BRIGHTNESS_LEVEL_SCALE + 1));
+    std::this_thread::sleep_for(BENCH_POST_INTERVAL);
+  }
+  targets.close();
+  waiter.join();
+  return latencies;
+}
+
+void report(const std::string &config, std::vector<double> latencies,
+            bool applied) {
+  std::cout << std::left << std::setw(20) << config;
+  if (!applied) {
+    std::cout << "not permitted" << std::endl;
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+    return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+  };
+  std::cout << std::fixed << std::setprecision(1) << "p50 " << percentile(0.5)
+            << " us  p99 " << percentile(0.99) << " us  max "
+            << latencies.back() << " us  (" << latencies.size()
+            << " wakeups)" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  el::Loggers::setLoggingLevel(el::Level::Error);
+  size_t samples = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 0;
+  if (samples == 0) {
+    samples = BENCH_SAMPLES;
+  }
+  std::vector<std::string> configs = {"other", "other:-10", "fifo:10"};
+  if (argc > 2) {
+    configs.assign(argv + 2, argv + argc);
+  }
+
+  ThreadScheduling idle;
+  bool applied = true;
+  report("other (idle)", measure(idle, samples, applied), applied);
+
+  // two busy threads per cpu, like a parallel compile
+  std::atomic_bool loaded = true;
+  std::vector<std::thread> load;
+  for (unsigned i = 0; i < 2 * std::thread::hardware_concurrency(); i++) {
+    load.emplace_back([&loaded]() {
+      volatile uint64_t spin = 0;
+      while (loaded) {
+        spin++;
+      }
+    });
+  }
+  for (const std::string &config : configs) {
+    std::optional<ThreadScheduling> scheduling =
+        parse_thread_scheduling(config);
+    if (!scheduling) {
+      std::cerr << "Invalid scheduling: " << config << std::endl;
+      continue;
+    }
+    std::vector<double> latencies = measure(scheduling.value(), samples,
+                                            applied);
+    report(config + " (loaded)", latencies, applied);
+  }
+  loaded = false;
+  for (std::thread &thread : load) {
+    thread.join();
+  }
+  return 0;
+}
@@ -0,0 +1,133 @@
+#ifndef AMBIENTLIGHTEVENTSOURCE_H
+
+#define AMBIENTLIGHTEVENTSOURCE_H
+
+#include "BrightnessEventSource.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#define IIO_DEVICES_DIR "/sys/bus/iio/devices"
+
+/*! \struct AmbientLightConfig
+ *  \brief mapping of the illuminance to the brightness and its filtering
+ */
+struct AmbientLightConfig {
+  double max_lux = 1000.0;      /*!< illuminance of the full brightness */
+  double min_brightness = 0.2;  /*!< brightness in the dark */
+  double smoothing = 0.3;       /*!< weight of a new sample, 1 disables it */
+  uint32_t hysteresis = 50;     /*!< level change needed for a new target */
+  std::chrono::milliseconds min_interval{250};  /*!< poll while changing */
+  std::chrono::milliseconds max_interval{4000}; /*!< poll while stable */
+};
+
+/*! \class AmbientLightFilter
+ *  \brief brightness level for the samples of an ambient light sensor
+ *
+ *  The illuminance gets mapped logarithmically, as it is perceived, and
+ * smoothed with an exponential moving average. A new level only gets
+ * reported if it differs from the last one by the hysteresis, so flicker
+ * around a threshold doesn't regenerate profiles.
+ */
+class AmbientLightFilter {
+public:
+  AmbientLightFilter(AmbientLightConfig conf = {});
+
+  /*! \brief level of an illuminance without smoothing */
+  uint32_t levelFor(double lux) const;
+
+  /*! \brief adds a sample
+   *  \return the new level, nullopt if it stays within the hysteresis
+   */
+  std::optional<uint32_t> update(double lux);
+  std::optional<uint32_t> level() const;
+
+  virtual ~AmbientLightFilter() = default;
+
+protected:
+  uint32_t levelForLog(double log_lux) const;
+
+  AmbientLightConfig _conf;
+  std::optional<double> _smoothed; /*!< average of log(1 + lux) */
+  std::optional<uint32_t> _level;  /*!< last reported level */
+};
+
+/*! \struct IioScanType
+ *  \brief layout of a channel in the buffer of an iio device
+ */
+struct IioScanType {
+  bool big_endian;
+  bool is_signed;
+  uint realbits;
+  uint storagebits;
+  uint shift;
+  uint repeat; /*!< elements per sample, the first one gets used */
+};
+
+/*! \class AmbientLightEventSource
+ *  \brief brightness targets from an iio ambient light sensor
+ *
+ *  If the sensor has a buffer and a trigger, only the illuminance channel
+ * gets enabled and the samples get read from its character device, so the
+ * sensor wakes up the daemon. Otherwise `in_illuminance_raw` gets polled,
+ * with an interval doubling up to max_interval while the illuminance is
+ * stable and falling back to min_interval once it changes. The samples
+ * pass an AmbientLightFilter and waitAndGet() reports the level in
+ * BRIGHTNESS_LEVEL_SCALE as text.
+ */
+class AmbientLightEventSource : public FdEventSource {
+public:
+  /*! \brief Constructor
+   *
+   *  \param device_dir e.g. /sys/bus/iio/devices/iio:device0
+   *  \param dev_dir directory of the character device of the sensor
+   *  \throws std::system_error if the illuminance couldn't get opened
+   */
+  AmbientLightEventSource(std::filesystem::path device_dir,
+                          AmbientLightConfig conf = {},
+                          std::filesystem::path dev_dir = "/dev") noexcept(
+      false);
+
+  /*! \brief first iio device with an illuminance channel
+   */
+  static std::optional<std::filesystem::path>
+  find(std::filesystem::path iio_dir = IIO_DEVICES_DIR);
+
+  /*! \brief parses a scan element type like `le:u16/32>>0` or
+   * `le:u16/16X2>>0` */
+  static std::optional<IioScanType> parseScanType(const std::string &type);
+
+  bool start() override;
+  std::optional<std::string> waitAndGet() override;
+  /*! \brief level of the current illuminance */
+  std::optional<std::string> readFile() override;
+  bool buffered() const;
+
+  virtual ~AmbientLightEventSource();
+
+protected:
+  /*! \brief illuminance from the sysfs attribute */
+  std::optional<double> readLux();
+  /*! \return nullopt if stopped */
+  std::optional<double> waitForSample();
+  std::optional<double> waitForPolledSample();
+  std::optional<double> waitForBufferedSample();
+  bool enableBuffer();
+  void disableBuffer();
+
+  std::filesystem::path _device_dir;
+  std::filesystem::path _chardev;
+  AmbientLightConfig _conf;
+  AmbientLightFilter _filter;
+  int _raw_fd;
+  double _scale;
+  double _offset;
+  int _buffer_fd; /*!< character device, -1 if polling */
+  IioScanType _scan_type;
+  std::chrono::milliseconds _interval; /*!< current poll interval */
+  std::optional<double> _last_lux;
+};
+
+#endif /* end of include guard: AMBIENTLIGHTEVENTSOURCE_H */
@@ -0,0 +1,95 @@
+#ifndef ASYNCLOGSINK_H
+
+#define ASYNCLOGSINK_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <easylogging++.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define ASYNC_LOG_CAPACITY 1024
+
+/*! \struct LogRecord
+ *  \brief log message waiting in the ring buffer of an AsyncLogSink
+ */
+struct LogRecord {
+  el::Level level;
+  std::chrono::system_clock::time_point time;
+  std::string message;
+};
+
+/*! \class AsyncLogSink
+ *  \brief writes the log messages of easylogging++ on its own thread
+ *
+ *  While started, it replaces the default dispatch of easylogging++: the
+ * logging threads only copy the message into a fixed ring buffer and the
+ * writer thread formats ("%datetime %level %msg") and writes it. If the
+ * writer falls behind, new messages get dropped and counted instead of
+ * blocking the logging thread. It must not get destroyed while other threads
+ * may still log.
+ *
+ *  Easylogging++ streams the arguments of LOG() into the message before it
+ * dispatches, so that part of the cost stays on the logging thread, only the
+ * line format and the write are moved.
+ */
+class AsyncLogSink {
+public:
+  /*! \brief Constructor
+   *
+   *  \param out_fd fd the messages get written to, not owned
+   *  \param capacity number of messages the ring buffer holds
+   */
+  AsyncLogSink(int out_fd = STDERR_FILENO,
+               size_t capacity = ASYNC_LOG_CAPACITY);
+
+  /*! \brief starts the writer thread and takes over the log dispatch
+   */
+  bool start();
+  /*! \brief writes the buffered messages and restores the default dispatch
+   */
+  bool stop();
+
+  /*! \brief queues a message, never blocks on the output
+   *  \return false if the ring buffer is full and the message got dropped
+   */
+  bool push(el::Level level, const std::string &message);
+  uint64_t dropped() const;
+
+  virtual ~AsyncLogSink();
+
+protected:
+  void writerThread();
+  void write(const LogRecord &record);
+
+  int _out_fd;
+  std::vector<LogRecord> _ring;
+  size_t _head;  /*!< oldest message */
+  size_t _count; /*!< messages in the ring buffer */
+  uint64_t _dropped;
+  bool _stop;
+  std::string _line; /*!< reused by the writer thread */
+  mutable std::mutex _mut;
+  std::condition_variable _cv;
+  std::thread _writer_thread;
+};
+
+/*! \class AsyncLogDispatchCallback
+ *  \brief dispatch callback of easylogging++ forwarding to an AsyncLogSink
+ */
+class AsyncLogDispatchCallback : public el::LogDispatchCallback {
+public:
+  void setSink(AsyncLogSink *sink);
+
+protected:
+  void handle(const el::LogDispatchData *data) override;
+
+  std::atomic<AsyncLogSink *> _sink{nullptr};
+};
+
+#endif /* end of include guard: ASYNCLOGSINK_H */
@@ -0,0 +1,85 @@
+#ifndef BRIGHTNESSEVENTSOURCE_H
+
+#define BRIGHTNESSEVENTSOURCE_H
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+
+#define ACTUAL_BRIGHTNESS_FILE "actual_brightness"
+
+/*! \enum event_source_kind
+ *
+ *  backends for the changes of a backlight device
+ */
+enum class event_source_kind {
+  automatic,  /*!< sysfs_poll if the device supports it, otherwise inotify */
+  inotify,    /*!< only userspace writes to `brightness` */
+  uevent,     /*!< netlink `change` uevents of the backlight subsystem */
+  sysfs_poll, /*!< poll(POLLPRI) on `actual_brightness` */
+};
+
+/*! \class BrightnessEventSource
+ *  \brief source of the brightness changes of a backlight device
+ */
+class BrightnessEventSource {
+public:
+  virtual bool start() = 0;
+
+  /*! \brief blocks until the brightness changed
+   *  \return content of the brightness attribute, nullopt if stopped
+   */
+  virtual std::optional<std::string> waitAndGet() = 0;
+
+  /*! \brief current content of the brightness attribute */
+  virtual std::optional<std::string> readFile() = 0;
+
+  /*! \brief wakes up waitAndGet() */
+  virtual bool stop() = 0;
+
+  virtual ~BrightnessEventSource() = default;
+};
+
+/*! \class FdEventSource
+ *  \brief base of the sources waiting with poll() on a file descriptor
+ *
+ *  stop() wakes up the poll through an eventfd.
+ */
+class FdEventSource : public BrightnessEventSource {
+public:
+  /*! \param attribute file with the brightness, read on every event
+   *  \throws std::system_error if the eventfd couldn't get created
+   */
+  FdEventSource(std::filesystem::path attribute) noexcept(false);
+
+  bool start() override;
+  std::optional<std::string> readFile() override;
+  bool stop() override;
+
+  virtual ~FdEventSource();
+
+protected:
+  /*! \brief waits for the events on fd
+   *  \param timeout_ms -1 waits without a timeout
+   *  \return false if stopped or on errors, true on events or the timeout
+   */
+  bool waitForEvent(int fd, short events, int timeout_ms = -1);
+
+  std::filesystem::path _attribute;
+  int _stop_fd; /*!< eventfd used to stop waiting */
+};
+
+std::optional<event_source_kind> parse_event_source_kind(const std::string &);
+
+/*! \brief creates the source of the given kind for a backlight device
+ *
+ *  \param device_dir e.g. /sys/class/backlight/intel_backlight/
+ *  \throws std::system_error or std::runtime_error if the source couldn't
+ * get created
+ */
+std::unique_ptr<BrightnessEventSource>
+make_event_source(std::filesystem::path device_dir,
+                  event_source_kind kind) noexcept(false);
+
+#endif /* end of include guard: BRIGHTNESSEVENTSOURCE_H */
@@ -0,0 +1,83 @@
+#ifndef BRIGHTNESSTARGETS_H
+
+#define BRIGHTNESSTARGETS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sys/types.h>
+
+/*! \struct BrightnessTarget
+ *  \brief requested brightness level of a display
+ */
+struct BrightnessTarget {
+  uint display_device_id;
+  uint32_t level; /*!< quantized brightness level */
+  std::chrono::steady_clock::time_point issued; /*!< time of the request */
+  uint64_t seq; /*!< of the post, counted per display from 1 */
+};
+
+/*! \class BrightnessTargets
+ *  \brief latest-value-wins mailbox between the inputs and the apply loop
+ *
+ *  Inputs (file watcher, control socket) post targets, the apply loop takes
+ * them. A target not yet taken gets replaced by a newer one for the same
+ * display, so only the latest value gets applied.
+ */
+class BrightnessTargets {
+public:
+  BrightnessTargets();
+
+  void post(uint display_device_id, uint32_t level);
+
+  /*! \brief posts the levels of several displays at once, they get taken
+   * together */
+  void postBatch(const std::map<uint, uint32_t> &levels);
+
+  /*! \brief blocks until a target is pending
+   *  \return nullopt if closed
+   */
+  std::optional<BrightnessTarget> waitNext();
+
+  /*! \brief like waitNext(), but nullopt on timeout too */
+  std::optional<BrightnessTarget> waitNextFor(std::chrono::milliseconds time);
+
+  /*! \brief sets the level of a display without posting it, e.g. the
+   * level applied on startup */
+  void setCurrent(uint display_device_id, uint32_t level);
+
+  /*! \brief last posted level of a display */
+  std::optional<uint32_t> current(uint display_device_id) const;
+
+  /*! \brief sequence number of the last post for a display, 0 if none
+   *
+   *  A target taken later carries at least this number, even if it got
+   * coalesced or its level rounded.
+   */
+  uint64_t postedSeq(uint display_device_id) const;
+
+  /*! \brief number of targets replaced before they got applied */
+  uint64_t coalesced() const;
+
+  /*! \brief wakes up all waiters, waitNext() returns nullopt afterwards */
+  void close();
+  bool closed() const;
+
+  virtual ~BrightnessTargets() = default;
+
+protected:
+  std::optional<BrightnessTarget> takeNext();
+
+  std::map<uint, BrightnessTarget> _pending;
+  std::map<uint, uint32_t> _current;
+  std::map<uint, uint64_t> _posted_seq;
+  uint64_t _coalesced;
+  bool _closed;
+  mutable std::mutex _mut;
+  std::condition_variable _cv;
+};
+
+#endif /* end of include guard: BRIGHTNESSTARGETS_H */
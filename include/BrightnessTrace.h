@@ -0,0 +1,58 @@
+#ifndef BRIGHTNESSTRACE_H
+
+#define BRIGHTNESSTRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sys/types.h>
+#include <vector>
+
+#define TRACE_MAGIC "CBTRACE"
+#define TRACE_FORMAT_VERSION 1
+
+/*! \struct TraceEvent
+ *  \brief brightness change at a time relative to the start of the trace
+ */
+struct TraceEvent {
+  std::chrono::microseconds offset;
+  uint display_device_id;
+  uint32_t level; /*!< quantized brightness level */
+};
+
+/*! \class TraceRecorder
+ *  \brief appends brightness changes to a binary trace file
+ *
+ *  The file is a header (magic, format version) followed by 8 byte records:
+ * microseconds since the previous record, display and level. Every record
+ * gets flushed, so the trace survives the daemon getting killed.
+ */
+class TraceRecorder {
+public:
+  /*! \brief Constructor, truncates the trace file and writes the header
+   *
+   *  \throws std::system_error if the file couldn't get opened
+   */
+  TraceRecorder(std::filesystem::path trace_file) noexcept(false);
+
+  void record(uint display_device_id, uint32_t level);
+  size_t recorded() const;
+
+  virtual ~TraceRecorder();
+
+protected:
+  std::ofstream _file;
+  std::chrono::steady_clock::time_point _last;
+  size_t _recorded;
+  mutable std::mutex _mut;
+};
+
+/*! \brief reads all events of a trace file
+ *
+ *  \throws std::runtime_error if the file couldn't get read or is no trace
+ */
+std::vector<TraceEvent> read_trace(std::filesystem::path trace_file);
+
+#endif /* end of include guard: BRIGHTNESSTRACE_H */
@@ -0,0 +1,80 @@
+#ifndef CIRCUITBREAKER_H
+
+#define CIRCUITBREAKER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+/*! \enum breaker_state
+ *
+ *  closed: calls pass, open: calls get rejected until the backoff elapsed,
+ * half_open: a single probe call is in flight
+ */
+enum class breaker_state { closed, open, half_open };
+
+const char *breaker_state_name(breaker_state state);
+
+/*! \struct CircuitBreakerConfig
+ *  \brief when the breaker opens and how long it stays open
+ */
+struct CircuitBreakerConfig {
+  uint timeout_threshold = 3; /*!< consecutive timeouts opening it */
+  std::chrono::milliseconds initial_backoff{500};
+  std::chrono::milliseconds max_backoff{30000};
+};
+
+/*! \struct BreakerStats
+ *  \brief state and counters of a CircuitBreaker
+ */
+struct BreakerStats {
+  breaker_state state = breaker_state::closed;
+  uint64_t timeouts = 0; /*!< all timeouts, also while closed */
+  uint64_t rejected = 0; /*!< calls not passed while open */
+  uint64_t opened = 0;
+  uint64_t probes = 0;
+  std::chrono::milliseconds backoff{0}; /*!< of the current opening */
+};
+
+/*! \class CircuitBreaker
+ *  \brief stops calls into a backend which stopped responding
+ *
+ *  Opens after a number of consecutive timeouts. Once the backoff elapsed
+ * the next call passes as a probe, a response closes the breaker, another
+ * timeout opens it again with twice the backoff (up to the maximum). Not
+ * thread-safe, the owner locks it.
+ */
+class CircuitBreaker {
+public:
+  CircuitBreaker(CircuitBreakerConfig conf = {});
+
+  /*! \brief if a call may pass now, moves an open breaker with an elapsed
+   * backoff to half_open (the call is the probe)
+   */
+  bool allow();
+  /*! \brief the call got a response, successful or not */
+  void recordResponse();
+  void recordTimeout();
+  /*! \brief the probe didn't reach the backend, the next call may probe
+   * right away
+   */
+  void releaseProbe();
+
+  breaker_state state() const;
+  /*! \brief when an open breaker lets the next probe pass */
+  std::chrono::steady_clock::time_point retryAt() const;
+  BreakerStats stats() const;
+
+  virtual ~CircuitBreaker() = default;
+
+protected:
+  void open(std::chrono::milliseconds backoff);
+
+  CircuitBreakerConfig _conf;
+  BreakerStats _stats;
+  uint _consecutive_timeouts;
+  std::chrono::steady_clock::time_point _retry_at;
+};
+
+#endif /* end of include guard: CIRCUITBREAKER_H */
@@ -2,11 +2,27 @@
 
 #define COLORDHANDLER_H
 
+#include "GHandles.h"
+#include "ProfileBackend.h"
+#include "SealedProfile.h"
+#include <chrono>
 #include <colord.h>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <lcms2.h>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CLEANUP_TIMEOUT std::chrono::milliseconds(2000)
+#define DISCOVERY_INTERVAL std::chrono::milliseconds(1000)
 
 /*! \class ColordHandler
  *  \brief wrapper for setting the brightness colord  and managing the file
@@ -14,9 +30,10 @@
  *
  *  Wrappes the colord communication to the display-device and used for
  * setting/getting the brightness and halndling the mem_fd for the temporary icc
- * file
+ * file. Profiles of different displays can get set concurrently, one update
+ * per display at a time.
  */
-class ColordHandler {
+class ColordHandler : public ProfileBackend {
 public:
   /*! \brief Constructor, initialises colord_client and memfd
    *  \param path_for_icc path used for creating the mem_fd used for the icc
@@ -29,22 +46,168 @@ public:
   // bool setDefaultProfile(std::filesystem::path edid_file_path, uint
   // display_device_id = 0);
   bool setIccFromCmsProfile(cmsHPROFILE profile, uint display_device_id = 0);
+  bool setIccFromData(const uint8_t *data, size_t size,
+                      uint display_device_id = 0) override;
+  bool discoverDisplayDevices();
+  size_t displayDeviceCount();
+  /*! \brief keeps profiles after exit, for the idle exit mode
+   *
+   *  profiles get created with the normal instead of the temporary scope and
+   * the icc gets written to icc_file instead of the memfd, so colord and the
+   * compositor can still read it after the process exited
+   */
+  bool usePersistentProfiles(std::filesystem::path icc_file);
+  /*! \brief passes every profile as a fresh SealedProfile to colord
+   *
+   *  The profiles get created with CreateProfileWithFd instead of a path
+   * into the memfd of the display, which gets rewritten by the next update.
+   * Not combinable with persistent profiles, call it before the first
+   * profile gets set.
+   */
+  bool useSealedProfiles();
+  std::optional<std::string> currentProfilePath(uint display_device_id = 0);
+  /*! \brief takes over a profile created by a previous instance
+   *  \return false for a path that isn't a D-Bus object path
+   */
+  bool adoptProfile(const std::string &object_path,
+                    uint display_device_id = 0);
+  /*! \brief deletes the persistent profiles an earlier instance left behind
+   *
+   *  Profiles of the persistent icc files not adopted by this instance, e.g.
+   * if the state file got lost. Only with persistent profiles, call it after
+   * adoptProfile().
+   *  \return number of deleted profiles
+   */
+  size_t removeOrphanedProfiles();
   bool cancelCurrentAction();
+  /*! \brief creates the cancellable of the next update, thread-safe */
+  void prepareUpdate(uint display_device_id = 0) override;
+  /*! \brief preempts the profile update in flight or the prepared one,
+   * thread-safe
+   *
+   *  The update stops at its next safe point (before the profile gets added
+   * or made default) or interrupts the colord call in flight and removes the
+   * profile it registered so far, the previous profile stays applied in
+   * colord. Without sealed profiles the icc file of the display already holds
+   * the new content, it is shared by all updates of the display. Once the new
+   * profile is default only the removal of the replaced one gets
+   * interrupted, it stays on the device but not as default.
+   */
+  bool cancelUpdate(uint display_device_id = 0) override;
   virtual ~ColordHandler();
 
 protected:
-  std::optional<CdDevice *> getDisplayDevice(uint dev_num);
-  bool makeProfileFromIccDefault(CdIcc *icc_file, uint display_device_id);
-  std::optional<CdIcc> createIccFromEdid(std::filesystem::path edid_file_path);
-  bool resetMemFd();
+  /*! \struct DisplayProfile
+   *  \brief icc file and applied profile of a display
+   */
+  struct DisplayProfile {
+    int icc_fd = -1; /*!< file descriptor for the icc file (memfd) */
+    std::filesystem::path icc_path;
+    CdProfileHandle current_profile;
+    std::unique_ptr<SealedProfile>
+        sealed_profile; /*!< of current_profile, if it was sealed */
+  };
+
+  /*! \brief icc file of a display, gets created on first use */
+  std::optional<DisplayProfile *> getDisplayProfile(uint display_device_id);
+  /*! \brief connected display device, discovers them if not cached and
+   * the last discovery is at least DISCOVERY_INTERVAL ago
+   *  \return empty handle if there is no such device
+   */
+  CdDeviceHandle getDisplayDevice(uint dev_num);
+  void clearDisplayDevices();
+  /*! \brief connects the colord client if it isn't connected */
+  bool connectClient();
+  /*! \param sealed fd of the profile, handed to the display profile once
+   * applied, nullptr to let colord open the filename of icc_file
+   */
+  bool makeProfileFromIccDefault(CdIcc *icc_file, uint display_device_id,
+                                 GCancellable *cancellable,
+                                 std::unique_ptr<SealedProfile> sealed);
+  /*! \brief registers the icc at colord, returns the profile colord
+   * already has for the content instead of creating one
+   *
+   *  A sealed profile is shared by all displays with the same content, the
+   * id of a profile reading the memfd of a display contains the display.
+   *
+   *  \param sealed reset if colord already had a profile with the content
+   *  \return with error set to cancelled the profile colord created before
+   * the cancellation arrived, if any
+   */
+  CdProfileHandle createProfile(CdIcc *icc_file, uint display_device_id,
+                                std::unique_ptr<SealedProfile> &sealed,
+                                GCancellable *cancellable, GError **error);
+  /*! \brief if this process created the profile and still tracks it */
+  bool isCreatedProfile(CdProfile *profile);
+  /*! \brief one more update or display uses the profile */
+  void holdProfile(CdProfile *profile);
+  /*! \brief the update or display doesn't use the profile anymore
+   *
+   *  \return true if it can get deleted: this process created it and
+   * neither another update nor another display uses it
+   */
+  bool releaseProfile(CdProfile *profile);
+  /*! \brief removes the profile the display showed before, releases it and
+   * deletes it if releaseProfile() allows it
+   *
+   *  \return false if it stays on the device, it's kept as leftover of the
+   * display then
+   */
+  bool removeReplacedProfile(CdDevice *display, uint display_device_id,
+                             CdProfileHandle profile,
+                             GCancellable *cancellable);
+  /*! \brief retries removing the leftovers of the display */
+  void removeLeftoverProfiles(CdDevice *display, uint display_device_id,
+                              GCancellable *cancellable);
+  /*! \brief removes a profile of a preempted update from colord, releases
+   * it and deletes it only if releaseProfile() allows it
+   *
+   *  \param added if it was already added to the display
+   */
+  void removePartialProfile(CdDevice *display, CdProfile *profile,
+                            CdProfile *current_profile, bool added);
+  /*! \brief cancellable of a cleanup call, cancelled after CLEANUP_TIMEOUT
+   * or by cancelCurrentAction()
+   *
+   *  The cleanup of an update can't use its cancellable, it could be
+   * cancelled already, and must not block on a stalled colord either.
+   */
+  GCancellableHandle cleanupCancellable();
+  /*! \brief cancels the cleanup cancellables past their timeout */
+  void cleanupTimerThread();
+  CdIccHandle createIccFromEdid(std::filesystem::path edid_file_path);
+  bool resetMemFd(int fd);
 
-  int _mem_fd; /*!< file descriptor for the icc file */
-  std::filesystem::path _mem_fd_path;
   std::filesystem::path _icc_path;
-  std::shared_ptr<CdClient> _cd_client;
-  std::shared_ptr<GCancellable>
-      _cancel_request; /*!< for future cancellation, currently unused*/
-  CdProfile* _current_profile;
+  std::optional<std::filesystem::path>
+      _persistent_icc_file; /*!< used instead of memfds if set */
+  GCancellableHandle _cancel_request; /*!< cancels all actions */
+  std::map<uint, GCancellableHandle>
+      _update_cancels;    /*!< of the last update per display */
+  std::map<uint, GCancellableHandle>
+      _prepared_cancels; /*!< of the next update per display */
+  std::mutex _update_mut; /*!< for _update_cancels */
+  std::mutex _state_mut;  /*!< for _display_profiles and _display_devices */
+  std::mutex _connect_mut;
+  CdClientHandle _cd_client;
+  std::map<uint, DisplayProfile> _display_profiles;
+  CdObjectScope _profile_scope;
+  GDBusConnectionHandle _bus; /*!< system bus, set if profiles get sealed */
+  std::set<std::string>
+      _created_profiles; /*!< object paths created by this process */
+  std::map<std::string, uint>
+      _profile_users; /*!< updates and displays using a profile */
+  std::vector<CdDeviceHandle>
+      _display_devices; /*!< cached and connected display devices */
+  std::chrono::steady_clock::time_point _last_discovery;
+  std::map<uint, std::vector<CdProfileHandle>>
+      _leftover_profiles; /*!< replaced, but their removal failed */
+  std::multimap<std::chrono::steady_clock::time_point, GCancellableHandle>
+      _cleanup_cancels; /*!< by the time they get cancelled */
+  std::mutex _cleanup_mut; /*!< for _cleanup_cancels */
+  std::condition_variable _cleanup_cv;
+  bool _stop_cleanup;
+  std::thread _cleanup_timer;
 };
 
 #endif /* end of include guard: COLORDHANDLER_H */
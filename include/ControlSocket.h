@@ -0,0 +1,75 @@
+#ifndef CONTROLSOCKET_H
+
+#define CONTROLSOCKET_H
+
+#include "BrightnessTargets.h"
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CONTROL_SOCKET_MAX_LINE 256
+#define CONTROL_SOCKET_MAX_CLIENTS 16
+
+/*! \class ControlSocket
+ *  \brief unix socket for setting the brightness of displays without a
+ * backlight
+ *
+ *  Line based protocol, brightness values in percent:
+ *  - `set <display> <percent>`
+ *  - `step <display> <delta percent>`
+ *  - `get <display>`, answered with `<display> <percent>`
+ *  - `stats`, answered with one line per stats provider
+ *
+ *  Requests can be pipelined, all requests read at once are processed as a
+ * batch and only the resulting level per display gets posted to the targets.
+ * Errors are answered with `error <message>`, e.g. for a display that is
+ * not a non-negative number.
+ */
+class ControlSocket {
+public:
+  /*! \brief Constructor, binds and listens on the socket
+   *
+   *  \throws std::system_error if the socket couldn't get created
+   */
+  ControlSocket(std::filesystem::path socket_path,
+                std::shared_ptr<BrightnessTargets> targets) noexcept(false);
+
+  /*! \brief default location of the socket in $XDG_RUNTIME_DIR
+   *  \return nullopt if $XDG_RUNTIME_DIR is not set
+   */
+  static std::optional<std::filesystem::path> defaultPath();
+
+  /*! \brief adds a source of a line for the `stats` command, only before
+   * start()
+   */
+  void addStatsProvider(std::function<std::string()> provider);
+
+  bool start();
+  bool stop();
+
+  virtual ~ControlSocket();
+
+protected:
+  void serveThread();
+  /*! \brief handles all complete lines of a client
+   *  \return false if the client should get disconnected
+   */
+  bool handleClient(int client_fd, std::string &buffer,
+                    std::map<uint, uint32_t> &batch);
+  std::optional<std::string> handleCommand(const std::string &line,
+                                           std::map<uint, uint32_t> &batch);
+
+  std::filesystem::path _socket_path;
+  std::shared_ptr<BrightnessTargets> _targets;
+  int _listen_fd;
+  int _stop_fd; /*!< eventfd used to stop the thread */
+  std::vector<std::function<std::string()>> _stats_providers;
+  std::thread _serving_thread;
+};
+
+#endif /* end of include guard: CONTROLSOCKET_H */
@@ -0,0 +1,29 @@
+#ifndef DAEMONSTATE_H
+
+#define DAEMONSTATE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+/*! \struct DaemonState
+ *  \brief state saved on an idle exit, restored on the next activation
+ */
+struct DaemonState {
+  uint32_t level; /*!< last applied quantized brightness level */
+  std::string profile_object_path; /*!< colord profile of the last level */
+};
+
+/*! \brief default location of the state file in $XDG_RUNTIME_DIR
+ *  \return nullopt if $XDG_RUNTIME_DIR is not set
+ */
+std::optional<std::filesystem::path> default_state_path();
+
+bool save_daemon_state(std::filesystem::path state_file,
+                       const DaemonState &state);
+
+/*! \brief loads and removes the state file, a state is only restored once */
+std::optional<DaemonState> load_daemon_state(std::filesystem::path state_file);
+
+#endif /* end of include guard: DAEMONSTATE_H */
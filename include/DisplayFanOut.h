@@ -0,0 +1,32 @@
+#ifndef DISPLAYFANOUT_H
+
+#define DISPLAYFANOUT_H
+
+#include <cstdint>
+#include <map>
+#include <sys/types.h>
+#include <vector>
+
+/*! \class DisplayFanOut
+ *  \brief levels of all selected displays for a backlight level
+ *
+ *  Every display gets the backlight brightness scaled by its factor (1 if
+ * not set), clamped to the brightness range. Without selected displays only
+ * the first one gets the level.
+ */
+class DisplayFanOut {
+public:
+  DisplayFanOut(std::vector<uint> displays = {},
+                std::map<uint, double> scales = {});
+
+  std::map<uint, uint32_t> levels(uint32_t backlight_level) const;
+  const std::vector<uint> &displays() const;
+
+  virtual ~DisplayFanOut() = default;
+
+protected:
+  std::vector<uint> _displays;
+  std::map<uint, double> _scales;
+};
+
+#endif /* end of include guard: DISPLAYFANOUT_H */
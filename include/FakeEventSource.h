@@ -0,0 +1,37 @@
+#ifndef FAKEEVENTSOURCE_H
+
+#define FAKEEVENTSOURCE_H
+
+#include "BrightnessEventSource.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+
+/*! \class FakeEventSource
+ *  \brief event source for tests, changes get injected
+ */
+class FakeEventSource : public BrightnessEventSource {
+public:
+  FakeEventSource(std::string content);
+
+  /*! \brief sets the content and wakes up waitAndGet() */
+  void inject(const std::string &content);
+
+  bool start() override;
+  std::optional<std::string> waitAndGet() override;
+  std::optional<std::string> readFile() override;
+  bool stop() override;
+
+  virtual ~FakeEventSource() = default;
+
+protected:
+  std::string _content;
+  std::deque<std::string> _events;
+  bool _stopped;
+  std::mutex _mut;
+  std::condition_variable _cv;
+};
+
+#endif /* end of include guard: FAKEEVENTSOURCE_H */
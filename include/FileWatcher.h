@@ -5,6 +5,7 @@
 #include <cerrno>
 #include <chrono>
 #include <condition_variable>
+#include <easylogging++.h>
 #include <filesystem>
 #include <memory>
 #include <mutex>
@@ -30,6 +31,16 @@ enum class file_watch_error {
   success = 0
 };
 
+/*! \brief reads the whole file, what the watcher delivers on a change */
+std::optional<std::string> getFileContent(std::filesystem::path file_path);
+
+/*! \brief reads the file into changed_file_content while holding mut
+ *  \return false if the file couldn't get read, the content is kept then
+ */
+bool updateFileContent(std::shared_ptr<std::mutex> mut,
+                       std::filesystem::path file_path,
+                       std::shared_ptr<std::string> changed_file_content);
+
 /*! \class FileWatcher
  *  \brief Asynchronous watcher for file changes
  *
@@ -60,7 +71,7 @@ public:
   // not blocking, optional
   std::optional<std::string> getWhenChanged();
 
-  // optional or needed?
+  // blocking with timeout, nullopt on timeout
   template <class Rep, class Period>
   std::optional<std::string>
   waitForAndGet(std::chrono::duration<Rep, Period> time);
@@ -87,4 +98,26 @@ protected:
   std::thread _watching_thread;
 };
 
+template <class Rep, class Period>
+std::optional<std::string>
+FileWatcher::waitForAndGet(std::chrono::duration<Rep, Period> time) {
+  if (*_watching) {
+    std::unique_lock<std::mutex> lk(*_cv_mut);
+    auto time_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(time).count();
+    LOG(DEBUG) << "Waiting " << time_ms << " ms for event from Filewatcher ...";
+    std::cv_status changed = _notify_waiter_cv->wait_for(lk, time);
+    if (changed == std::cv_status::no_timeout) {
+      return *_changed_file_content;
+    } else {
+      LOG(DEBUG) << "Timeout after waiting " << time_ms
+                 << " ms for a file-change.";
+      return std::nullopt;
+    }
+  } else {
+    LOG(WARNING) << "Filewatcher is not running!";
+    return std::nullopt;
+  }
+}
+
 #endif /* end of include guard: FILEWATCHER_H */
@@ -0,0 +1,50 @@
+#ifndef GHANDLES_H
+
+#define GHANDLES_H
+
+#include "UniqueHandle.h"
+#include <colord.h>
+
+struct GObjectDeleter {
+  void operator()(gpointer object) const { g_object_unref(object); }
+};
+struct GErrorDeleter {
+  void operator()(GError *error) const { g_error_free(error); }
+};
+struct GPtrArrayDeleter {
+  void operator()(GPtrArray *array) const { g_ptr_array_unref(array); }
+};
+struct GBytesDeleter {
+  void operator()(GBytes *bytes) const { g_bytes_unref(bytes); }
+};
+struct GHashTableDeleter {
+  void operator()(GHashTable *table) const { g_hash_table_unref(table); }
+};
+struct GVariantDeleter {
+  void operator()(GVariant *variant) const { g_variant_unref(variant); }
+};
+
+template <class T> using GObjectHandle = UniqueHandle<T *, GObjectDeleter>;
+
+using CdClientHandle = GObjectHandle<CdClient>;
+using CdDeviceHandle = GObjectHandle<CdDevice>;
+using CdProfileHandle = GObjectHandle<CdProfile>;
+using CdIccHandle = GObjectHandle<CdIcc>;
+using CdEdidHandle = GObjectHandle<CdEdid>;
+using GFileHandle = GObjectHandle<GFile>;
+using GCancellableHandle = GObjectHandle<GCancellable>;
+using GDBusConnectionHandle = GObjectHandle<GDBusConnection>;
+using GUnixFDListHandle = GObjectHandle<GUnixFDList>;
+/*! use out() as GError** out-parameter */
+using GErrorHandle = UniqueHandle<GError *, GErrorDeleter>;
+using GPtrArrayHandle = UniqueHandle<GPtrArray *, GPtrArrayDeleter>;
+using GBytesHandle = UniqueHandle<GBytes *, GBytesDeleter>;
+using GHashTableHandle = UniqueHandle<GHashTable *, GHashTableDeleter>;
+using GVariantHandle = UniqueHandle<GVariant *, GVariantDeleter>;
+
+/*! \brief takes an additional reference of a GObject */
+template <class T> GObjectHandle<T> g_object_ref_handle(T *object) {
+  return GObjectHandle<T>(static_cast<T *>(g_object_ref(object)));
+}
+
+#endif /* end of include guard: GHANDLES_H */
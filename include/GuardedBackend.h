@@ -0,0 +1,105 @@
+#ifndef GUARDEDBACKEND_H
+
+#define GUARDEDBACKEND_H
+
+#include "CircuitBreaker.h"
+#include "ProfileBackend.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_APPLY_TIMEOUT std::chrono::milliseconds(2000)
+
+/*! \struct GuardStats
+ *  \brief breaker and pending profiles of a GuardedBackend
+ */
+struct GuardStats {
+  BreakerStats breaker;
+  size_t pending = 0;     /*!< displays with a profile not applied yet */
+  uint64_t recovered = 0; /*!< pending profiles applied later */
+};
+
+/*! \class GuardedBackend
+ *  \brief deadline per call and a circuit breaker in front of a backend,
+ * e.g. colord stalled by a session switch
+ *
+ *  A call running past the deadline gets cancelled through
+ * ProfileBackend::cancelUpdate() and counts as timeout right away. After
+ * repeated timeouts the breaker opens and calls return false right away, so
+ * the apply stage keeps taking the latest targets instead of blocking. A
+ * call for a display whose timed out call didn't return yet doesn't wait
+ * for it either, its profile is kept.
+ *
+ *  The profile of a timed out or rejected call is kept, one per display
+ * (latest value wins), and a supervisor thread applies it once the backend
+ * responds again: it probes with the kept profiles after the backoff of the
+ * breaker. A newer call for a display replaces its kept profile.
+ */
+class GuardedBackend : public ProfileBackend {
+public:
+  /*! \param backend has to support cancelUpdate(), a call it can't cancel
+   * only gets counted as timeout when it returns
+   */
+  GuardedBackend(std::shared_ptr<ProfileBackend> backend,
+                 std::chrono::milliseconds deadline = DEFAULT_APPLY_TIMEOUT,
+                 CircuitBreakerConfig breaker_conf = {});
+  GuardedBackend(const GuardedBackend &) = delete;
+  GuardedBackend &operator=(const GuardedBackend &) = delete;
+
+  bool setIccFromData(const uint8_t *data, size_t size,
+                      uint display_device_id = 0) override;
+  /*! \brief a cancelUpdate() before the call reaches the backend makes it
+   * return false right away
+   */
+  void prepareUpdate(uint display_device_id = 0) override;
+  bool cancelUpdate(uint display_device_id = 0) override;
+
+  GuardStats stats() const;
+  std::string statsString() const;
+
+  virtual ~GuardedBackend();
+
+protected:
+  /*! \brief calls the backend with the deadline, waits for another call of
+   * the display in flight (cancelling it), prepares the backend for it
+   *
+   *  Keeps the profile as pending instead if the call in flight already
+   * timed out, or if it was the probe of a half_open breaker and got
+   * preempted before it started.
+   */
+  bool apply(const uint8_t *data, size_t size, uint display_device_id,
+             std::unique_lock<std::mutex> &lk);
+  /*! \brief cancels the calls past their deadline and applies the pending
+   * profiles on the recovery thread once the breaker lets them pass
+   */
+  void superviseThread();
+
+  std::shared_ptr<ProfileBackend> _backend;
+  std::chrono::milliseconds _deadline;
+  CircuitBreaker _breaker;
+  std::map<uint, std::chrono::steady_clock::time_point>
+      _in_flight; /*!< deadlines of the calls in flight */
+  std::set<uint> _timed_out;  /*!< in flight, cancelled by the deadline */
+  std::set<uint> _superseded; /*!< in flight, cancelled by a newer call */
+  std::set<uint> _prepared;   /*!< announced, not at the backend yet */
+  std::set<uint> _preempted;  /*!< prepared, cancelled before they started */
+  std::map<uint, std::vector<uint8_t>> _pending; /*!< not applied yet */
+  uint64_t _recovered;
+  bool _recovering; /*!< a pending profile gets applied by _recovery */
+  bool _stop;
+  mutable std::mutex _mut;
+  std::condition_variable _cv;
+  std::thread _recovery;
+  std::thread _supervisor;
+};
+
+#endif /* end of include guard: GUARDEDBACKEND_H */
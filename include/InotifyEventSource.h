@@ -0,0 +1,33 @@
+#ifndef INOTIFYEVENTSOURCE_H
+
+#define INOTIFYEVENTSOURCE_H
+
+#include "BrightnessEventSource.h"
+#include "FileWatcher.h"
+#include <filesystem>
+#include <optional>
+#include <string>
+
+/*! \class InotifyEventSource
+ *  \brief brightness changes from a FileWatcher
+ *
+ *  inotify only reports writes from userspace, changes by the firmware or
+ * the kernel (e.g. hotkeys handled by ACPI) are missed.
+ */
+class InotifyEventSource : public BrightnessEventSource {
+public:
+  /*! \throws see FileWatcher::FileWatcher() */
+  InotifyEventSource(std::filesystem::path brightness_file) noexcept(false);
+
+  bool start() override;
+  std::optional<std::string> waitAndGet() override;
+  std::optional<std::string> readFile() override;
+  bool stop() override;
+
+  virtual ~InotifyEventSource() = default;
+
+protected:
+  FileWatcher _file_watcher;
+};
+
+#endif /* end of include guard: INOTIFYEVENTSOURCE_H */
@@ -0,0 +1,28 @@
+#ifndef LCMSHANDLES_H
+
+#define LCMSHANDLES_H
+
+#include "UniqueHandle.h"
+#include <lcms2.h>
+
+struct CmsProfileDeleter {
+  void operator()(cmsHPROFILE profile) const { cmsCloseProfile(profile); }
+};
+struct CmsContextDeleter {
+  void operator()(cmsContext context) const { cmsDeleteContext(context); }
+};
+struct CmsToneCurveDeleter {
+  void operator()(cmsToneCurve *curve) const { cmsFreeToneCurve(curve); }
+};
+struct CmsMLUDeleter {
+  void operator()(cmsMLU *mlu) const { cmsMLUfree(mlu); }
+};
+
+/*! profile handle, has to be destroyed before the context it was created in
+ */
+using CmsProfileHandle = UniqueHandle<cmsHPROFILE, CmsProfileDeleter>;
+using CmsContextHandle = UniqueHandle<cmsContext, CmsContextDeleter>;
+using CmsToneCurveHandle = UniqueHandle<cmsToneCurve *, CmsToneCurveDeleter>;
+using CmsMLUHandle = UniqueHandle<cmsMLU *, CmsMLUDeleter>;
+
+#endif /* end of include guard: LCMSHANDLES_H */
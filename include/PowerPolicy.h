@@ -0,0 +1,81 @@
+#ifndef POWERPOLICY_H
+
+#define POWERPOLICY_H
+
+#include "ProfilePrefetcher.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+
+/*! \struct UpdatePolicy
+ *  \brief how eagerly brightness changes get turned into profiles
+ */
+struct UpdatePolicy {
+  std::string name;
+  std::chrono::milliseconds min_interval; /*!< between updates, 0 unpaced */
+  uint32_t level_step; /*!< levels get rounded to multiples of it */
+  uint prefetch_depth;
+};
+
+/*! every level as soon as possible */
+#define AC_UPDATE_POLICY                                                      \
+  { "ac", std::chrono::milliseconds(0), 1, DEFAULT_PREFETCH_DEPTH }
+/*! at most 5 updates per second in steps of 1 % */
+#define BATTERY_UPDATE_POLICY                                                 \
+  { "battery", std::chrono::milliseconds(200), 10, 1 }
+
+/*! \struct PolicyStats
+ *  \brief updates while a policy was active
+ */
+struct PolicyStats {
+  double active_s = 0.0;
+  uint64_t updates = 0;
+};
+
+/*! \class PowerPolicy
+ *  \brief switches the update policy between external power and battery
+ *
+ *  On battery every colord round trip and profile generation costs wakeups
+ * and energy, so fewer updates get applied (paced, coarser levels and less
+ * prefetching), on external power every change gets applied. The applied
+ * updates get counted per policy, so the effect on the updates per minute
+ * can be reported.
+ */
+class PowerPolicy {
+public:
+  PowerPolicy(UpdatePolicy ac = AC_UPDATE_POLICY,
+              UpdatePolicy battery = BATTERY_UPDATE_POLICY);
+
+  /*! \brief called with the policy on every switch, and once with the
+   * current one when it gets set
+   */
+  void setApplyCallback(std::function<void(const UpdatePolicy &)> callback);
+
+  /*! \return true if the policy changed */
+  bool setOnBattery(bool on_battery);
+  bool onBattery() const;
+  UpdatePolicy current() const;
+
+  /*! \brief counts an applied update for the active policy, thread-safe */
+  void countUpdate();
+
+  /*! \brief index 0 on external power, 1 on battery */
+  std::array<PolicyStats, 2> stats() const;
+  std::string statsString() const;
+
+  virtual ~PowerPolicy() = default;
+
+protected:
+  std::array<UpdatePolicy, 2> _policies;
+  std::function<void(const UpdatePolicy &)> _apply_callback;
+  bool _on_battery;
+  std::array<PolicyStats, 2> _stats;
+  std::chrono::steady_clock::time_point _switched; /*!< to the active one */
+  mutable std::mutex _mut;
+};
+
+#endif /* end of include guard: POWERPOLICY_H */
@@ -0,0 +1,46 @@
+#ifndef POWERSUPPLYEVENTSOURCE_H
+
+#define POWERSUPPLYEVENTSOURCE_H
+
+#include "UeventEventSource.h"
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#define POWER_SUPPLY_DIR "/sys/class/power_supply"
+
+/*! \class PowerSupplyEventSource
+ *  \brief changes between external power and battery
+ *
+ *  The kernel doesn't notify the `online` attributes through sysfs (so
+ * neither poll nor inotify see them), but sends a `change` uevent of the
+ * power_supply subsystem on every change of a supply. The supplies get read
+ * again on every such uevent, waitAndGet() and readFile() report "1\n" on
+ * external power and "0\n" on battery.
+ */
+class PowerSupplyEventSource : public UeventEventSource {
+public:
+  /*! \throws std::system_error if the netlink socket couldn't get created
+   */
+  PowerSupplyEventSource(std::filesystem::path power_supply_dir =
+                             POWER_SUPPLY_DIR) noexcept(false);
+
+  /*! \brief takes ownership of a datagram socket delivering uevents, e.g.
+   * one end of a socketpair in tests
+   */
+  PowerSupplyEventSource(std::filesystem::path power_supply_dir,
+                         int uevent_fd) noexcept(false);
+
+  /*! \brief if any external supply (mains, usb) is online
+   *
+   *  Without external supplies it is on battery only if a battery is
+   * discharging, e.g. a desktop without any supply is on external power.
+   */
+  static bool onExternalPower(std::filesystem::path power_supply_dir);
+
+  std::optional<std::string> readFile() override;
+
+  virtual ~PowerSupplyEventSource() = default;
+};
+
+#endif /* end of include guard: POWERSUPPLYEVENTSOURCE_H */
@@ -0,0 +1,42 @@
+#ifndef PROFILEAPPLIER_H
+
+#define PROFILEAPPLIER_H
+
+#include "ProfileAtlas.h"
+#include "ProfileBackend.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+/*! \class ProfileApplier
+ *  \brief gets the profile for a brightness level and applies it
+ *
+ *  Serves profiles from the atlas if cached, otherwise they get generated and
+ * added to the atlas. Works without an atlas.
+ */
+class ProfileApplier {
+public:
+  ProfileApplier(std::shared_ptr<ProfileBackend> backend,
+                 std::shared_ptr<ProfileAtlas> atlas);
+
+  /*! \brief profile data for a quantized brightness level
+   *
+   *  \param storage used for generated profiles not in the atlas
+   *  \return blob pointing into the atlas or into storage
+   */
+  std::optional<ProfileBlob> prepare(uint32_t level,
+                                     std::vector<uint8_t> &storage);
+  bool apply(uint32_t level, uint display_device_id = 0);
+
+  std::shared_ptr<ProfileBackend> backend() const;
+  std::shared_ptr<ProfileAtlas> atlas() const;
+
+  virtual ~ProfileApplier() = default;
+
+protected:
+  std::shared_ptr<ProfileBackend> _backend;
+  std::shared_ptr<ProfileAtlas> _atlas; /*!< optional */
+};
+
+#endif /* end of include guard: PROFILEAPPLIER_H */
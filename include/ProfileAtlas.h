@@ -0,0 +1,81 @@
+#ifndef PROFILEATLAS_H
+
+#define PROFILEATLAS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#define ATLAS_FORMAT_VERSION 1
+#define ATLAS_INDEX_CAPACITY 4096
+#define ATLAS_MAX_SIZE (64u << 20) /*!< size of the read-only mapping */
+
+/*! \struct ProfileBlob
+ *  \brief serialized icc profile inside the mapping of a ProfileAtlas
+ *
+ *  valid as long as the ProfileAtlas exists, the mapping never moves
+ */
+struct ProfileBlob {
+  const uint8_t *data;
+  size_t size;
+};
+
+/*! \class ProfileAtlas
+ *  \brief persistent cache of serialized icc profiles
+ *
+ *  A single versioned file (header, index by base profile and quantized
+ * level, concatenated icc blobs) which is mapped read-only, so cached
+ * profiles can get served without copying or regenerating them. New profiles
+ * get appended with pwrite and become visible through the same mapping. A
+ * corrupted or outdated atlas gets truncated and rebuilt.
+ */
+class ProfileAtlas {
+public:
+  /*! \brief Constructor, opens (or creates) and validates the atlas file
+   *
+   *  \param atlas_file path of the atlas, parent directory gets created
+   *  \throws std::system_error if the file couldn't get opened, locked or
+   * mapped
+   */
+  ProfileAtlas(std::filesystem::path atlas_file) noexcept(false);
+
+  /*! \brief atlas in an anonymous memfd, lives only as long as the process
+   *
+   *  \throws std::system_error if the memfd couldn't get created or mapped
+   */
+  static std::unique_ptr<ProfileAtlas> inMemory() noexcept(false);
+
+  /*! \brief default location of the atlas in $XDG_RUNTIME_DIR
+   *  \return nullopt if $XDG_RUNTIME_DIR is not set
+   */
+  static std::optional<std::filesystem::path> defaultPath();
+
+  std::optional<ProfileBlob> find(uint32_t base_id, uint32_t level) const;
+  bool insert(uint32_t base_id, uint32_t level, const uint8_t *data,
+              size_t size);
+  size_t size() const;
+
+  virtual ~ProfileAtlas();
+
+protected:
+  /*! \brief takes ownership of the already opened fd, closed on errors
+   */
+  ProfileAtlas(std::filesystem::path name, int fd) noexcept(false);
+
+  bool validate();
+  bool rebuild();
+
+  std::filesystem::path _path;
+  int _fd;             /*!< read/write fd of the atlas, used for appending */
+  const uint8_t *_map; /*!< read-only mapping of ATLAS_MAX_SIZE bytes */
+  uint32_t _entry_count;
+  uint64_t _data_end; /*!< end of the last blob, offset for the next one */
+  std::unordered_map<uint64_t, ProfileBlob> _index;
+  mutable std::mutex _mut;
+};
+
+#endif /* end of include guard: PROFILEATLAS_H */
@@ -0,0 +1,39 @@
+#ifndef PROFILEBACKEND_H
+
+#define PROFILEBACKEND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+/*! \class ProfileBackend
+ *  \brief output for serialized icc profiles, e.g. colord
+ */
+class ProfileBackend {
+public:
+  /*! \brief applies the icc profile to a display
+   *
+   *  \param data serialized icc profile, only valid during the call
+   *  \return false if the profile couldn't get applied
+   */
+  virtual bool setIccFromData(const uint8_t *data, size_t size,
+                              uint display_device_id = 0) = 0;
+
+  /*! \brief announces the next setIccFromData() call for a display, so a
+   * cancelUpdate() arriving before the call starts preempts it
+   *
+   *  Called by a caller which may preempt the call, before it considers the
+   * call in flight.
+   */
+  virtual void prepareUpdate(uint display_device_id = 0) {}
+
+  /*! \brief preempts the setIccFromData() call in flight for a display, or
+   * the prepared one, e.g. from another thread when a newer profile is ready
+   *
+   *  \return false if the backend doesn't support it
+   */
+  virtual bool cancelUpdate(uint display_device_id = 0) { return false; }
+  virtual ~ProfileBackend() = default;
+};
+
+#endif /* end of include guard: PROFILEBACKEND_H */
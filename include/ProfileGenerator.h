@@ -0,0 +1,62 @@
+#ifndef PROFILEGENERATOR_H
+
+#define PROFILEGENERATOR_H
+
+#include "LcmsHandles.h"
+#include <cstdint>
+#include <lcms2.h>
+#include <vector>
+
+/*! number of quantized brightness levels between 0 and 1, a level is the
+ * brightness in permille */
+#define BRIGHTNESS_LEVEL_SCALE 1000
+
+/*! bumped on every change of the generated profiles, invalidates cached
+ * profiles (e.g. in the ProfileAtlas) */
+#define PROFILE_GENERATOR_VERSION 1
+
+/*! id of the sRGB base profile, currently used for all displays ('sRGB') */
+#define SRGB_BASE_PROFILE_ID 0x73524742u
+
+/*! \brief creates a sRGB profile with the brightness applied to the vcgt
+ *
+ *  \param brightness brightness between 0 and 1, gets clamped to [0.1, 1]
+ *  \param context lcms2 context, has to outlive the profile, NULL for the
+ * global context
+ *  \return lcms2 profile handle, empty on failure
+ */
+CmsProfileHandle create_srgb_profile(double brightness,
+                                     cmsContext context = NULL);
+
+/*! \brief creates and serializes a sRGB profile in its own lcms2 context
+ *
+ *  \return icc data, empty on failure
+ */
+std::vector<uint8_t> generate_srgb_profile_data(double brightness);
+
+/*! \brief serializes a lcms2 profile into a icc blob
+ *
+ *  recomputes the profile id (md5) before serializing
+ *
+ *  \return icc data, empty if the profile couldn't get serialized
+ */
+std::vector<uint8_t> serialize_profile(cmsHPROFILE profile);
+
+/*! \brief quantizes a relative brightness to a level in
+ * [0, BRIGHTNESS_LEVEL_SCALE]
+ */
+uint32_t quantize_brightness(double brightness);
+
+/*! \brief relative brightness of a quantized level */
+double level_to_brightness(uint32_t level);
+
+/*! \brief rounds a level to the nearest multiple of step, so fewer distinct
+ * profiles get generated
+ *
+ *  \param step 0 and 1 keep the level
+ *  \return level in [0, BRIGHTNESS_LEVEL_SCALE], the full brightness stays
+ * reachable
+ */
+uint32_t round_level(uint32_t level, uint32_t step);
+
+#endif /* end of include guard: PROFILEGENERATOR_H */
@@ -0,0 +1,171 @@
+#ifndef PROFILEPIPELINE_H
+
+#define PROFILEPIPELINE_H
+
+#include "BrightnessTargets.h"
+#include "ProfileApplier.h"
+#include "ProfilePrefetcher.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <semaphore.h>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define PIPELINE_MAX_DISPLAYS 16
+
+/*! \struct PreparedProfile
+ *  \brief serialized profile of a target, handed from generator to apply
+ * stage
+ */
+struct PreparedProfile {
+  BrightnessTarget target;
+  std::vector<uint8_t> storage; /*!< data of generated profiles */
+  ProfileBlob blob;             /*!< into the atlas or storage */
+};
+
+/*! \struct DisplayApplyStats
+ *  \brief apply times of a display
+ */
+struct DisplayApplyStats {
+  uint64_t applied = 0;
+  double last_ms = 0.0;
+  double max_ms = 0.0;
+  double total_ms = 0.0;
+};
+
+/*! \struct PipelineStats
+ *  \brief busy time of the stages relative to the runtime
+ */
+struct PipelineStats {
+  double generate_utilization; /*!< 0..1 */
+  double apply_utilization;    /*!< 0..1 */
+  uint64_t generated;
+  uint64_t applied;
+  uint64_t dropped;   /*!< replaced in the slot before they got applied */
+  uint64_t preempted; /*!< cancelled while being applied */
+  std::map<uint, DisplayApplyStats> displays;
+};
+
+/*! \class ProfilePipeline
+ *  \brief two-stage pipeline, the next profile gets generated while colord
+ * applies the current one
+ *
+ *  The generator stage takes targets, serializes their profiles and
+ * publishes them in a lock-free slot per display. The apply stage submits
+ * them to the backend. A profile not yet taken by the apply stage gets
+ * replaced by a newer one for the same display (latest value wins), a
+ * profile being applied gets preempted through ProfileBackend::cancelUpdate(),
+ * so the newer one gets applied after at most one apply time.
+ *
+ *  Targets posted together get published together, the apply stage applies
+ * the profiles of different displays concurrently.
+ */
+class ProfilePipeline {
+public:
+  /*! \param prefetcher optional, gets every target before it is generated
+   *  \throws std::system_error if the semaphore couldn't get created
+   */
+  ProfilePipeline(std::shared_ptr<ProfileApplier> applier,
+                  std::shared_ptr<BrightnessTargets> targets,
+                  std::shared_ptr<ProfilePrefetcher> prefetcher =
+                      nullptr) noexcept(false);
+
+  /*! \brief runs the generator stage on a thread and the apply stage on the
+   * calling thread until the targets get closed
+   *
+   *  The apply stage hands the profiles to a worker thread per display,
+   * started on the first profile of the display. The stages and the workers
+   * take the scheduling of thread_role::generator and thread_role::apply,
+   * see set_thread_scheduling().
+   *
+   *  \param last_level level of the first display applied on startup
+   *  \param idle_exit returns after this time without a brightness change
+   *  \return last applied level of the first display
+   */
+  uint32_t run(uint32_t last_level,
+               std::optional<std::chrono::seconds> idle_exit = std::nullopt);
+
+  /*! \brief called by the apply stage after every applied target, only
+   * before run(), called concurrently
+   *
+   *  A target whose profile couldn't get generated gets reported by the
+   * generator stage with applied false.
+   */
+  void setAppliedCallback(
+      std::function<void(const BrightnessTarget &, bool)> callback);
+
+  /*! \brief minimum time between generated batches, targets posted in the
+   * meantime replace each other, 0 disables the pacing; thread-safe
+   */
+  void setMinInterval(std::chrono::milliseconds interval);
+
+  /*! \brief levels get rounded with round_level() before generating, 1
+   * keeps them; thread-safe
+   */
+  void setLevelStep(uint32_t step);
+
+  PipelineStats stats() const;
+  std::string statsString() const;
+
+  virtual ~ProfilePipeline();
+
+protected:
+  void generateStage(std::optional<std::chrono::seconds> idle_exit);
+  /*! \brief publishes into the slots of the displays, latest value wins */
+  void publish(std::vector<std::unique_ptr<PreparedProfile>> prepared_batch);
+  /*! \struct ApplyWorker
+   *  \brief thread applying the profiles of one display
+   */
+  struct ApplyWorker {
+    std::thread thread;
+    PreparedProfile *prepared = nullptr; /*!< of the current round */
+    bool applied = false;                /*!< result of the last round */
+  };
+
+  /*! \brief applies on the calling thread, called concurrently for
+   * different displays
+   */
+  bool applyPrepared(PreparedProfile &prepared);
+  /*! \brief applies the profiles handed over by run() until it stops */
+  void applyWorker(ApplyWorker &worker);
+
+  std::shared_ptr<ProfileApplier> _applier;
+  std::shared_ptr<BrightnessTargets> _targets;
+  std::shared_ptr<ProfilePrefetcher> _prefetcher;
+  std::function<void(const BrightnessTarget &, bool)> _applied_callback;
+  std::array<std::atomic<PreparedProfile *>, PIPELINE_MAX_DISPLAYS> _slots;
+  sem_t _published; /*!< posted on every publish and at the end */
+  std::atomic<bool> _generator_done;
+  std::atomic<uint64_t> _generate_busy_ns;
+  std::atomic<uint64_t> _apply_busy_ns;
+  std::atomic<uint64_t> _generated;
+  std::atomic<uint64_t> _applied;
+  std::atomic<uint64_t> _dropped;
+  std::atomic<uint64_t> _preempted;
+  std::set<uint> _in_flight;         /*!< displays being applied */
+  std::set<uint> _preempt_requested; /*!< for the updates in flight */
+  std::mutex _in_flight_mut;
+  std::map<uint, DisplayApplyStats> _display_stats;
+  mutable std::mutex _stats_mut; /*!< for _display_stats */
+  std::atomic<int64_t> _started_ns; /*!< steady clock, 0 if not running */
+  std::atomic<int64_t> _stopped_ns;
+  std::atomic<int64_t> _min_interval_ns;
+  std::atomic<uint32_t> _level_step;
+  std::array<std::unique_ptr<ApplyWorker>, PIPELINE_MAX_DISPLAYS> _workers;
+  size_t _round_pending; /*!< profiles of the round not applied yet */
+  bool _stop_workers;
+  std::mutex _round_mut; /*!< for the workers and _round_pending */
+  std::condition_variable _round_cv;
+};
+
+#endif /* end of include guard: PROFILEPIPELINE_H */
@@ -0,0 +1,74 @@
+#ifndef PROFILEPREFETCHER_H
+
+#define PROFILEPREFETCHER_H
+
+#include "ProfileApplier.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#define PREFETCH_HISTORY_SIZE 3
+#define DEFAULT_PREFETCH_DEPTH 3
+
+/*! \struct PrefetchStats
+ *  \brief counters for tuning the prefetch depth
+ */
+struct PrefetchStats {
+  uint64_t observed;   /*!< applied levels */
+  uint64_t prefetched; /*!< profiles generated ahead of time */
+  uint64_t hits;       /*!< applied levels which were prefetched */
+  uint64_t wasted;     /*!< prefetched profiles not used (yet) */
+  double wasted_ms;    /*!< generation time of the wasted profiles */
+};
+
+/*! \class ProfilePrefetcher
+ *  \brief generates the profiles of the expected next brightness levels
+ *
+ *  Brightness keys move in one direction with a fixed step. If the last
+ * levels of a display have the same step, the profiles of the next levels in
+ * this direction get generated on a background thread and added to the atlas,
+ * so the next change only has to be applied.
+ */
+class ProfilePrefetcher {
+public:
+  /*! \param depth number of levels generated ahead, 0 disables prefetching
+   */
+  ProfilePrefetcher(std::shared_ptr<ProfileApplier> applier, uint depth);
+
+  bool start();
+  bool stop();
+
+  /*! \brief records an applied level and prefetches the expected next ones
+   */
+  void observe(uint display_device_id, uint32_t level);
+
+  void setDepth(uint depth);
+  PrefetchStats stats() const;
+  std::string statsString() const;
+
+  virtual ~ProfilePrefetcher();
+
+protected:
+  void prefetchThread();
+
+  std::shared_ptr<ProfileApplier> _applier;
+  uint _depth;
+  std::map<uint, std::deque<uint32_t>> _history; /*!< last levels per display */
+  std::deque<uint32_t> _queue; /*!< levels to generate, latest prediction */
+  std::map<uint32_t, double>
+      _unused; /*!< prefetched levels not applied yet, generation time */
+  PrefetchStats _stats;
+  bool _running;
+  mutable std::mutex _mut;
+  std::condition_variable _cv;
+  std::thread _prefetch_thread;
+};
+
+#endif /* end of include guard: PROFILEPREFETCHER_H */
@@ -0,0 +1,17 @@
+#ifndef SDNOTIFY_H
+
+#define SDNOTIFY_H
+
+#include <string>
+
+/*! \brief sends a state to the service manager (sd_notify protocol)
+ *
+ *  minimal implementation of sd_notify(3) without linking libsystemd, sends
+ * the state as datagram to the socket in $NOTIFY_SOCKET
+ *
+ *  \param state newline separated assignments, e.g. "READY=1"
+ *  \return false if not started by systemd or the state couldn't get sent
+ */
+bool sdNotify(const std::string &state);
+
+#endif /* end of include guard: SDNOTIFY_H */
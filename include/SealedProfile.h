@@ -0,0 +1,65 @@
+#ifndef SEALEDPROFILE_H
+
+#define SEALEDPROFILE_H
+
+#include <colord.h>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+/*! seals of a SealedProfile, the content can't change anymore */
+#define SEALED_PROFILE_SEALS                                                  \
+  (F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+/*! \class SealedProfile
+ *  \brief icc profile in a fresh memfd, sealed against any modification
+ *
+ *  colord gets the fd itself, so it neither resolves a path into this
+ * process nor sees a profile half rewritten by the next update. The fd stays
+ * open as long as the profile is applied, its /proc path is still set as
+ * the filename for clients of colord reading the profile by path.
+ */
+class SealedProfile {
+public:
+  /*! \brief Constructor, writes and seals the profile
+   *
+   *  \param name of the memfd, only for debugging
+   *  \throws std::system_error if the memfd couldn't get created, written
+   * or sealed
+   */
+  SealedProfile(const std::string &name, const uint8_t *data,
+                size_t size) noexcept(false);
+  SealedProfile(const SealedProfile &) = delete;
+  SealedProfile &operator=(const SealedProfile &) = delete;
+
+  int fd() const;
+  /*! \brief /proc/<pid>/fd/<fd> */
+  std::filesystem::path path() const;
+
+  virtual ~SealedProfile();
+
+protected:
+  int _fd;
+};
+
+/*! \brief creates a colord profile from a fd, with the CreateProfileWithFd
+ * method of the ColorManager
+ *
+ *  The fd gets passed as unix fd over D-Bus, colord reads the profile from
+ * the fd instead of opening the filename.
+ *
+ *  \param connection to the bus of colord, the system bus
+ *  \param profile_id e.g. "icc-<checksum>"
+ *  \param filename Filename property of the profile
+ *  \return object path of the profile, nullopt on errors (error is set)
+ */
+std::optional<std::string>
+create_profile_with_fd(GDBusConnection *connection,
+                       const std::string &profile_id, CdObjectScope scope,
+                       int fd, const std::filesystem::path &filename,
+                       GCancellable *cancellable, GError **error);
+
+#endif /* end of include guard: SEALEDPROFILE_H */
@@ -0,0 +1,34 @@
+#ifndef SYSFSPOLLEVENTSOURCE_H
+
+#define SYSFSPOLLEVENTSOURCE_H
+
+#include "BrightnessEventSource.h"
+#include <filesystem>
+#include <optional>
+#include <string>
+
+/*! \class SysfsPollEventSource
+ *  \brief brightness changes from poll(POLLPRI) on a sysfs attribute
+ *
+ *  The backlight core notifies `actual_brightness` on every change, from
+ * userspace as well as from the firmware or the kernel.
+ */
+class SysfsPollEventSource : public FdEventSource {
+public:
+  /*! \throws std::system_error if the attribute couldn't get opened
+   */
+  SysfsPollEventSource(std::filesystem::path attribute) noexcept(false);
+
+  bool start() override;
+  std::optional<std::string> waitAndGet() override;
+
+  virtual ~SysfsPollEventSource();
+
+protected:
+  /*! \brief reads the attribute from the start, rearms the notification */
+  std::optional<std::string> readAttribute();
+
+  int _attribute_fd;
+};
+
+#endif /* end of include guard: SYSFSPOLLEVENTSOURCE_H */
@@ -0,0 +1,63 @@
+#ifndef THREADSCHEDULING_H
+
+#define THREADSCHEDULING_H
+
+#include <optional>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+/*! \enum thread_role
+ *
+ *  threads of the daemon with their own scheduling
+ */
+enum class thread_role {
+  watcher,   /*!< waiting for backlight changes (FileWatcher, forwarders) */
+  generator, /*!< generator stage of the pipeline */
+  apply      /*!< apply stage of the pipeline, submitting to colord */
+};
+
+/*! \struct ThreadScheduling
+ *  \brief scheduling of a thread, applied when the thread starts
+ */
+struct ThreadScheduling {
+  int policy = SCHED_OTHER; /*!< SCHED_OTHER, SCHED_FIFO or SCHED_RR */
+  int priority = 0;         /*!< real-time priority of SCHED_FIFO/SCHED_RR */
+  std::optional<int> nice;  /*!< of SCHED_OTHER, unchanged if nullopt */
+  std::vector<int> cpus;    /*!< affinity, empty keeps the inherited one */
+};
+
+/*! \brief parses "watcher", "generator" or "apply" */
+std::optional<thread_role> parse_thread_role(const std::string &);
+
+/*! \brief parses <policy>[:<value>][@<cpus>]
+ *
+ *  e.g. "other:-5" (nice -5), "fifo:10" (priority 10) or "rr:5@2-3,6", the
+ * cpus as a list of cpus and ranges like in /sys/devices/system/cpu
+ */
+std::optional<ThreadScheduling> parse_thread_scheduling(const std::string &);
+
+std::string thread_scheduling_string(const ThreadScheduling &);
+
+/*! \brief sets the scheduling of the threads of a role started afterwards
+ */
+void set_thread_scheduling(thread_role role,
+                           const ThreadScheduling &scheduling);
+
+/*! \brief applies the scheduling of the role to the calling thread, called
+ * at the start of the threads of the role
+ *
+ *  \return false if the scheduling couldn't get applied (e.g. real-time
+ * priorities without CAP_SYS_NICE), true without a configured scheduling
+ */
+bool apply_thread_scheduling(thread_role role);
+
+/*! \brief applies the scheduling to the calling thread */
+bool apply_thread_scheduling(const ThreadScheduling &scheduling);
+
+/*! \brief locks the current and future pages of the process into memory
+ * once they are touched, so a wakeup never waits for a page-in
+ */
+bool lock_memory();
+
+#endif /* end of include guard: THREADSCHEDULING_H */
@@ -0,0 +1,71 @@
+#ifndef UEVENTEVENTSOURCE_H
+
+#define UEVENTEVENTSOURCE_H
+
+#include "BrightnessEventSource.h"
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#define UEVENT_BUF_SIZE 8192
+
+/*! \class UeventEventSource
+ *  \brief brightness changes from the kernel uevents of a backlight device
+ *
+ *  Listens on a NETLINK_KOBJECT_UEVENT socket for `change` events of the
+ * backlight subsystem and reads `actual_brightness` of the device on a match.
+ */
+class UeventEventSource : public FdEventSource {
+public:
+  /*! \param device_dir e.g. /sys/class/backlight/intel_backlight/
+   *  \throws std::system_error if the netlink socket couldn't get created
+   */
+  UeventEventSource(std::filesystem::path device_dir) noexcept(false);
+
+  /*! \brief takes ownership of a datagram socket delivering uevents, e.g.
+   * one end of a socketpair in tests
+   */
+  UeventEventSource(std::filesystem::path device_dir,
+                    int uevent_fd) noexcept(false);
+
+  std::optional<std::string> waitAndGet() override;
+
+  /*! \brief checks if a uevent is a `change` of the backlight device
+   *
+   *  \param message `action@devpath` followed by `KEY=value` entries, all
+   * null terminated
+   */
+  static bool isBacklightChange(const char *message, size_t size,
+                                const std::string &device_name);
+
+  /*! \brief checks if a uevent is a `change` of a device of a subsystem
+   *
+   *  \param device_name empty for all devices of the subsystem
+   */
+  static bool isChange(const char *message, size_t size,
+                       const std::string &subsystem,
+                       const std::string &device_name);
+
+  virtual ~UeventEventSource();
+
+protected:
+  /*! \brief source for the changes of another subsystem
+   *
+   *  \param attribute read by readFile() on a match
+   */
+  UeventEventSource(std::string subsystem, std::string device_name,
+                    std::filesystem::path attribute,
+                    int uevent_fd) noexcept(false);
+
+  /*! \brief netlink socket of the kernel uevents
+   *  \throws std::system_error if it couldn't get created
+   */
+  static int openSocket() noexcept(false);
+
+  std::string _subsystem;
+  std::string _device_name;
+  int _uevent_fd;
+};
+
+#endif /* end of include guard: UEVENTEVENTSOURCE_H */
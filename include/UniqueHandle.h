@@ -0,0 +1,52 @@
+#ifndef UNIQUEHANDLE_H
+
+#define UNIQUEHANDLE_H
+
+#include <utility>
+
+/*! \class UniqueHandle
+ *  \brief move-only owner of a C handle (pointer) with a deleter
+ *
+ *  Like std::unique_ptr, but for opaque handles like void* typedefs and with
+ * out() for C out-parameters (e.g. GError**).
+ */
+template <class T, class Deleter> class UniqueHandle {
+public:
+  UniqueHandle() noexcept : _handle(nullptr) {}
+  explicit UniqueHandle(T handle) noexcept : _handle(handle) {}
+  UniqueHandle(const UniqueHandle &) = delete;
+  UniqueHandle &operator=(const UniqueHandle &) = delete;
+  UniqueHandle(UniqueHandle &&other) noexcept : _handle(other.release()) {}
+  UniqueHandle &operator=(UniqueHandle &&other) noexcept {
+    reset(other.release());
+    return *this;
+  }
+
+  T get() const noexcept { return _handle; }
+  T operator->() const noexcept { return _handle; }
+  explicit operator bool() const noexcept { return _handle != nullptr; }
+
+  /*! \brief gives up the ownership without freeing the handle */
+  T release() noexcept { return std::exchange(_handle, nullptr); }
+
+  void reset(T handle = nullptr) noexcept {
+    T old = std::exchange(_handle, handle);
+    if (old) {
+      Deleter()(old);
+    }
+  }
+
+  /*! \brief frees the current handle and returns its address, to be filled
+   * by a C function */
+  T *out() noexcept {
+    reset();
+    return &_handle;
+  }
+
+  ~UniqueHandle() { reset(); }
+
+protected:
+  T _handle;
+};
+
+#endif /* end of include guard: UNIQUEHANDLE_H */
@@ -0,0 +1,125 @@
+#ifndef COLORD_BRIGHTNESS_H
+
+#define COLORD_BRIGHTNESS_H
+
+/*! \file colord_brightness.h
+ *  \brief C API of libcolord-brightness
+ *
+ *  Generates the brightness profiles, caches them in the profile atlas and
+ * applies them through the generate/apply pipeline, in the process of the
+ * caller (e.g. a desktop shell or a compositor plugin). Brightness changes
+ * are asynchronous and latest value wins, like in the daemon.
+ *
+ *  The API and ABI only change together with
+ * COLORD_BRIGHTNESS_API_VERSION, which is the soname version of the library.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COLORD_BRIGHTNESS_API_VERSION 1
+
+/*! levels are the brightness in permille */
+#define COLORD_BRIGHTNESS_LEVEL_SCALE 1000
+
+#define COLORD_BRIGHTNESS_EXPORT __attribute__((visibility("default")))
+
+typedef enum colord_brightness_status {
+  COLORD_BRIGHTNESS_OK = 0,
+  COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT = -1,
+  COLORD_BRIGHTNESS_ERROR_NO_COLORD = -2, /*!< colord isn't running */
+  COLORD_BRIGHTNESS_ERROR_SYSTEM = -3,    /*!< errno is set */
+  COLORD_BRIGHTNESS_ERROR_GENERATE = -4,  /*!< profile creation failed */
+  COLORD_BRIGHTNESS_ERROR_BUFFER_TOO_SMALL = -5,
+  COLORD_BRIGHTNESS_ERROR_TIMEOUT = -6,
+  COLORD_BRIGHTNESS_ERROR_NOT_APPLIED = -7, /*!< the backend failed */
+} colord_brightness_status;
+
+/*! \brief handle of the pipeline, its thread and the backend */
+typedef struct colord_brightness colord_brightness;
+
+/*! \brief applies a serialized icc profile to a display
+ *
+ *  Called on a thread of the pipeline, concurrently for different displays.
+ *
+ *  \param data only valid during the call
+ *  \return 0 if the profile got applied
+ */
+typedef int (*colord_brightness_apply_func)(const uint8_t *data, size_t size,
+                                            unsigned display,
+                                            void *user_data);
+
+/*! \return COLORD_BRIGHTNESS_API_VERSION of the loaded library */
+COLORD_BRIGHTNESS_EXPORT unsigned colord_brightness_api_version(void);
+
+COLORD_BRIGHTNESS_EXPORT const char *
+colord_brightness_status_string(colord_brightness_status status);
+
+/*! \brief level of a relative brightness, clamped to [0, 1] */
+COLORD_BRIGHTNESS_EXPORT uint32_t colord_brightness_level(double brightness);
+
+/*! \brief generates the sRGB profile of a level, without a handle
+ *
+ *  \param data buffer for the icc profile, may be NULL to query the size
+ *  \param size of the buffer
+ *  \param written size of the profile, also if the buffer is too small
+ */
+COLORD_BRIGHTNESS_EXPORT colord_brightness_status
+colord_brightness_generate(uint32_t level, uint8_t *data, size_t size,
+                           size_t *written);
+
+/*! \brief connects to colord and starts the pipeline
+ *
+ *  The profiles get applied to the colord display devices through memfds
+ * named after icc_name, the generated profiles are cached in the profile
+ * atlas of the user if it isn't locked by the daemon.
+ *
+ *  \param icc_name e.g. "shell_brightness.icc", NULL for the default
+ */
+COLORD_BRIGHTNESS_EXPORT colord_brightness_status
+colord_brightness_new(const char *icc_name, colord_brightness **handle);
+
+/*! \brief starts the pipeline with an own backend instead of colord, e.g.
+ * a compositor applying the vcgt itself
+ */
+COLORD_BRIGHTNESS_EXPORT colord_brightness_status
+colord_brightness_new_with_backend(colord_brightness_apply_func apply,
+                                   void *user_data,
+                                   colord_brightness **handle);
+
+/*! \brief stops the pipeline, pending levels get dropped */
+COLORD_BRIGHTNESS_EXPORT void colord_brightness_free(colord_brightness *handle);
+
+/*! \return colord display devices, 0 with an own backend */
+COLORD_BRIGHTNESS_EXPORT unsigned
+colord_brightness_display_count(colord_brightness *handle);
+
+/*! \brief requests a level for a display and returns immediately, a level
+ * not yet applied gets replaced by the next one
+ */
+COLORD_BRIGHTNESS_EXPORT colord_brightness_status
+colord_brightness_set_level(colord_brightness *handle, unsigned display,
+                            uint32_t level);
+
+/*! \brief waits until the last requested level of a display got applied
+ *
+ *  \param timeout_ms negative to wait without a timeout
+ */
+COLORD_BRIGHTNESS_EXPORT colord_brightness_status
+colord_brightness_wait_applied(colord_brightness *handle, unsigned display,
+                               int timeout_ms);
+
+/*! \brief last level applied to a display */
+COLORD_BRIGHTNESS_EXPORT colord_brightness_status
+colord_brightness_applied_level(colord_brightness *handle, unsigned display,
+                                uint32_t *level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: COLORD_BRIGHTNESS_H */
@@ -0,0 +1,364 @@
+#include "AmbientLightEventSource.h"
+#include "ProfileGenerator.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <easylogging++.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <poll.h>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+
+#define ILLUMINANCE_RAW_FILE "in_illuminance_raw"
+#define ILLUMINANCE_INPUT_FILE "in_illuminance_input"
+#define ILLUMINANCE_SCALE_FILE "in_illuminance_scale"
+#define ILLUMINANCE_OFFSET_FILE "in_illuminance_offset"
+#define ILLUMINANCE_SCAN_ELEMENT "in_illuminance_en"
+#define ILLUMINANCE_SCAN_TYPE "in_illuminance_type"
+#define IIO_BUFFER_READ_SIZE 256
+#define POLL_CHANGE_RATIO 0.05 /*!< relative change resetting the interval */
+
+// -----------------Helper  functions----------------
+
+std::filesystem::path illuminanceAttribute(std::filesystem::path device_dir) {
+  if (std::filesystem::exists(device_dir / ILLUMINANCE_RAW_FILE)) {
+    return device_dir / ILLUMINANCE_RAW_FILE;
+  }
+  // processed channel, already in lux
+  return device_dir / ILLUMINANCE_INPUT_FILE;
+}
+
+std::optional<std::string> readAttribute(std::filesystem::path file) {
+  std::ifstream in(file);
+  std::string content;
+  if (!in.is_open() || !std::getline(in, content)) {
+    return std::nullopt;
+  }
+  return content;
+}
+
+double readNumber(std::filesystem::path file, double fallback) {
+  std::optional<std::string> content = readAttribute(file);
+  if (!content) {
+    return fallback;
+  }
+  char *end;
+  double number = std::strtod(content->c_str(), &end);
+  return end == content->c_str() ? fallback : number;
+}
+
+bool writeAttribute(std::filesystem::path file, const std::string &value) {
+  std::ofstream out(file);
+  out << value;
+  out.close();
+  LOG_IF(!out, DEBUG) << "Couldn't write " << value << " to " << file;
+  return static_cast<bool>(out);
+}
+
+double decodeSample(const uint8_t *data, const IioScanType &type) {
+  size_t bytes = type.storagebits / 8;
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    if (type.big_endian) {
+      value = (value << 8) | data[i];
+    } else {
+      value |= static_cast<uint64_t>(data[i]) << (8 * i);
+    }
+  }
+  value >>= type.shift;
+  if (type.realbits < 64) {
+    value &= (uint64_t(1) << type.realbits) - 1;
+    if (type.is_signed && (value >> (type.realbits - 1)) & 1) {
+      return static_cast<double>(static_cast<int64_t>(value) -
+                                 (int64_t(1) << type.realbits));
+    }
+  }
+  return type.is_signed ? static_cast<double>(static_cast<int64_t>(value))
+                        : static_cast<double>(value);
+}
+
+// -------------------------------------
+
+AmbientLightFilter::AmbientLightFilter(AmbientLightConfig conf)
+    : _conf(conf), _smoothed(), _level() {}
+
+uint32_t AmbientLightFilter::levelFor(double lux) const {
+  return levelForLog(std::log1p(std::max(lux, 0.0)));
+}
+
+uint32_t AmbientLightFilter::levelForLog(double log_lux) const {
+  double ratio =
+      std::clamp(log_lux / std::log1p(std::max(_conf.max_lux, 1.0)), 0.0, 1.0);
+  return quantize_brightness(_conf.min_brightness +
+                             (1.0 - _conf.min_brightness) * ratio);
+}
+
+std::optional<uint32_t> AmbientLightFilter::update(double lux) {
+  double log_lux = std::log1p(std::max(lux, 0.0));
+  _smoothed = _smoothed ? _conf.smoothing * log_lux +
+                              (1.0 - _conf.smoothing) * _smoothed.value()
+                        : log_lux;
+  uint32_t level = levelForLog(_smoothed.value());
+  if (_level) {
+    uint32_t last = _level.value();
+    uint32_t diff = level > last ? level - last : last - level;
+    // the bounds get reached, even if they are within the hysteresis
+    bool bound = level == levelForLog(0.0) || level == BRIGHTNESS_LEVEL_SCALE;
+    if (diff == 0 || (diff < _conf.hysteresis && !bound)) {
+      return std::nullopt;
+    }
+  }
+  _level = level;
+  return level;
+}
+
+std::optional<uint32_t> AmbientLightFilter::level() const { return _level; }
+
+AmbientLightEventSource::AmbientLightEventSource(
+    std::filesystem::path device_dir, AmbientLightConfig conf,
+    std::filesystem::path dev_dir)
+    : FdEventSource(illuminanceAttribute(device_dir)),
+      _device_dir(device_dir), _chardev(), _conf(conf), _filter(conf),
+      _raw_fd(-1), _scale(1.0), _offset(0.0), _buffer_fd(-1), _scan_type(),
+      _interval(conf.min_interval), _last_lux() {
+  _raw_fd = open(_attribute.c_str(), O_RDONLY | O_CLOEXEC);
+  if (_raw_fd < 0) {
+    std::stringstream ss;
+    ss << "Illuminance " << _attribute << " couldn't get opened";
+    throw std::system_error(errno, std::generic_category(), ss.str());
+  }
+  _scale = readNumber(_device_dir / ILLUMINANCE_SCALE_FILE, 1.0);
+  _offset = readNumber(_device_dir / ILLUMINANCE_OFFSET_FILE, 0.0);
+  // the device directory may end with a slash
+  _chardev = dev_dir / (_device_dir / "").parent_path().filename();
+}
+
+std::optional<std::filesystem::path>
+AmbientLightEventSource::find(std::filesystem::path iio_dir) {
+  std::error_code ec;
+  std::set<std::filesystem::path> devices;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(iio_dir, ec)) {
+    if (std::filesystem::exists(entry.path() / ILLUMINANCE_RAW_FILE) ||
+        std::filesystem::exists(entry.path() / ILLUMINANCE_INPUT_FILE)) {
+      devices.insert(entry.path());
+    }
+  }
+  if (devices.empty()) {
+    return std::nullopt;
+  }
+  return *devices.begin();
+}
+
+std::optional<IioScanType>
+AmbientLightEventSource::parseScanType(const std::string &type) {
+  // [be|le]:[s|u]<realbits>/<storagebits>[X<repeat>]>><shift>
+  char endian, sign;
+  uint realbits, storagebits;
+  if (std::sscanf(type.c_str(), "%ce:%c%u/%u", &endian, &sign, &realbits,
+                  &storagebits) != 4 ||
+      (endian != 'b' && endian != 'l') || (sign != 's' && sign != 'u')) {
+    return std::nullopt;
+  }
+  uint shift = 0;
+  size_t shift_pos = type.find(">>");
+  if (shift_pos != std::string::npos) {
+    shift = std::strtoul(type.c_str() + shift_pos + 2, nullptr, 10);
+  }
+  uint repeat = 1;
+  size_t repeat_pos = type.find('X');
+  if (repeat_pos != std::string::npos) {
+    repeat = std::strtoul(type.c_str() + repeat_pos + 1, nullptr, 10);
+  }
+  if ((storagebits != 8 && storagebits != 16 && storagebits != 32 &&
+       storagebits != 64) ||
+      realbits == 0 || realbits + shift > storagebits || repeat == 0 ||
+      repeat > IIO_BUFFER_READ_SIZE / (storagebits / 8)) {
+    return std::nullopt;
+  }
+  return IioScanType{endian == 'b', sign == 's', realbits, storagebits, shift,
+                     repeat};
+}
+
+bool AmbientLightEventSource::start() {
+  if (!FdEventSource::start()) {
+    return false;
+  }
+  _interval = _conf.min_interval;
+  _last_lux.reset();
+  if (_buffer_fd < 0 && !enableBuffer()) {
+    LOG(INFO) << "Polling the ambient light sensor " << _device_dir;
+    return readLux().has_value();
+  }
+  LOG(INFO) << "Reading the buffer of the ambient light sensor " << _chardev;
+  return true;
+}
+
+std::optional<std::string> AmbientLightEventSource::waitAndGet() {
+  while (std::optional<double> lux = waitForSample()) {
+    if (std::optional<uint32_t> level = _filter.update(lux.value())) {
+      LOG(DEBUG) << "Ambient light " << lux.value() << " lx, level "
+                 << level.value();
+      return std::to_string(level.value()) + "\n";
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<std::string> AmbientLightEventSource::readFile() {
+  // the attribute may be busy while the buffer is enabled
+  if (std::optional<uint32_t> level = _filter.level()) {
+    return std::to_string(level.value()) + "\n";
+  }
+  if (std::optional<double> lux = readLux()) {
+    return std::to_string(_filter.levelFor(lux.value())) + "\n";
+  }
+  return std::nullopt;
+}
+
+bool AmbientLightEventSource::buffered() const { return _buffer_fd >= 0; }
+
+std::optional<double> AmbientLightEventSource::readLux() {
+  char buf[64];
+  ssize_t len;
+  do {
+    len = pread(_raw_fd, buf, sizeof(buf) - 1, 0);
+  } while (len < 0 && errno == EINTR);
+  if (len <= 0) {
+    LOG(WARNING) << "Couldn't read the illuminance " << _attribute
+                 << ", errno: " << strerror(errno);
+    return std::nullopt;
+  }
+  buf[len] = '\0';
+  char *end;
+  double raw = std::strtod(buf, &end);
+  if (end == buf) {
+    LOG(WARNING) << "Illuminance " << _attribute << " is no number: " << buf;
+    return std::nullopt;
+  }
+  return (raw + _offset) * _scale;
+}
+
+std::optional<double> AmbientLightEventSource::waitForSample() {
+  return _buffer_fd >= 0 ? waitForBufferedSample() : waitForPolledSample();
+}
+
+std::optional<double> AmbientLightEventSource::waitForPolledSample() {
+  while (waitForEvent(-1, 0, _interval.count())) {
+    std::optional<double> lux = readLux();
+    if (!lux) {
+      _interval = _conf.max_interval;
+      continue;
+    }
+    // back to the short interval as soon as the light changes
+    bool changed =
+        !_last_lux || std::abs(lux.value() - _last_lux.value()) >
+                          POLL_CHANGE_RATIO * _last_lux.value() + 1.0;
+    _interval = changed ? _conf.min_interval
+                        : std::min(_interval * 2, _conf.max_interval);
+    _last_lux = lux;
+    return lux;
+  }
+  return std::nullopt;
+}
+
+std::optional<double> AmbientLightEventSource::waitForBufferedSample() {
+  // a repeated channel has all its elements in every sample
+  size_t sample_size = _scan_type.storagebits / 8 * _scan_type.repeat;
+  uint8_t buf[IIO_BUFFER_READ_SIZE];
+  size_t read_size = sizeof(buf) - sizeof(buf) % sample_size;
+  while (waitForEvent(_buffer_fd, POLLIN)) {
+    // only the latest of the queued samples matters
+    ssize_t len = read(_buffer_fd, buf, read_size);
+    if (len < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      LOG(ERROR) << "Couldn't read the buffer of " << _chardev
+                 << ", errno: " << strerror(errno);
+      return std::nullopt;
+    }
+    if (static_cast<size_t>(len) < sample_size) {
+      continue;
+    }
+    size_t last = (len / sample_size - 1) * sample_size;
+    return (decodeSample(buf + last, _scan_type) + _offset) * _scale;
+  }
+  return std::nullopt;
+}
+
+bool AmbientLightEventSource::enableBuffer() {
+  std::filesystem::path scan_dir = _device_dir / "scan_elements";
+  std::filesystem::path enable = _device_dir / "buffer" / "enable";
+  if (!std::filesystem::exists(scan_dir / ILLUMINANCE_SCAN_ELEMENT) ||
+      !std::filesystem::exists(enable) ||
+      !std::filesystem::exists(_chardev)) {
+    return false;
+  }
+  // without a trigger the buffer never gets filled
+  std::optional<std::string> trigger =
+      readAttribute(_device_dir / "trigger" / "current_trigger");
+  if (std::filesystem::exists(_device_dir / "trigger") &&
+      (!trigger || trigger->empty())) {
+    return false;
+  }
+  std::optional<std::string> type_str =
+      readAttribute(scan_dir / ILLUMINANCE_SCAN_TYPE);
+  std::optional<IioScanType> type =
+      type_str ? parseScanType(type_str.value()) : std::nullopt;
+  if (!type) {
+    return false;
+  }
+
+  // only the illuminance, so every sample has the same layout
+  if (!writeAttribute(enable, "0")) {
+    return false;
+  }
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(scan_dir, ec)) {
+    std::string name = entry.path().filename();
+    if (name.size() > 3 && name.compare(name.size() - 3, 3, "_en") == 0 &&
+        !writeAttribute(entry.path(),
+                        name == ILLUMINANCE_SCAN_ELEMENT ? "1" : "0")) {
+      return false;
+    }
+  }
+  _buffer_fd = open(_chardev.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (_buffer_fd < 0) {
+    LOG(DEBUG) << "Couldn't open " << _chardev << ", errno: "
+               << strerror(errno);
+    return false;
+  }
+  _scan_type = type.value();
+  if (!writeAttribute(enable, "1")) {
+    disableBuffer();
+    return false;
+  }
+  return true;
+}
+
+void AmbientLightEventSource::disableBuffer() {
+  if (_buffer_fd < 0) {
+    return;
+  }
+  writeAttribute(_device_dir / "buffer" / "enable", "0");
+  LOG_IF(close(_buffer_fd) != 0, ERROR)
+      << "Couldnt close iio buffer fd, errno: " << strerror(errno);
+  _buffer_fd = -1;
+}
+
+AmbientLightEventSource::~AmbientLightEventSource() {
+  disableBuffer();
+  LOG_IF(close(_raw_fd) != 0, ERROR)
+      << "Couldnt close illuminance fd, errno: " << strerror(errno);
+}
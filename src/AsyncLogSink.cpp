@@ -0,0 +1,178 @@
+#include "AsyncLogSink.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <easylogging++.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+#define ASYNC_LOG_CALLBACK_ID "AsyncLogSink"
+#define DEFAULT_LOG_CALLBACK_ID "DefaultLogDispatchCallback"
+
+// -----------------Helper  functions----------------
+
+void setDefaultDispatch(bool enabled) {
+  auto *callback =
+      el::Helpers::logDispatchCallback<el::base::DefaultLogDispatchCallback>(
+          DEFAULT_LOG_CALLBACK_ID);
+  if (callback) {
+    callback->setEnabled(enabled);
+  }
+}
+
+void appendDatetime(std::string &line,
+                    std::chrono::system_clock::time_point time) {
+  std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+  auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    time.time_since_epoch())
+                    .count() %
+                1000;
+  std::tm local;
+  localtime_r(&seconds, &local);
+  char buf[32];
+  size_t len = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &local);
+  line.append(buf, len);
+  len = snprintf(buf, sizeof(buf), ",%03d", static_cast<int>(millis));
+  line.append(buf, len);
+}
+
+// -------------------------------------
+
+AsyncLogSink::AsyncLogSink(int out_fd, size_t capacity)
+    : _out_fd(out_fd), _ring(capacity > 0 ? capacity : 1), _head(0),
+      _count(0), _dropped(0), _stop(false), _line(), _mut(), _cv(),
+      _writer_thread() {}
+
+bool AsyncLogSink::start() {
+  if (_writer_thread.joinable()) {
+    return false;
+  }
+  el::Helpers::installLogDispatchCallback<AsyncLogDispatchCallback>(
+      ASYNC_LOG_CALLBACK_ID);
+  auto *callback = el::Helpers::logDispatchCallback<AsyncLogDispatchCallback>(
+      ASYNC_LOG_CALLBACK_ID);
+  if (!callback) {
+    LOG(ERROR) << "Async log sink couldn't get installed";
+    return false;
+  }
+  _stop = false;
+  _writer_thread = std::thread(&AsyncLogSink::writerThread, this);
+  callback->setSink(this);
+  callback->setEnabled(true);
+  // only after the sink is in place, so no message gets lost
+  setDefaultDispatch(false);
+  return true;
+}
+
+bool AsyncLogSink::stop() {
+  if (!_writer_thread.joinable()) {
+    return false;
+  }
+  // the callback stays installed, easylogging++ doesn't lock its callbacks
+  setDefaultDispatch(true);
+  auto *callback = el::Helpers::logDispatchCallback<AsyncLogDispatchCallback>(
+      ASYNC_LOG_CALLBACK_ID);
+  if (callback) {
+    callback->setEnabled(false);
+    callback->setSink(nullptr);
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(_mut);
+    _stop = true;
+  }
+  _cv.notify_one();
+  _writer_thread.join();
+  return true;
+}
+
+bool AsyncLogSink::push(el::Level level, const std::string &message) {
+  {
+    std::lock_guard<std::mutex> lk(_mut);
+    if (_count == _ring.size()) {
+      _dropped++;
+      return false;
+    }
+    LogRecord &record = _ring[(_head + _count) % _ring.size()];
+    record.level = level;
+    record.time = std::chrono::system_clock::now();
+    // reuses the buffer of the slot
+    record.message.assign(message);
+    _count++;
+  }
+  _cv.notify_one();
+  return true;
+}
+
+uint64_t AsyncLogSink::dropped() const {
+  std::lock_guard<std::mutex> lk(_mut);
+  return _dropped;
+}
+
+void AsyncLogSink::writerThread() {
+  LogRecord record = {el::Level::Unknown, {}, std::string()};
+  uint64_t reported_dropped = 0;
+  while (true) {
+    uint64_t dropped;
+    {
+      std::unique_lock<std::mutex> lk(_mut);
+      _cv.wait(lk, [this] { return _count > 0 || _stop; });
+      if (_count == 0) {
+        break; // stopped and drained
+      }
+      // swap, so the slot keeps a buffer for the next message
+      std::swap(record, _ring[_head]);
+      _head = (_head + 1) % _ring.size();
+      _count--;
+      dropped = _dropped;
+    }
+    if (dropped != reported_dropped) {
+      write({el::Level::Warning, std::chrono::system_clock::now(),
+             std::to_string(dropped - reported_dropped) +
+                 " log messages dropped"});
+      reported_dropped = dropped;
+    }
+    write(record);
+  }
+}
+
+void AsyncLogSink::write(const LogRecord &record) {
+  _line.clear();
+  appendDatetime(_line, record.time);
+  _line += " ";
+  _line += el::LevelHelper::convertToString(record.level);
+  _line += " ";
+  _line += record.message;
+  _line += "\n";
+
+  const char *data = _line.data();
+  size_t size = _line.size();
+  while (size > 0) {
+    ssize_t written = ::write(_out_fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return; // nowhere left to report it
+    }
+    data += written;
+    size -= written;
+  }
+}
+
+AsyncLogSink::~AsyncLogSink() { stop(); }
+
+void AsyncLogDispatchCallback::setSink(AsyncLogSink *sink) {
+  _sink.store(sink);
+}
+
+void AsyncLogDispatchCallback::handle(const el::LogDispatchData *data) {
+  AsyncLogSink *sink = _sink.load();
+  if (sink && data && data->logMessage()) {
+    sink->push(data->logMessage()->level(), data->logMessage()->message());
+  }
+}
@@ -0,0 +1,126 @@
+#include "BrightnessEventSource.h"
+#include "InotifyEventSource.h"
+#include "SysfsPollEventSource.h"
+#include "UeventEventSource.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <easylogging++.h>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/eventfd.h>
+#include <system_error>
+#include <unistd.h>
+
+#define BRIGHTNESS_FILE "brightness"
+
+FdEventSource::FdEventSource(std::filesystem::path attribute)
+    : _attribute(attribute), _stop_fd(-1) {
+  _stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (_stop_fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Eventfd for the event source failed");
+  }
+}
+
+bool FdEventSource::start() {
+  // drop a stop request of a previous run
+  uint64_t count;
+  return read(_stop_fd, &count, sizeof(count)) == sizeof(count) ||
+         errno == EAGAIN;
+}
+
+std::optional<std::string> FdEventSource::readFile() {
+  std::ifstream file(_attribute);
+  if (!file.is_open()) {
+    LOG(DEBUG) << "Couldn't open the file " << _attribute
+               << ", errno:" << strerror(errno);
+    return std::nullopt;
+  }
+  std::stringstream ss;
+  ss << file.rdbuf();
+  return ss.str();
+}
+
+bool FdEventSource::stop() {
+  uint64_t one = 1;
+  if (write(_stop_fd, &one, sizeof(one)) != sizeof(one)) {
+    LOG(ERROR) << "Couldn't stop the event source, errno: "
+               << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool FdEventSource::waitForEvent(int fd, short events, int timeout_ms) {
+  pollfd fds[2] = {{_stop_fd, POLLIN, 0}, {fd, events, 0}};
+  while (true) {
+    int ready = poll(fds, 2, timeout_ms);
+    if (ready < 0) {
+      if (errno == EINTR)
+        continue;
+      LOG(ERROR) << "Poll on the event source failed, errno: "
+                 << strerror(errno);
+      return false;
+    }
+    if (ready == 0) {
+      return true;
+    }
+    if (fds[0].revents) {
+      return false;
+    }
+    if (fds[1].revents & (events | POLLERR)) {
+      return true;
+    }
+    if (fds[1].revents & (POLLHUP | POLLNVAL)) {
+      LOG(ERROR) << "Event source " << _attribute << " got closed";
+      return false;
+    }
+  }
+}
+
+FdEventSource::~FdEventSource() {
+  LOG_IF(close(_stop_fd) != 0, ERROR)
+      << "Couldnt close eventfd, errno: " << strerror(errno);
+}
+
+std::optional<event_source_kind>
+parse_event_source_kind(const std::string &kind) {
+  if (kind == "auto") {
+    return event_source_kind::automatic;
+  } else if (kind == "inotify") {
+    return event_source_kind::inotify;
+  } else if (kind == "uevent") {
+    return event_source_kind::uevent;
+  } else if (kind == "sysfs") {
+    return event_source_kind::sysfs_poll;
+  }
+  return std::nullopt;
+}
+
+std::unique_ptr<BrightnessEventSource>
+make_event_source(std::filesystem::path device_dir, event_source_kind kind) {
+  if (kind == event_source_kind::automatic) {
+    // sysfs notifies actual_brightness on userspace and kernel changes
+    kind = std::filesystem::exists(device_dir / ACTUAL_BRIGHTNESS_FILE)
+               ? event_source_kind::sysfs_poll
+               : event_source_kind::inotify;
+  }
+  switch (kind) {
+  case event_source_kind::uevent:
+    LOG(INFO) << "Using uevents for the changes of " << device_dir;
+    return std::make_unique<UeventEventSource>(device_dir);
+  case event_source_kind::sysfs_poll:
+    LOG(INFO) << "Using sysfs poll for the changes of " << device_dir;
+    return std::make_unique<SysfsPollEventSource>(device_dir /
+                                                  ACTUAL_BRIGHTNESS_FILE);
+  default:
+    LOG(INFO) << "Using inotify for the changes of " << device_dir;
+    return std::make_unique<InotifyEventSource>(device_dir / BRIGHTNESS_FILE);
+  }
+}
@@ -0,0 +1,104 @@
+#include "BrightnessTargets.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+
+BrightnessTargets::BrightnessTargets()
+    : _pending(), _current(), _posted_seq(), _coalesced(0), _closed(false),
+      _mut(), _cv() {}
+
+void BrightnessTargets::post(uint display_device_id, uint32_t level) {
+  postBatch({{display_device_id, level}});
+}
+
+void BrightnessTargets::postBatch(const std::map<uint, uint32_t> &levels) {
+  if (levels.empty()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lk(_mut);
+    auto issued = std::chrono::steady_clock::now();
+    for (auto [display_device_id, level] : levels) {
+      uint64_t seq = ++_posted_seq[display_device_id];
+      auto [it, inserted] = _pending.insert_or_assign(
+          display_device_id,
+          BrightnessTarget{display_device_id, level, issued, seq});
+      if (!inserted) {
+        _coalesced++;
+      }
+      _current[display_device_id] = level;
+    }
+  }
+  _cv.notify_one();
+}
+
+// needs the lock
+std::optional<BrightnessTarget> BrightnessTargets::takeNext() {
+  if (_closed || _pending.empty()) {
+    return std::nullopt;
+  }
+  // oldest request first, so no display starves
+  auto oldest = _pending.begin();
+  for (auto it = _pending.begin(); it != _pending.end(); it++) {
+    if (it->second.issued < oldest->second.issued) {
+      oldest = it;
+    }
+  }
+  BrightnessTarget target = oldest->second;
+  _pending.erase(oldest);
+  return target;
+}
+
+std::optional<BrightnessTarget> BrightnessTargets::waitNext() {
+  std::unique_lock<std::mutex> lk(_mut);
+  _cv.wait(lk, [this] { return _closed || !_pending.empty(); });
+  return takeNext();
+}
+
+std::optional<BrightnessTarget>
+BrightnessTargets::waitNextFor(std::chrono::milliseconds time) {
+  std::unique_lock<std::mutex> lk(_mut);
+  _cv.wait_for(lk, time, [this] { return _closed || !_pending.empty(); });
+  return takeNext();
+}
+
+void BrightnessTargets::setCurrent(uint display_device_id, uint32_t level) {
+  std::lock_guard<std::mutex> lk(_mut);
+  _current[display_device_id] = level;
+}
+
+std::optional<uint32_t>
+BrightnessTargets::current(uint display_device_id) const {
+  std::lock_guard<std::mutex> lk(_mut);
+  auto it = _current.find(display_device_id);
+  if (it == _current.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+uint64_t BrightnessTargets::postedSeq(uint display_device_id) const {
+  std::lock_guard<std::mutex> lk(_mut);
+  auto it = _posted_seq.find(display_device_id);
+  return it != _posted_seq.end() ? it->second : 0;
+}
+
+uint64_t BrightnessTargets::coalesced() const {
+  std::lock_guard<std::mutex> lk(_mut);
+  return _coalesced;
+}
+
+void BrightnessTargets::close() {
+  {
+    std::lock_guard<std::mutex> lk(_mut);
+    _closed = true;
+  }
+  _cv.notify_all();
+}
+
+bool BrightnessTargets::closed() const {
+  std::lock_guard<std::mutex> lk(_mut);
+  return _closed;
+}
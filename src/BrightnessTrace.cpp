@@ -0,0 +1,102 @@
+#include "BrightnessTrace.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <easylogging++.h>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+// -----------------On-disk format----------------
+
+struct TraceHeader {
+  char magic[8];
+  uint32_t format_version;
+  uint32_t reserved;
+};
+
+struct TraceRecord {
+  uint32_t delta_us; /*!< since the previous record, saturated */
+  uint16_t display_device_id;
+  uint16_t level;
+};
+
+static_assert(sizeof(TraceRecord) == 8);
+
+// -------------------------------------
+
+TraceRecorder::TraceRecorder(std::filesystem::path trace_file)
+    : _file(trace_file, std::ios::out | std::ios::binary | std::ios::trunc),
+      _last(std::chrono::steady_clock::now()), _recorded(0), _mut() {
+  if (!_file.is_open()) {
+    std::stringstream ss;
+    ss << "Trace file " << trace_file << " couldn't get opened";
+    throw std::system_error(errno, std::generic_category(), ss.str());
+  }
+  TraceHeader header = {};
+  std::memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  header.format_version = TRACE_FORMAT_VERSION;
+  _file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void TraceRecorder::record(uint display_device_id, uint32_t level) {
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lk(_mut);
+  auto delta =
+      std::chrono::duration_cast<std::chrono::microseconds>(now - _last)
+          .count();
+  _last = now;
+  TraceRecord record = {
+      static_cast<uint32_t>(std::min<int64_t>(
+          delta, std::numeric_limits<uint32_t>::max())),
+      static_cast<uint16_t>(display_device_id), static_cast<uint16_t>(level)};
+  _file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+  _file.flush();
+  LOG_IF(!_file.good(), ERROR) << "Couldn't write to the trace file";
+  _recorded++;
+}
+
+size_t TraceRecorder::recorded() const {
+  std::lock_guard<std::mutex> lk(_mut);
+  return _recorded;
+}
+
+TraceRecorder::~TraceRecorder() {
+  _file.close();
+  LOG(INFO) << "Recorded " << _recorded << " brightness changes";
+}
+
+std::vector<TraceEvent> read_trace(std::filesystem::path trace_file) {
+  std::ifstream file(trace_file, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    std::stringstream ss;
+    ss << "Trace file " << trace_file << " couldn't get opened";
+    throw std::runtime_error(ss.str());
+  }
+  TraceHeader header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+      header.format_version != TRACE_FORMAT_VERSION) {
+    std::stringstream ss;
+    ss << "File " << trace_file << " is no supported trace";
+    throw std::runtime_error(ss.str());
+  }
+
+  std::vector<TraceEvent> events;
+  std::chrono::microseconds offset(0);
+  TraceRecord record;
+  while (file.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+    offset += std::chrono::microseconds(record.delta_us);
+    events.push_back({offset, record.display_device_id, record.level});
+  }
+  LOG_IF(file.gcount() != 0, WARNING)
+      << "Trace file " << trace_file << " ends with a partial record";
+  return events;
+}
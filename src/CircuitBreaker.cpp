@@ -0,0 +1,83 @@
+#include "CircuitBreaker.h"
+#include <algorithm>
+#include <chrono>
+#include <easylogging++.h>
+
+const char *breaker_state_name(breaker_state state) {
+  switch (state) {
+  case breaker_state::closed:
+    return "closed";
+  case breaker_state::open:
+    return "open";
+  case breaker_state::half_open:
+    return "half_open";
+  }
+  return "unknown";
+}
+
+CircuitBreaker::CircuitBreaker(CircuitBreakerConfig conf)
+    : _conf(conf), _stats(), _consecutive_timeouts(0), _retry_at() {}
+
+bool CircuitBreaker::allow() {
+  switch (_stats.state) {
+  case breaker_state::closed:
+    return true;
+  case breaker_state::open:
+    if (std::chrono::steady_clock::now() >= _retry_at) {
+      _stats.state = breaker_state::half_open;
+      _stats.probes++;
+      return true;
+    }
+    break;
+  case breaker_state::half_open:
+    break;
+  }
+  _stats.rejected++;
+  return false;
+}
+
+void CircuitBreaker::recordResponse() {
+  LOG_IF(_stats.state != breaker_state::closed, INFO)
+      << "Circuit breaker closed, the backend responds again";
+  _stats.state = breaker_state::closed;
+  _stats.backoff = std::chrono::milliseconds(0);
+  _consecutive_timeouts = 0;
+}
+
+void CircuitBreaker::recordTimeout() {
+  _stats.timeouts++;
+  _consecutive_timeouts++;
+  if (_stats.state == breaker_state::half_open) {
+    // the probe failed, back off further
+    open(std::min(_stats.backoff * 2, _conf.max_backoff));
+  } else if (_stats.state == breaker_state::closed &&
+             _consecutive_timeouts >= _conf.timeout_threshold) {
+    open(_conf.initial_backoff);
+  }
+}
+
+void CircuitBreaker::releaseProbe() {
+  if (_stats.state == breaker_state::half_open) {
+    _stats.state = breaker_state::open;
+    _retry_at = std::chrono::steady_clock::now();
+  }
+}
+
+breaker_state CircuitBreaker::state() const { return _stats.state; }
+
+std::chrono::steady_clock::time_point CircuitBreaker::retryAt() const {
+  return _retry_at;
+}
+
+BreakerStats CircuitBreaker::stats() const { return _stats; }
+
+void CircuitBreaker::open(std::chrono::milliseconds backoff) {
+  if (_stats.state == breaker_state::closed) {
+    LOG(WARNING) << "Circuit breaker opened after " << _consecutive_timeouts
+                 << " timeouts";
+    _stats.opened++;
+  }
+  _stats.state = breaker_state::open;
+  _stats.backoff = backoff;
+  _retry_at = std::chrono::steady_clock::now() + backoff;
+}
@@ -1,41 +1,90 @@
 #include "ColordHandler.h"
+#include "ProfileGenerator.h"
+#include <chrono>
 #include <cstdio>
+#include <cstring>
 #include <easylogging++.h>
+#include <fcntl.h>
 #include <filesystem>
+#include <fstream>
 #include <lcms2.h>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
+#include <sstream>
+#include <string>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
 
-/*! TODO: is it possible with only one fd??
- *  \todo is it possible with only one fd??
- */
-bool ColordHandler::resetMemFd() {
-  auto file = fopen(_mem_fd_path.c_str(), "w");
-  if (!file) {
-    // make new fd
-    // _mem_fd = memfd_create(_icc_path.c_str(), 0);
-    // std::stringstream sa;
-    // sa << "/proc/" << getpid() << "/fd/" << _mem_fd;
-    // _mem_fd_path = std::filesystem::path(sa.str());
-    // LOG(DEBUG) << "New Filedescriptor path: " << _mem_fd_path;
+bool ColordHandler::resetMemFd(int fd) {
+  if (ftruncate(fd, 0) != 0) {
+    LOG(DEBUG) << "Couldn't truncate the memfd, errno: " << strerror(errno);
     return false;
   }
-  // fclose(file);
-  return _mem_fd < 0;
+  return true;
+}
+
+std::optional<ColordHandler::DisplayProfile *>
+ColordHandler::getDisplayProfile(uint display_device_id) {
+  std::lock_guard<std::mutex> lk(_state_mut);
+  auto it = _display_profiles.find(display_device_id);
+  if (it != _display_profiles.end()) {
+    return &it->second;
+  }
+
+  DisplayProfile display_profile = {-1, "", CdProfileHandle()};
+  if (_persistent_icc_file) {
+    // one file per display, the first one without suffix
+    display_profile.icc_path = _persistent_icc_file.value();
+    if (display_device_id > 0) {
+      display_profile.icc_path.replace_filename(
+          _persistent_icc_file->stem().string() + "-" +
+          std::to_string(display_device_id) +
+          _persistent_icc_file->extension().string());
+    }
+    display_profile.icc_fd =
+        open(display_profile.icc_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+             S_IRUSR | S_IWUSR);
+  } else {
+    // open memfd, set close on exit (e.g.: closes fd, if process crashes)
+    display_profile.icc_fd = memfd_create(_icc_path.c_str(), MFD_CLOEXEC);
+    std::stringstream sa;
+    sa << "/proc/" << getpid() << "/fd/" << display_profile.icc_fd;
+    display_profile.icc_path = std::filesystem::path(sa.str());
+  }
+  if (display_profile.icc_fd < 0) {
+    LOG(ERROR) << "Couldn't open icc file for display " << display_device_id
+               << ", errno: " << strerror(errno);
+    return std::nullopt;
+  }
+  LOG(DEBUG) << "Filedescriptor path for display " << display_device_id
+             << ": " << display_profile.icc_path;
+  auto [inserted, _] = _display_profiles.emplace(display_device_id,
+                                                 std::move(display_profile));
+  return &inserted->second;
 }
 
 ColordHandler::ColordHandler(std::filesystem::path path_for_icc)
-    : _cancel_request(g_cancellable_new()), _cd_client(cd_client_new()),
-      _icc_path(path_for_icc), _current_profile(nullptr) {
+    : _cancel_request(g_cancellable_new()), _update_cancels(),
+      _prepared_cancels(), _update_mut(), _state_mut(), _connect_mut(),
+      _cd_client(cd_client_new()),
+      _icc_path(path_for_icc), _persistent_icc_file(),
+      _profile_scope(CD_OBJECT_SCOPE_TEMP), _bus(), _created_profiles(),
+      _profile_users(), _display_devices(), _last_discovery(),
+      _leftover_profiles(),
+      _cleanup_cancels(), _cleanup_mut(), _cleanup_cv(), _stop_cleanup(false),
+      _cleanup_timer() {
 
   // connect client
   if (cd_client_get_has_server(_cd_client.get())) {
-    GError *error = NULL;
+    GErrorHandle error;
     if (!cd_client_connect_sync(_cd_client.get(), _cancel_request.get(),
-                                &error)) {
+                                error.out())) {
       // client not connected, can be fixed
       LOG(WARNING) << "Couldn't connect colord client on init! Gerror: "
                    << error->message;
@@ -45,28 +94,98 @@ ColordHandler::ColordHandler(std::filesystem::path path_for_icc)
     throw std::runtime_error("Colord-Server is not running!");
   }
 
-  // open memfd, set close on exit (e.g.: closes fd, if process crashes)
-  _mem_fd = memfd_create(path_for_icc.c_str(), MFD_CLOEXEC);
-  if (_mem_fd < 0) {
+  // memfd of the first display
+  if (!getDisplayProfile(0)) {
     // file Couldn't get created, object Couldn't write the profile
     throw std::system_error(errno, std::system_category());
-  } else {
-    std::stringstream sa;
-    sa << "/proc/" << getpid() << "/fd/" << _mem_fd;
-    _mem_fd_path = std::filesystem::path(sa.str());
-    LOG(DEBUG) << "Filedescriptor path: " << _mem_fd_path;
   }
+  _cleanup_timer = std::thread(&ColordHandler::cleanupTimerThread, this);
+}
+
+bool ColordHandler::discoverDisplayDevices() {
+  clearDisplayDevices();
+  {
+    std::lock_guard<std::mutex> lk(_state_mut);
+    _last_discovery = std::chrono::steady_clock::now();
+  }
+  GErrorHandle error;
+  GPtrArrayHandle devices(cd_client_get_devices_by_kind_sync(
+      _cd_client.get(), CD_DEVICE_KIND_DISPLAY, _cancel_request.get(),
+      error.out()));
+  if (!devices) {
+    LOG(ERROR) << "Couldn't get display devices! Gerror: " << error->message;
+    return false;
+  }
+  std::vector<CdDeviceHandle> display_devices;
+  for (guint i = 0; i < devices->len; i++) {
+    CdDeviceHandle dev =
+        g_object_ref_handle(static_cast<CdDevice *>(devices->pdata[i]));
+    // connect now, so it's not done on the first profile change
+    GErrorHandle connect_error;
+    LOG_IF(!cd_device_connect_sync(dev.get(), _cancel_request.get(),
+                                   connect_error.out()),
+           WARNING)
+        << "Couldn't connect to display device " << i
+        << "! Gerror: " << connect_error->message;
+    display_devices.push_back(std::move(dev));
+  }
+  LOG(DEBUG) << "Found " << display_devices.size() << " display devices";
+  std::lock_guard<std::mutex> lk(_state_mut);
+  _display_devices = std::move(display_devices);
+  return !_display_devices.empty();
+}
+
+size_t ColordHandler::displayDeviceCount() {
+  std::lock_guard<std::mutex> lk(_state_mut);
+  return _display_devices.size();
+}
+
+void ColordHandler::clearDisplayDevices() {
+  std::lock_guard<std::mutex> lk(_state_mut);
+  _display_devices.clear();
+}
+
+bool ColordHandler::connectClient() {
+  // updates of several displays run concurrently, connect only once
+  std::lock_guard<std::mutex> lk(_connect_mut);
+  if (cd_client_get_connected(_cd_client.get())) {
+    return true;
+  }
+  GErrorHandle error;
+  GCancellableHandle bounded = cleanupCancellable();
+  if (!cd_client_connect_sync(_cd_client.get(), bounded.get(), error.out())) {
+    // client not connected
+    LOG(ERROR)
+        << "Couldn't connect Colord client on setting a profile! Gerror: "
+        << error->message;
+    return false;
+  }
+  return true;
 }
 
-std::optional<CdDevice *> ColordHandler::getDisplayDevice(uint dev_num) {
-  GError *error = NULL;
-  GPtrArray *devices = cd_client_get_devices_by_kind_sync(
-      _cd_client.get(), CD_DEVICE_KIND_DISPLAY, _cancel_request.get(), &error);
-  gpointer dev = devices->pdata[dev_num];
-  if (dev)
-    return static_cast<CdDevice *>(dev);
-  LOG(ERROR) << "No Display device found! Gerror: " << error->message;
-  return std::nullopt;
+CdDeviceHandle ColordHandler::getDisplayDevice(uint dev_num) {
+  {
+    std::lock_guard<std::mutex> lk(_state_mut);
+    if (dev_num < _display_devices.size()) {
+      return g_object_ref_handle(_display_devices[dev_num].get());
+    }
+    // requests for a display colord doesn't have must not query it each
+    // time
+    if (std::chrono::steady_clock::now() - _last_discovery <
+        DISCOVERY_INTERVAL) {
+      LOG(DEBUG) << "No Display device found with number: " << dev_num;
+      return CdDeviceHandle();
+    }
+  }
+  discoverDisplayDevices();
+  {
+    std::lock_guard<std::mutex> lk(_state_mut);
+    if (dev_num < _display_devices.size()) {
+      return g_object_ref_handle(_display_devices[dev_num].get());
+    }
+  }
+  LOG(ERROR) << "No Display device found with number: " << dev_num;
+  return CdDeviceHandle();
 }
 
 /*! TODO: better error propagation ??
@@ -74,111 +193,446 @@ std::optional<CdDevice *> ColordHandler::getDisplayDevice(uint dev_num) {
  */
 bool ColordHandler::setIccFromCmsProfile(cmsHPROFILE profile,
                                          uint display_device_id) {
-  LOG_IF(resetMemFd(), WARNING) << "Couldn't clear file deskriptor content.";
-
-  if (!cmsMD5computeID(profile))
-    LOG(WARNING) << "Couldn't recompute hash for lcms2 color profile!";
-
-  // if (!cmsSaveProfileToFile(profile, _mem_fd_path.c_str())) {
-  //   LOG(ERROR) << "Lcms2-profile Couldn't get saved into mem_fd!";
-  //   return false;
-  // }
-
-  CdIcc *icc_file;
-  {
-    CdIcc *icc = cd_icc_new();
-    GError *error = NULL;
-    // if (!cd_icc_load_fd(icc, _mem_fd, CD_ICC_LOAD_FLAGS_ALL, &error)) {
-    //   LOG(ERROR) << "CdIcc profile couldn't get loaded from mem_fd! Gerror: "
-    //              << error->message;
-    //   return false;
-    // }
-    if (!cd_icc_load_handle(icc, profile, CD_ICC_LOAD_FLAGS_ALL, &error)) {
-      LOG(ERROR) << "CdIcc profile couldn't get loaded from Handle! Gerror: "
+  std::vector<uint8_t> data = serialize_profile(profile);
+  if (data.empty()) {
+    LOG(ERROR) << "Lcms2-profile couldn't get serialized!";
+    return false;
+  }
+  return setIccFromData(data.data(), data.size(), display_device_id);
+}
+
+bool ColordHandler::setIccFromData(const uint8_t *data, size_t size,
+                                   uint display_device_id) {
+  // a new cancellable per update, so a preemption only hits this update,
+  // the prepared one could be cancelled already
+  GCancellableHandle cancellable;
+  {
+    std::lock_guard<std::mutex> lk(_update_mut);
+    auto prepared = _prepared_cancels.find(display_device_id);
+    if (prepared != _prepared_cancels.end()) {
+      cancellable = std::move(prepared->second);
+      _prepared_cancels.erase(prepared);
+    } else {
+      cancellable.reset(g_cancellable_new());
+    }
+    _update_cancels[display_device_id] =
+        g_object_ref_handle(cancellable.get());
+  }
+
+  // an unknown display, e.g. requested through the control socket, gets
+  // no memfd
+  if (!connectClient() || !getDisplayDevice(display_device_id)) {
+    return false;
+  }
+  std::optional<DisplayProfile *> display_profile =
+      getDisplayProfile(display_device_id);
+  if (!display_profile) {
+    return false;
+  }
+  // sealed profiles get a fresh memfd each, the one of the display would
+  // get rewritten while colord might still read it
+  std::unique_ptr<SealedProfile> sealed;
+  if (_bus) {
+    try {
+      sealed = std::make_unique<SealedProfile>(_icc_path, data, size);
+    } catch (std::system_error &e) {
+      LOG(ERROR) << "Sealed profile couldn't get created! Exception:"
+                 << e.what();
+      return false;
+    }
+  } else {
+    int icc_fd = display_profile.value()->icc_fd;
+    LOG_IF(!resetMemFd(icc_fd), WARNING)
+        << "Couldn't clear file deskriptor content.";
+
+    // write the blob into the memfd, colord reads the profile from there
+    size_t written = 0;
+    while (written < size) {
+      ssize_t len = pwrite(icc_fd, data + written, size - written, written);
+      if (len < 0) {
+        if (errno == EINTR)
+          continue;
+        LOG(ERROR) << "Icc data couldn't get written into mem_fd, errno: "
+                   << strerror(errno);
+        return false;
+      }
+      written += len;
+    }
+  }
+
+  CdIccHandle icc_file(cd_icc_new());
+  {
+    GErrorHandle error;
+    if (!cd_icc_load_data(icc_file.get(), data, size, CD_ICC_LOAD_FLAGS_ALL,
+                          error.out())) {
+      LOG(ERROR) << "CdIcc profile couldn't get loaded from data! Gerror: "
                  << error->message;
       return false;
     }
-    GFile *file = g_file_new_for_path(_mem_fd_path.c_str());
-    auto saved = cd_icc_save_file(icc, file, CD_ICC_SAVE_FLAGS_NONE,
-                                  _cancel_request.get(), &error);
-    LOG_IF(!saved, ERROR) << "Icc file not saved!";
-    cd_icc_set_filename(icc, _mem_fd_path.c_str());
-    icc_file = icc;
+    cd_icc_set_filename(icc_file.get(),
+                        sealed ? sealed->path().c_str()
+                               : display_profile.value()->icc_path.c_str());
   }
 
   // LOG(DEBUG) << "Icc-content: \n" << cd_icc_to_string(icc_file);
-  return makeProfileFromIccDefault(icc_file, display_device_id);
+  return makeProfileFromIccDefault(icc_file.get(), display_device_id,
+                                   cancellable.get(), std::move(sealed));
 }
 
-bool ColordHandler::makeProfileFromIccDefault(CdIcc *icc_file,
-                                              uint display_device_id) {
+void ColordHandler::prepareUpdate(uint display_device_id) {
+  std::lock_guard<std::mutex> lk(_update_mut);
+  _prepared_cancels[display_device_id].reset(g_cancellable_new());
+}
 
-  if (!cd_client_get_connected(_cd_client.get())) {
-    GError *error = NULL;
-    if (!cd_client_connect_sync(_cd_client.get(), _cancel_request.get(),
-                                &error)) {
-      // client not connected
-      LOG(ERROR)
-          << "Couldn't connect Colord client on setting a profile! Gerror: "
-          << error->message;
+bool ColordHandler::cancelUpdate(uint display_device_id) {
+  std::lock_guard<std::mutex> lk(_update_mut);
+  bool cancelled = false;
+  for (auto *cancels : {&_update_cancels, &_prepared_cancels}) {
+    auto it = cancels->find(display_device_id);
+    if (it != cancels->end()) {
+      g_cancellable_cancel(it->second.get());
+      cancelled = true;
+    }
+  }
+  return cancelled;
+}
+
+CdProfileHandle
+ColordHandler::createProfile(CdIcc *icc_file, uint display_device_id,
+                             std::unique_ptr<SealedProfile> &sealed,
+                             GCancellable *cancellable, GError **error) {
+  // a sealed profile can't change, so displays at the same level share it.
+  // The memfd of a display gets rewritten by its next update, a profile
+  // reading it only belongs to that display.
+  std::string profile_id =
+      std::string("icc-") + cd_icc_get_checksum(icc_file);
+  if (!sealed) {
+    profile_id += "-" + std::to_string(display_device_id);
+  }
+  CdProfileHandle existing(cd_client_find_profile_sync(
+      _cd_client.get(), profile_id.c_str(), cancellable, NULL));
+  if (existing && !sealed && !isCreatedProfile(existing.get())) {
+    // left by an earlier run (its memfd is gone) or replaced before, the
+    // id only matches profiles of this display
+    GErrorHandle delete_error;
+    LOG_IF(!cd_client_delete_profile_sync(_cd_client.get(), existing.get(),
+                                          cancellable, delete_error.out()),
+           WARNING)
+        << "Couldn't delete stale profile " << profile_id
+        << "! Gerror: " << delete_error->message;
+    existing.reset();
+  }
+  if (existing) {
+    // colord keeps the profile for the same content, e.g. the same level on
+    // another display, which must never get deleted by this update
+    sealed.reset();
+    return existing;
+  }
+  if (g_cancellable_set_error_if_cancelled(cancellable, error)) {
+    return CdProfileHandle();
+  }
+
+  CdProfileHandle profile;
+  if (!sealed) {
+    // libcolord passes the file as fd, like for
+    // cd_client_create_profile_for_icc_sync() which fixes the id
+    GHashTableHandle properties(g_hash_table_new(g_str_hash, g_str_equal));
+    g_hash_table_insert(
+        properties.get(), const_cast<gchar *>(CD_PROFILE_PROPERTY_FILENAME),
+        const_cast<gchar *>(cd_icc_get_filename(icc_file)));
+    g_hash_table_insert(
+        properties.get(),
+        const_cast<gchar *>(CD_PROFILE_METADATA_FILE_CHECKSUM),
+        const_cast<gchar *>(cd_icc_get_checksum(icc_file)));
+    profile.reset(cd_client_create_profile_sync(
+        _cd_client.get(), profile_id.c_str(), _profile_scope,
+        properties.get(), cancellable, error));
+  } else if (std::optional<std::string> object_path = create_profile_with_fd(
+                 _bus.get(), profile_id, _profile_scope, sealed->fd(),
+                 sealed->path(), cancellable, error)) {
+    profile.reset(cd_profile_new_with_object_path(object_path->c_str()));
+    if (!cd_profile_connect_sync(profile.get(), cancellable, error)) {
+      profile.reset();
+    }
+  } else if (!g_cancellable_is_cancelled(cancellable)) {
+    // colord refuses a second profile with the same id, if another update
+    // created it in the meantime, the existing one keeps its own sealed fd
+    existing.reset(cd_client_find_profile_sync(
+        _cd_client.get(), profile_id.c_str(), cancellable, NULL));
+    if (existing) {
+      g_clear_error(error);
+      sealed.reset();
+      return existing;
+    }
+  }
+  if (!profile && g_cancellable_is_cancelled(cancellable)) {
+    // colord could have created it before the cancellation arrived, returned
+    // with the error set for the cleanup
+    profile.reset(cd_client_find_profile_sync(
+        _cd_client.get(), profile_id.c_str(), NULL, NULL));
+  }
+  if (profile) {
+    std::lock_guard<std::mutex> lk(_state_mut);
+    _created_profiles.insert(cd_profile_get_object_path(profile.get()));
+  }
+  return profile;
+}
+
+bool ColordHandler::isCreatedProfile(CdProfile *profile) {
+  std::lock_guard<std::mutex> lk(_state_mut);
+  return _created_profiles.count(cd_profile_get_object_path(profile)) > 0;
+}
+
+void ColordHandler::holdProfile(CdProfile *profile) {
+  std::lock_guard<std::mutex> lk(_state_mut);
+  _profile_users[cd_profile_get_object_path(profile)]++;
+}
+
+bool ColordHandler::releaseProfile(CdProfile *profile) {
+  std::string object_path = cd_profile_get_object_path(profile);
+  std::lock_guard<std::mutex> lk(_state_mut);
+  auto users = _profile_users.find(object_path);
+  if (users != _profile_users.end() && --users->second > 0) {
+    return false;
+  }
+  if (users != _profile_users.end()) {
+    _profile_users.erase(users);
+  }
+  for (const auto &[display_device_id, display_profile] : _display_profiles) {
+    if (display_profile.current_profile &&
+        object_path == cd_profile_get_object_path(
+                           display_profile.current_profile.get())) {
       return false;
     }
   }
+  return _created_profiles.erase(object_path) > 0;
+}
 
-  std::optional<CdDevice *> cd_display = getDisplayDevice(display_device_id);
-  if (!cd_display.has_value()) {
+bool ColordHandler::makeProfileFromIccDefault(
+    CdIcc *icc_file, uint display_device_id, GCancellable *cancellable,
+    std::unique_ptr<SealedProfile> sealed) {
+
+  CdDeviceHandle cd_display = getDisplayDevice(display_device_id);
+  if (!cd_display) {
     LOG(WARNING) << "No display found with id: " << display_device_id;
     return false;
   }
-  CdDevice *display = cd_display.value();
+  CdDevice *display = cd_display.get();
+  std::optional<DisplayProfile *> display_profile =
+      getDisplayProfile(display_device_id);
+  if (!display_profile) {
+    return false;
+  }
+  CdProfileHandle &current_profile = display_profile.value()->current_profile;
 
   {
-    GError *error = NULL;
-    if (!cd_device_connect_sync(display, _cancel_request.get(), &error)) {
-      LOG(ERROR) << "Couldn't connect to CdDevice! Gerror: " << error->message;
+    // cancellable by the update, so a stalled colord can't block it past
+    // its deadline
+    GErrorHandle error;
+    if (!cd_device_connect_sync(display, cancellable, error.out())) {
+      LOG_IF(!g_cancellable_is_cancelled(cancellable), ERROR)
+          << "Couldn't connect to CdDevice! Gerror: " << error->message;
       return false;
     }
   }
 
-  CdProfile *tmp_profile = NULL;
+  // replaced profiles a preempted update left on the display, before the
+  // new profile could turn out to be one of them
+  removeLeftoverProfiles(display, display_device_id, cancellable);
+
+  CdProfileHandle tmp_profile;
   {
-    GError *error = NULL;
-    tmp_profile = cd_client_create_profile_for_icc_sync(
-        _cd_client.get(), icc_file, CdObjectScope::CD_OBJECT_SCOPE_TEMP,
-        _cancel_request.get(), &error);
+    GErrorHandle error;
+    tmp_profile = createProfile(icc_file, display_device_id, sealed,
+                                cancellable, error.out());
+    if (g_error_matches(error.get(), G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      if (tmp_profile) {
+        holdProfile(tmp_profile.get());
+      }
+      removePartialProfile(display, tmp_profile.get(), current_profile.get(),
+                           false);
+      LOG(DEBUG) << "Update of display " << display_device_id
+                 << " preempted while creating the profile";
+      return false;
+    }
     if (!tmp_profile) {
       LOG(ERROR) << "CdClient couldn't create a Profile from icc file, '"
-                 << tmp_profile << "'! Gerror: " << error->message;
+                 << cd_icc_get_filename(icc_file)
+                 << "'! Gerror: " << error->message;
       return false;
     }
+    holdProfile(tmp_profile.get());
+  }
+  // safe point, nothing visible changed yet
+  if (g_cancellable_is_cancelled(cancellable)) {
+    removePartialProfile(display, tmp_profile.get(), current_profile.get(),
+                         false);
+    LOG(DEBUG) << "Update of display " << display_device_id
+               << " preempted before adding the profile";
+    return false;
   }
 
-  {
-    GError *error = NULL;
+  // the level didn't change, colord refuses to add a profile twice
+  bool already_added =
+      current_profile &&
+      g_strcmp0(cd_profile_get_object_path(current_profile.get()),
+                cd_profile_get_object_path(tmp_profile.get())) == 0;
+  if (!already_added) {
+    GErrorHandle error;
     if (!cd_device_add_profile_sync(display, CD_DEVICE_RELATION_SOFT,
-                                    tmp_profile, _cancel_request.get(),
-                                    &error)) {
+                                    tmp_profile.get(), cancellable,
+                                    error.out())) {
+      if (g_cancellable_is_cancelled(cancellable)) {
+        removePartialProfile(display, tmp_profile.get(),
+                             current_profile.get(), true);
+        LOG(DEBUG) << "Update of display " << display_device_id
+                   << " preempted while adding the profile";
+        return false;
+      }
       LOG(ERROR) << "Couldn't add Profile to device! Gerror: "
                  << error->message;
+      // device could be gone, discover them again on the next change
+      clearDisplayDevices();
+      removePartialProfile(display, tmp_profile.get(), current_profile.get(),
+                           false);
       return false;
     }
-    if (_current_profile) {
-      gboolean removed = cd_device_remove_profile_sync(
-          display, _current_profile, _cancel_request.get(), &error);
-      LOG_IF(!removed, WARNING)
-          << "Couldn't remove current profile form device! Gerror: "
+  }
+  // last safe point, the profile is added but not default
+  if (g_cancellable_is_cancelled(cancellable)) {
+    removePartialProfile(display, tmp_profile.get(), current_profile.get(),
+                         true);
+    LOG(DEBUG) << "Update of display " << display_device_id
+               << " preempted before making the profile default";
+    return false;
+  }
+
+  // the new profile gets default before the replaced one gets removed, so
+  // the display never ends up without a profile
+  {
+    GErrorHandle error;
+    if (!cd_device_make_profile_default_sync(display, tmp_profile.get(),
+                                             cancellable, error.out())) {
+      bool preempted = g_cancellable_is_cancelled(cancellable);
+      LOG_IF(preempted, DEBUG)
+          << "Update of display " << display_device_id
+          << " preempted while making the profile default";
+      LOG_IF(!preempted, ERROR)
+          << "Couldn't make profile default for device! Gerror: "
           << error->message;
+      removePartialProfile(display, tmp_profile.get(), current_profile.get(),
+                           true);
+      return false;
+    }
+  }
+
+  CdProfileHandle replaced;
+  {
+    std::lock_guard<std::mutex> lk(_state_mut);
+    replaced = std::move(current_profile);
+    current_profile = std::move(tmp_profile);
+  }
+  if (sealed) {
+    // closes the fd of the replaced profile
+    display_profile.value()->sealed_profile = std::move(sealed);
+  }
+  if (replaced && g_strcmp0(cd_profile_get_object_path(replaced.get()),
+                            cd_profile_get_object_path(
+                                current_profile.get())) == 0) {
+    // the level didn't change, the display holds the profile once
+    releaseProfile(replaced.get());
+  } else if (replaced) {
+    removeReplacedProfile(display, display_device_id, std::move(replaced),
+                          cancellable);
+  }
+  return true;
+}
+
+bool ColordHandler::removeReplacedProfile(CdDevice *display,
+                                          uint display_device_id,
+                                          CdProfileHandle profile,
+                                          GCancellable *cancellable) {
+  GErrorHandle error;
+  if (!cd_device_remove_profile_sync(display, profile.get(), cancellable,
+                                     error.out()) &&
+      !g_error_matches(error.get(), CD_DEVICE_ERROR,
+                       CD_DEVICE_ERROR_PROFILE_DOES_NOT_EXIST)) {
+    // still on the device and held, so nothing else deletes it
+    LOG_IF(!g_cancellable_is_cancelled(cancellable), WARNING)
+        << "Couldn't remove replaced profile from device! Gerror: "
+        << error->message;
+    std::lock_guard<std::mutex> lk(_state_mut);
+    _leftover_profiles[display_device_id].push_back(std::move(profile));
+    return false;
+  }
+  // only temporary profiles get removed by colord on exit, shared ones
+  // stay for the other displays
+  if (releaseProfile(profile.get()) &&
+      _profile_scope != CD_OBJECT_SCOPE_TEMP) {
+    GErrorHandle delete_error;
+    GCancellableHandle bounded = cleanupCancellable();
+    LOG_IF(!cd_client_delete_profile_sync(_cd_client.get(), profile.get(),
+                                          bounded.get(), delete_error.out()),
+           WARNING)
+        << "Couldn't delete replaced profile! Gerror: "
+        << delete_error->message;
+  }
+  return true;
+}
+
+void ColordHandler::removeLeftoverProfiles(CdDevice *display,
+                                           uint display_device_id,
+                                           GCancellable *cancellable) {
+  std::vector<CdProfileHandle> leftovers;
+  {
+    std::lock_guard<std::mutex> lk(_state_mut);
+    auto it = _leftover_profiles.find(display_device_id);
+    if (it == _leftover_profiles.end()) {
+      return;
     }
-    // delete _current_profile;
-    _current_profile = tmp_profile;
+    leftovers = std::move(it->second);
+    _leftover_profiles.erase(it);
   }
+  // the failed ones get tracked again
+  for (CdProfileHandle &profile : leftovers) {
+    removeReplacedProfile(display, display_device_id, std::move(profile),
+                          cancellable);
+  }
+}
 
-  GError *error = NULL;
-  auto set_profile = cd_device_make_profile_default_sync(
-      display, _current_profile, _cancel_request.get(), &error);
-  LOG_IF(!set_profile, ERROR)
-      << "Couldn't make profile default for device! Gerror: " << error->message;
-  return set_profile;
+void ColordHandler::removePartialProfile(CdDevice *display, CdProfile *profile,
+                                         CdProfile *current_profile,
+                                         bool added) {
+  if (!profile) {
+    return;
+  }
+  bool unused = releaseProfile(profile);
+  // the applied profile, e.g. if the level didn't change
+  if (current_profile && g_strcmp0(cd_profile_get_object_path(profile),
+                                   cd_profile_get_object_path(
+                                       current_profile)) == 0) {
+    return;
+  }
+  // not preemptable, the cleanup must not get cancelled by the next update
+  GCancellableHandle bounded = cleanupCancellable();
+  if (added) {
+    GErrorHandle error;
+    LOG_IF(!cd_device_remove_profile_sync(display, profile, bounded.get(),
+                                          error.out()),
+           WARNING)
+        << "Couldn't remove preempted profile from device! Gerror: "
+        << error->message;
+  }
+  // only a profile this update created, colord's own or one of another
+  // display stays
+  if (!unused) {
+    return;
+  }
+  GErrorHandle error;
+  LOG_IF(!cd_client_delete_profile_sync(_cd_client.get(), profile,
+                                        bounded.get(), error.out()),
+         WARNING)
+      << "Couldn't delete preempted profile! Gerror: " << error->message;
 }
 
 std::string print_color(const CdColorYxy *color) {
@@ -191,28 +645,28 @@ std::string print_color(const CdColorYxy *color) {
   return ss.str();
 }
 
-std::optional<CdIcc>
+CdIccHandle
 ColordHandler::createIccFromEdid(std::filesystem::path edid_file_path) {
-  CdEdid *monitor = cd_edid_new();
-  std::ifstream edid_file("/sys/class/drm/card1-eDP-1/edid",
-                          std::ios::in | std::ios::binary);
+  CdEdidHandle monitor(cd_edid_new());
+  std::ifstream edid_file(edid_file_path, std::ios::in | std::ios::binary);
 
   char bytes[128];
   edid_file.read(&bytes[0], 128);
   {
-    GError *error = NULL;
+    GErrorHandle error;
+    GBytesHandle edid_bytes(g_bytes_new(bytes, sizeof(bytes)));
     gboolean parsed =
-        cd_edid_parse(monitor, g_bytes_new(bytes, sizeof(bytes)), &error);
+        cd_edid_parse(monitor.get(), edid_bytes.get(), error.out());
     if (!parsed) {
       LOG(ERROR) << "Edid couldn't ger parsed! Gerror: " << error->message;
-      return std::nullopt;
+      return CdIccHandle();
     }
   }
-  const CdColorYxy *m_red = cd_edid_get_red(monitor);
-  const CdColorYxy *m_blue = cd_edid_get_blue(monitor);
-  const CdColorYxy *m_green = cd_edid_get_green(monitor);
-  const CdColorYxy *m_white = cd_edid_get_white(monitor);
-  gdouble m_gamma = cd_edid_get_gamma(monitor);
+  const CdColorYxy *m_red = cd_edid_get_red(monitor.get());
+  const CdColorYxy *m_blue = cd_edid_get_blue(monitor.get());
+  const CdColorYxy *m_green = cd_edid_get_green(monitor.get());
+  const CdColorYxy *m_white = cd_edid_get_white(monitor.get());
+  gdouble m_gamma = cd_edid_get_gamma(monitor.get());
 
   LOG(INFO) << "GAMMA: " << m_gamma;
   LOG(INFO) << "RED: " << print_color(m_red);
@@ -220,28 +674,223 @@ ColordHandler::createIccFromEdid(std::filesystem::path edid_file_path) {
   LOG(INFO) << "GREEN: " << print_color(m_green);
   LOG(INFO) << "WHITE: " << print_color(m_white);
 
-  CdIcc icc = *cd_icc_new();
+  CdIccHandle icc(cd_icc_new());
   {
-    GError *error = NULL;
-    gboolean created = cd_icc_create_from_edid(&icc, m_gamma, m_red, m_green,
-                                               m_blue, m_white, &error);
+    GErrorHandle error;
+    gboolean created =
+        cd_icc_create_from_edid(icc.get(), m_gamma, m_red, m_green, m_blue,
+                                m_white, error.out());
     if (!created) {
       LOG(ERROR) << "Couldn't create icc file form edid values! Gerror: "
                  << error->message;
+      return CdIccHandle();
     }
   }
 
   return icc;
 }
 
+bool ColordHandler::usePersistentProfiles(std::filesystem::path icc_file) {
+  {
+    // reopen the files of all displays
+    std::lock_guard<std::mutex> lk(_state_mut);
+    for (auto &[display_device_id, display_profile] : _display_profiles) {
+      close(display_profile.icc_fd);
+    }
+    _display_profiles.clear();
+    _persistent_icc_file = icc_file;
+    _profile_scope = CD_OBJECT_SCOPE_NORMAL;
+    _bus.reset(); // sealed profiles don't outlive the process
+  }
+  LOG(DEBUG) << "Persistent icc file: " << icc_file;
+  return getDisplayProfile(0).has_value();
+}
+
+bool ColordHandler::useSealedProfiles() {
+  GErrorHandle error;
+  GDBusConnectionHandle bus(
+      g_bus_get_sync(G_BUS_TYPE_SYSTEM, _cancel_request.get(), error.out()));
+  if (!bus) {
+    LOG(ERROR) << "Couldn't connect to the system bus! Gerror: "
+               << error->message;
+    return false;
+  }
+  std::lock_guard<std::mutex> lk(_state_mut);
+  if (_persistent_icc_file) {
+    LOG(WARNING) << "Sealed profiles don't outlive the process, they can't "
+                    "be persistent!";
+    return false;
+  }
+  _bus = std::move(bus);
+  LOG(DEBUG) << "Profiles get passed as sealed memfds";
+  return true;
+}
+
+std::optional<std::string>
+ColordHandler::currentProfilePath(uint display_device_id) {
+  std::lock_guard<std::mutex> lk(_state_mut);
+  auto it = _display_profiles.find(display_device_id);
+  if (it == _display_profiles.end() || !it->second.current_profile) {
+    return std::nullopt;
+  }
+  return std::string(
+      cd_profile_get_object_path(it->second.current_profile.get()));
+}
+
+bool ColordHandler::adoptProfile(const std::string &object_path,
+                                 uint display_device_id) {
+  if (!g_variant_is_object_path(object_path.c_str())) {
+    LOG(WARNING) << "Saved profile path \"" << object_path
+                 << "\" is invalid!";
+    return false;
+  }
+  CdProfileHandle profile(
+      cd_profile_new_with_object_path(object_path.c_str()));
+  GErrorHandle error;
+  if (!cd_profile_connect_sync(profile.get(), _cancel_request.get(),
+                               error.out())) {
+    LOG(INFO) << "Saved profile " << object_path
+              << " is gone! Gerror: " << error->message;
+    return false;
+  }
+  std::optional<DisplayProfile *> display_profile =
+      getDisplayProfile(display_device_id);
+  if (!display_profile) {
+    return false;
+  }
+  holdProfile(profile.get());
+  {
+    // created by the previous instance, replaced like an own one
+    std::lock_guard<std::mutex> lk(_state_mut);
+    _created_profiles.insert(object_path);
+    display_profile.value()->current_profile = std::move(profile);
+  }
+  LOG(DEBUG) << "Adopted profile " << object_path;
+  return true;
+}
+
+size_t ColordHandler::removeOrphanedProfiles() {
+  std::filesystem::path icc_dir;
+  {
+    std::lock_guard<std::mutex> lk(_state_mut);
+    if (!_persistent_icc_file) {
+      return 0;
+    }
+    icc_dir = _persistent_icc_file->parent_path();
+  }
+  if (!connectClient()) {
+    return 0;
+  }
+  GErrorHandle error;
+  GCancellableHandle bounded = cleanupCancellable();
+  GPtrArrayHandle profiles(cd_client_get_profiles_sync(
+      _cd_client.get(), bounded.get(), error.out()));
+  if (!profiles) {
+    LOG(WARNING) << "Couldn't get the profiles of colord! Gerror: "
+                 << error->message;
+    return 0;
+  }
+  size_t removed = 0;
+  for (guint i = 0; i < profiles->len; i++) {
+    CdProfile *profile = static_cast<CdProfile *>(profiles->pdata[i]);
+    GCancellableHandle profile_bounded = cleanupCancellable();
+    if (!cd_profile_connect_sync(profile, profile_bounded.get(), NULL)) {
+      continue;
+    }
+    // temporary ones belong to a running client, colord drops them with it
+    const gchar *id = cd_profile_get_id(profile);
+    const gchar *filename = cd_profile_get_filename(profile);
+    if (id == NULL || !g_str_has_prefix(id, "icc-") ||
+        cd_profile_get_scope(profile) == CD_OBJECT_SCOPE_TEMP ||
+        filename == NULL ||
+        std::filesystem::path(filename).parent_path() != icc_dir ||
+        isCreatedProfile(profile)) {
+      continue;
+    }
+    GErrorHandle delete_error;
+    if (cd_client_delete_profile_sync(_cd_client.get(), profile,
+                                      profile_bounded.get(),
+                                      delete_error.out())) {
+      LOG(DEBUG) << "Deleted orphaned profile "
+                 << cd_profile_get_object_path(profile);
+      removed++;
+    } else {
+      LOG(WARNING) << "Couldn't delete orphaned profile "
+                   << cd_profile_get_object_path(profile)
+                   << "! Gerror: " << delete_error->message;
+    }
+  }
+  return removed;
+}
+
+GCancellableHandle ColordHandler::cleanupCancellable() {
+  GCancellableHandle cancellable(g_cancellable_new());
+  {
+    std::lock_guard<std::mutex> lk(_cleanup_mut);
+    _cleanup_cancels.emplace(std::chrono::steady_clock::now() +
+                                 CLEANUP_TIMEOUT,
+                             g_object_ref_handle(cancellable.get()));
+  }
+  _cleanup_cv.notify_all();
+  return cancellable;
+}
+
+void ColordHandler::cleanupTimerThread() {
+  std::unique_lock<std::mutex> lk(_cleanup_mut);
+  while (!_stop_cleanup) {
+    auto now = std::chrono::steady_clock::now();
+    while (!_cleanup_cancels.empty() &&
+           _cleanup_cancels.begin()->first <= now) {
+      // a call done by then only drops its reference
+      g_cancellable_cancel(_cleanup_cancels.begin()->second.get());
+      _cleanup_cancels.erase(_cleanup_cancels.begin());
+    }
+    if (_cleanup_cancels.empty()) {
+      _cleanup_cv.wait(lk);
+    } else {
+      _cleanup_cv.wait_until(lk, _cleanup_cancels.begin()->first);
+    }
+  }
+}
+
 bool ColordHandler::cancelCurrentAction() {
   g_cancellable_cancel(_cancel_request.get());
+  {
+    std::lock_guard<std::mutex> lk(_cleanup_mut);
+    for (const auto &[timeout, cancellable] : _cleanup_cancels) {
+      g_cancellable_cancel(cancellable.get());
+    }
+  }
   return g_cancellable_is_cancelled(_cancel_request.get());
 }
 
 ColordHandler::~ColordHandler() {
+  // last try for the profiles preempted updates left on the displays
+  std::vector<uint> leftover_displays;
+  {
+    std::lock_guard<std::mutex> lk(_state_mut);
+    for (const auto &[display_device_id, leftovers] : _leftover_profiles) {
+      leftover_displays.push_back(display_device_id);
+    }
+  }
+  for (uint display_device_id : leftover_displays) {
+    CdDeviceHandle display = getDisplayDevice(display_device_id);
+    if (display) {
+      GCancellableHandle bounded = cleanupCancellable();
+      removeLeftoverProfiles(display.get(), display_device_id, bounded.get());
+    }
+  }
   if (!g_cancellable_is_cancelled(_cancel_request.get())) {
     cancelCurrentAction();
   }
-  close(_mem_fd);
+  clearDisplayDevices();
+  for (auto &[display_device_id, display_profile] : _display_profiles) {
+    close(display_profile.icc_fd);
+  }
+  {
+    std::lock_guard<std::mutex> lk(_cleanup_mut);
+    _stop_cleanup = true;
+  }
+  _cleanup_cv.notify_all();
+  _cleanup_timer.join();
 }
@@ -0,0 +1,283 @@
+#include "ControlSocket.h"
+#include "ProfileGenerator.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <easylogging++.h>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+// -----------------Helper  functions----------------
+
+uint32_t percentToLevel(double percent) {
+  return quantize_brightness(percent / 100.0);
+}
+
+double levelToPercent(uint32_t level) {
+  return level_to_brightness(level) * 100.0;
+}
+
+/*! \brief display id of a request, only digits and in the range of uint
+ * ("-1" would wrap around when read as uint)
+ */
+std::optional<uint> parseDisplay(const std::string &token) {
+  if (token.empty() || token.size() > 10 ||
+      !std::all_of(token.begin(), token.end(),
+                   [](char c) { return c >= '0' && c <= '9'; })) {
+    return std::nullopt;
+  }
+  unsigned long long value = std::stoull(token);
+  if (value > std::numeric_limits<uint>::max()) {
+    return std::nullopt;
+  }
+  return static_cast<uint>(value);
+}
+
+void sendReply(int client_fd, const std::string &reply) {
+  // never block the control thread on a slow client, drop the reply instead
+  ssize_t sent = send(client_fd, reply.data(), reply.size(),
+                      MSG_NOSIGNAL | MSG_DONTWAIT);
+  LOG_IF(sent != static_cast<ssize_t>(reply.size()), DEBUG)
+      << "Reply to control client dropped";
+}
+
+// -------------------------------------
+
+ControlSocket::ControlSocket(std::filesystem::path socket_path,
+                             std::shared_ptr<BrightnessTargets> targets)
+    : _socket_path(socket_path), _targets(targets), _listen_fd(-1),
+      _stop_fd(-1), _stats_providers(), _serving_thread() {
+  sockaddr_un addr = {};
+  if (_socket_path.native().size() >= sizeof(addr.sun_path)) {
+    throw std::system_error(ENAMETOOLONG, std::generic_category(),
+                            "Control socket path too long");
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(_socket_path.parent_path(), ec);
+  // remove a stale socket of a previous instance
+  std::filesystem::remove(_socket_path, ec);
+
+  _listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (_listen_fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Control socket couldn't get created");
+  }
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, _socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  if (bind(_listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) !=
+          0 ||
+      chmod(_socket_path.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+      listen(_listen_fd, CONTROL_SOCKET_MAX_CLIENTS) != 0) {
+    int err = errno;
+    close(_listen_fd);
+    throw std::system_error(err, std::generic_category(),
+                            "Control socket couldn't get bound");
+  }
+
+  _stop_fd = eventfd(0, EFD_CLOEXEC);
+  if (_stop_fd < 0) {
+    int err = errno;
+    close(_listen_fd);
+    throw std::system_error(err, std::generic_category(),
+                            "Eventfd for the control socket failed");
+  }
+}
+
+std::optional<std::filesystem::path> ControlSocket::defaultPath() {
+  const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+  if (!runtime_dir || runtime_dir[0] == '\0') {
+    return std::nullopt;
+  }
+  return std::filesystem::path(runtime_dir) / "colord-brightness" / "control";
+}
+
+void ControlSocket::addStatsProvider(std::function<std::string()> provider) {
+  _stats_providers.push_back(provider);
+}
+
+bool ControlSocket::start() {
+  if (_serving_thread.joinable()) {
+    return false;
+  }
+  _serving_thread = std::thread(&ControlSocket::serveThread, this);
+  return true;
+}
+
+bool ControlSocket::stop() {
+  if (!_serving_thread.joinable()) {
+    return false;
+  }
+  uint64_t one = 1;
+  if (write(_stop_fd, &one, sizeof(one)) != sizeof(one)) {
+    LOG(ERROR) << "Couldn't stop control socket thread, errno: "
+               << strerror(errno);
+    return false;
+  }
+  _serving_thread.join();
+  return true;
+}
+
+void ControlSocket::serveThread() {
+  struct Client {
+    int fd;
+    std::string buffer; /*!< incomplete line */
+  };
+  std::vector<Client> clients;
+
+  while (true) {
+    std::vector<pollfd> fds = {{_stop_fd, POLLIN, 0}, {_listen_fd, POLLIN, 0}};
+    for (const Client &client : clients) {
+      fds.push_back({client.fd, POLLIN, 0});
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      LOG(ERROR) << "Poll on control socket failed, errno: "
+                 << strerror(errno);
+      break;
+    }
+    if (fds[0].revents) {
+      break;
+    }
+    if (fds[1].revents & POLLIN) {
+      int client_fd = accept4(_listen_fd, NULL, NULL,
+                              SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (client_fd >= 0 && clients.size() < CONTROL_SOCKET_MAX_CLIENTS) {
+        clients.push_back({client_fd, ""});
+      } else if (client_fd >= 0) {
+        LOG(WARNING) << "Too many control clients, connection refused";
+        close(client_fd);
+      }
+    }
+
+    // all requests read in this round form one batch
+    std::map<uint, uint32_t> batch;
+    for (size_t i = 0; i < clients.size(); i++) {
+      if (fds[i + 2].revents &&
+          !handleClient(clients[i].fd, clients[i].buffer, batch)) {
+        close(clients[i].fd);
+        clients[i].fd = -1;
+      }
+    }
+    clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                 [](const Client &c) { return c.fd < 0; }),
+                  clients.end());
+    _targets->postBatch(batch);
+  }
+
+  for (const Client &client : clients) {
+    close(client.fd);
+  }
+}
+
+bool ControlSocket::handleClient(int client_fd, std::string &buffer,
+                                 std::map<uint, uint32_t> &batch) {
+  char buf[4096];
+  while (true) {
+    ssize_t len = read(client_fd, buf, sizeof(buf));
+    if (len == 0) {
+      return false;
+    } else if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      return false;
+    }
+    buffer.append(buf, len);
+  }
+
+  size_t start = 0;
+  size_t end;
+  while ((end = buffer.find('\n', start)) != std::string::npos) {
+    std::string line = buffer.substr(start, end - start);
+    start = end + 1;
+    if (std::optional<std::string> reply = handleCommand(line, batch)) {
+      sendReply(client_fd, reply.value());
+    }
+  }
+  buffer.erase(0, start);
+  if (buffer.size() > CONTROL_SOCKET_MAX_LINE) {
+    sendReply(client_fd, "error line too long\n");
+    return false;
+  }
+  return true;
+}
+
+std::optional<std::string>
+ControlSocket::handleCommand(const std::string &line,
+                             std::map<uint, uint32_t> &batch) {
+  std::istringstream ss(line);
+  std::string command;
+  std::string display_token;
+  if (!(ss >> command)) {
+    return std::nullopt; // empty line
+  }
+  if (command == "stats") {
+    std::string reply;
+    for (const auto &provider : _stats_providers) {
+      reply += provider() + "\n";
+    }
+    return reply;
+  }
+  if (!(ss >> display_token)) {
+    return "error missing display\n";
+  }
+  std::optional<uint> parsed_display = parseDisplay(display_token);
+  if (!parsed_display) {
+    return "error invalid display\n";
+  }
+  uint display = parsed_display.value();
+
+  // latest level of this batch, otherwise the last posted one
+  auto current = [&]() -> uint32_t {
+    auto it = batch.find(display);
+    if (it != batch.end()) {
+      return it->second;
+    }
+    return _targets->current(display).value_or(BRIGHTNESS_LEVEL_SCALE);
+  };
+
+  if (command == "get") {
+    std::ostringstream reply;
+    reply << display << " " << std::fixed << std::setprecision(1)
+          << levelToPercent(current()) << "\n";
+    return reply.str();
+  }
+
+  double value;
+  if (!(ss >> value)) {
+    return "error missing value\n";
+  }
+  if (command == "set") {
+    batch[display] = percentToLevel(value);
+  } else if (command == "step") {
+    batch[display] = percentToLevel(levelToPercent(current()) + value);
+  } else {
+    return "error unknown command\n";
+  }
+  return std::nullopt;
+}
+
+ControlSocket::~ControlSocket() {
+  stop();
+  close(_stop_fd);
+  close(_listen_fd);
+  std::error_code ec;
+  std::filesystem::remove(_socket_path, ec);
+}
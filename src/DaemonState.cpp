@@ -0,0 +1,110 @@
+#include "DaemonState.h"
+#include "ProfileGenerator.h"
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <easylogging++.h>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+
+#define STATE_LEVEL_KEY "level"
+#define STATE_PROFILE_KEY "profile"
+
+// -----------------Helper  functions----------------
+
+/*! \brief elements of [A-Za-z0-9_] separated by single slashes, like
+ * g_variant_is_object_path()
+ */
+bool is_object_path(const std::string &path) {
+  if (path.empty() || path[0] != '/') {
+    return false;
+  }
+  if (path.size() == 1) {
+    return true;
+  }
+  if (path.back() == '/') {
+    return false;
+  }
+  for (size_t i = 1; i < path.size(); i++) {
+    char c = path[i];
+    if (c == '/' ? path[i - 1] == '/'
+                 : !(std::isalnum(static_cast<unsigned char>(c)) ||
+                     c == '_')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// -------------------------------------
+
+std::optional<std::filesystem::path> default_state_path() {
+  const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+  if (!runtime_dir || runtime_dir[0] == '\0') {
+    return std::nullopt;
+  }
+  return std::filesystem::path(runtime_dir) / "colord-brightness" / "state";
+}
+
+bool save_daemon_state(std::filesystem::path state_file,
+                       const DaemonState &state) {
+  std::error_code ec;
+  std::filesystem::create_directories(state_file.parent_path(), ec);
+
+  // write to a temporary file and rename it, a partial state is never read
+  std::filesystem::path tmp_file = state_file;
+  tmp_file += ".tmp";
+  {
+    std::ofstream file(tmp_file, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+      LOG(ERROR) << "Couldn't open state file " << tmp_file
+                 << ", errno: " << strerror(errno);
+      return false;
+    }
+    file << STATE_LEVEL_KEY << " " << state.level << "\n";
+    file << STATE_PROFILE_KEY << " " << state.profile_object_path << "\n";
+    if (!file.good()) {
+      LOG(ERROR) << "Couldn't write state file " << tmp_file;
+      return false;
+    }
+  }
+  std::filesystem::rename(tmp_file, state_file, ec);
+  if (ec) {
+    LOG(ERROR) << "Couldn't rename state file: " << ec.message();
+    return false;
+  }
+  return true;
+}
+
+std::optional<DaemonState> load_daemon_state(std::filesystem::path state_file) {
+  std::ifstream file(state_file);
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+  DaemonState state = {0, ""};
+  bool has_level = false;
+  std::string key;
+  while (file >> key) {
+    if (key == STATE_LEVEL_KEY) {
+      has_level = static_cast<bool>(file >> state.level);
+    } else if (key == STATE_PROFILE_KEY) {
+      file >> state.profile_object_path;
+    } else {
+      LOG(WARNING) << "Unknown key in state file: " << key;
+      std::getline(file, key);
+    }
+  }
+  file.close();
+  std::error_code ec;
+  std::filesystem::remove(state_file, ec);
+
+  if (!has_level || state.level > BRIGHTNESS_LEVEL_SCALE ||
+      !is_object_path(state.profile_object_path)) {
+    LOG(WARNING) << "State file " << state_file << " is invalid";
+    return std::nullopt;
+  }
+  return state;
+}
@@ -0,0 +1,27 @@
+#include "DisplayFanOut.h"
+#include "ProfileGenerator.h"
+#include <cstdint>
+#include <map>
+#include <vector>
+
+DisplayFanOut::DisplayFanOut(std::vector<uint> displays,
+                             std::map<uint, double> scales)
+    : _displays(displays.empty() ? std::vector<uint>{0} : displays),
+      _scales(scales) {}
+
+std::map<uint, uint32_t> DisplayFanOut::levels(uint32_t backlight_level) const {
+  std::map<uint, uint32_t> levels;
+  for (uint display : _displays) {
+    auto scale = _scales.find(display);
+    if (scale == _scales.end()) {
+      levels[display] = backlight_level;
+      continue;
+    }
+    // clamped by the quantization
+    levels[display] = quantize_brightness(
+        level_to_brightness(backlight_level) * scale->second);
+  }
+  return levels;
+}
+
+const std::vector<uint> &DisplayFanOut::displays() const { return _displays; }
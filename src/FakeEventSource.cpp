@@ -0,0 +1,47 @@
+#include "FakeEventSource.h"
+#include <mutex>
+#include <optional>
+#include <string>
+
+FakeEventSource::FakeEventSource(std::string content)
+    : _content(content), _events(), _stopped(false), _mut(), _cv() {}
+
+void FakeEventSource::inject(const std::string &content) {
+  {
+    std::lock_guard<std::mutex> lk(_mut);
+    _content = content;
+    _events.push_back(content);
+  }
+  _cv.notify_one();
+}
+
+bool FakeEventSource::start() {
+  std::lock_guard<std::mutex> lk(_mut);
+  _stopped = false;
+  return true;
+}
+
+std::optional<std::string> FakeEventSource::waitAndGet() {
+  std::unique_lock<std::mutex> lk(_mut);
+  _cv.wait(lk, [this] { return _stopped || !_events.empty(); });
+  if (_stopped) {
+    return std::nullopt;
+  }
+  std::string content = _events.front();
+  _events.pop_front();
+  return content;
+}
+
+std::optional<std::string> FakeEventSource::readFile() {
+  std::lock_guard<std::mutex> lk(_mut);
+  return _content;
+}
+
+bool FakeEventSource::stop() {
+  {
+    std::lock_guard<std::mutex> lk(_mut);
+    _stopped = true;
+  }
+  _cv.notify_all();
+  return true;
+}
@@ -1,4 +1,5 @@
 #include "FileWatcher.h"
+#include "ThreadScheduling.h"
 #include <atomic>
 #include <cerrno>
 #include <condition_variable>
@@ -42,8 +43,7 @@ std::optional<std::string> getFileContent(std::filesystem::path file_path) {
 }
 
 void sig_int_handler(int sig) {
-  LOG(DEBUG) << "Received sig: " << sig
-             << " in thread: " << std::this_thread::get_id();
+  // only interrupts the blocking read, logging isn't async-signal-safe
 }
 
 bool updateFileContent(std::shared_ptr<std::mutex> mut,
@@ -66,6 +66,7 @@ void fileWatchThread(int inot_fd, std::filesystem::path file_path,
                      std::shared_ptr<std::condition_variable> cv,
                      std::shared_ptr<std::mutex> cv_mut,
                      std::shared_ptr<std::string> file_content) {
+  apply_thread_scheduling(thread_role::watcher);
   char buf[INOTIFY_BUF_SIZE];
   while (*watching) {
     // block/wait for occurrence of an event
@@ -168,32 +169,17 @@ file_watch_error FileWatcher::startWatching() {
 }
 
 std::optional<std::string> FileWatcher::waitAndGet() {
+  // checked under the lock, so the notification of stopWatching() can't get
+  // lost between the check and the wait
+  std::unique_lock<std::mutex> lk(*_cv_mut);
   if (*_watching) {
-    std::unique_lock<std::mutex> lk(*_cv_mut);
     auto updated = _updated;
     LOG(DEBUG) << "Waiting for event from Filewatcher ...";
     _notify_waiter_cv->wait(lk);
-    return *_changed_file_content;
-  } else {
-    LOG(WARNING) << "Filewatcher is not running!";
-    return std::nullopt;
-  }
-}
-
-template <class Rep, class Period>
-std::optional<std::string>
-FileWatcher::waitForAndGet(std::chrono::duration<Rep, Period> time) {
-  if (*_watching) {
-    std::unique_lock<std::mutex> lk(*_cv_mut);
-    auto updated = _updated;
-    LOG(DEBUG) << "Waiting " << time << " for event from Filewatcher ...";
-    std::cv_status changed = _notify_waiter_cv->wait_for(lk, time);
-    if (changed == std::cv_status::no_timeout) {
-      return *_changed_file_content;
-    } else {
-      LOG(DEBUG) << "Timeout after waiting " << time << " for a file-change.";
+    if (!*_watching) {
       return std::nullopt;
     }
+    return *_changed_file_content;
   } else {
     LOG(WARNING) << "Filewatcher is not running!";
     return std::nullopt;
@@ -239,7 +225,10 @@ bool FileWatcher::stopWatching() {
       LOG(ERROR) << "Couldnt close watch fd, errno: " << strerror(errno);
     }
   }
-  _notify_waiter_cv->notify_all();
+  {
+    std::lock_guard<std::mutex> lk(*_cv_mut);
+    _notify_waiter_cv->notify_all();
+  }
   LOG(DEBUG) << "Stopped watching" << std::endl;
   return true;
 }
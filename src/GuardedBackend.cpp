@@ -0,0 +1,207 @@
+#include "GuardedBackend.h"
+#include <algorithm>
+#include <chrono>
+#include <easylogging++.h>
+#include <optional>
+#include <sstream>
+#include <utility>
+
+GuardedBackend::GuardedBackend(std::shared_ptr<ProfileBackend> backend,
+                               std::chrono::milliseconds deadline,
+                               CircuitBreakerConfig breaker_conf)
+    : _backend(backend), _deadline(deadline), _breaker(breaker_conf),
+      _in_flight(), _timed_out(), _superseded(), _prepared(), _preempted(),
+      _pending(), _recovered(0),
+      _recovering(false), _stop(false), _mut(), _cv(), _recovery(),
+      _supervisor(&GuardedBackend::superviseThread, this) {}
+
+bool GuardedBackend::setIccFromData(const uint8_t *data, size_t size,
+                                    uint display_device_id) {
+  std::unique_lock<std::mutex> lk(_mut);
+  if (!_breaker.allow()) {
+    // kept for the recovery, returns before blocking on the backend
+    _prepared.erase(display_device_id);
+    _preempted.erase(display_device_id);
+    _pending[display_device_id].assign(data, data + size);
+    _cv.notify_all();
+    return false;
+  }
+  _pending.erase(display_device_id);
+  return apply(data, size, display_device_id, lk);
+}
+
+void GuardedBackend::prepareUpdate(uint display_device_id) {
+  std::lock_guard<std::mutex> lk(_mut);
+  _prepared.insert(display_device_id);
+  _preempted.erase(display_device_id);
+}
+
+bool GuardedBackend::cancelUpdate(uint display_device_id) {
+  std::lock_guard<std::mutex> lk(_mut);
+  bool prepared = _prepared.count(display_device_id) > 0;
+  if (prepared) {
+    _preempted.insert(display_device_id);
+  }
+  return _backend->cancelUpdate(display_device_id) || prepared;
+}
+
+bool GuardedBackend::apply(const uint8_t *data, size_t size,
+                           uint display_device_id,
+                           std::unique_lock<std::mutex> &lk) {
+  // one call per display, the newer one wins
+  while (_in_flight.count(display_device_id) > 0) {
+    if (_timed_out.count(display_device_id) > 0) {
+      // the backend didn't give up the call past its deadline yet, kept
+      // until it returns instead of blocking the caller
+      _prepared.erase(display_device_id);
+      _preempted.erase(display_device_id);
+      _pending[display_device_id].assign(data, data + size);
+      _cv.notify_all();
+      return false;
+    }
+    _superseded.insert(display_device_id);
+    _backend->cancelUpdate(display_device_id);
+    _cv.wait(lk);
+  }
+  _prepared.erase(display_device_id);
+  if (_preempted.erase(display_device_id) > 0) {
+    // the caller has a newer profile already
+    if (_breaker.state() == breaker_state::half_open) {
+      // a probe that never reached the backend, kept for the next one
+      _breaker.releaseProbe();
+      if (_pending.count(display_device_id) == 0) {
+        _pending[display_device_id].assign(data, data + size);
+      }
+      _cv.notify_all();
+    }
+    return false;
+  }
+  // so the deadline and a preemption hit this call from now on
+  _backend->prepareUpdate(display_device_id);
+  _in_flight[display_device_id] = std::chrono::steady_clock::now() + _deadline;
+  _cv.notify_all();
+
+  lk.unlock();
+  bool applied = _backend->setIccFromData(data, size, display_device_id);
+  lk.lock();
+
+  _in_flight.erase(display_device_id);
+  bool timed_out = _timed_out.erase(display_device_id) > 0 && !applied;
+  bool superseded = _superseded.erase(display_device_id) > 0 && !applied;
+  if (timed_out) {
+    // counted by the supervisor at the deadline
+    if (_pending.count(display_device_id) == 0) {
+      _pending[display_device_id].assign(data, data + size);
+    }
+  } else if (!superseded || _breaker.state() == breaker_state::half_open) {
+    // a superseded probe still returned before its deadline
+    _breaker.recordResponse();
+  }
+  _cv.notify_all();
+  return applied;
+}
+
+void GuardedBackend::superviseThread() {
+  std::unique_lock<std::mutex> lk(_mut);
+  while (!_stop) {
+    auto now = std::chrono::steady_clock::now();
+    for (const auto &[display, deadline] : _in_flight) {
+      if (deadline <= now && _timed_out.insert(display).second) {
+        LOG(WARNING) << "Profile update of display " << display
+                     << " timed out after " << _deadline.count() << " ms";
+        // counted right away, the backend can take a while to give it up
+        _breaker.recordTimeout();
+        _backend->cancelUpdate(display);
+      }
+    }
+
+    // a pending profile of a display without a call in flight, applied on
+    // its own thread, so its deadline still gets watched
+    auto pending = std::find_if(
+        _pending.begin(), _pending.end(),
+        [this](const auto &entry) { return !_in_flight.count(entry.first); });
+    bool retry_due = _breaker.state() == breaker_state::closed ||
+                     (_breaker.state() == breaker_state::open &&
+                      _breaker.retryAt() <= now);
+    if (pending != _pending.end() && !_recovering && retry_due &&
+        _breaker.allow()) {
+      uint display = pending->first;
+      std::vector<uint8_t> profile = std::move(pending->second);
+      _pending.erase(pending);
+      _recovering = true;
+      if (_recovery.joinable()) {
+        _recovery.join();
+      }
+      _recovery = std::thread([this, display, profile]() {
+        std::unique_lock<std::mutex> lk(_mut);
+        if (_in_flight.count(display) > 0) {
+          // a newer call of the display started meanwhile, it wins
+          if (_breaker.state() == breaker_state::half_open) {
+            _breaker.releaseProbe();
+          }
+        } else {
+          LOG(INFO) << "Applying the pending profile of display " << display;
+          if (apply(profile.data(), profile.size(), display, lk)) {
+            _recovered++;
+          }
+        }
+        _recovering = false;
+        _cv.notify_all();
+      });
+      continue;
+    }
+
+    // next deadline or retry of the breaker
+    std::optional<std::chrono::steady_clock::time_point> wake;
+    for (const auto &[display, deadline] : _in_flight) {
+      if (!_timed_out.count(display)) {
+        wake = std::min(wake.value_or(deadline), deadline);
+      }
+    }
+    if (pending != _pending.end() && !_recovering &&
+        _breaker.state() == breaker_state::open) {
+      wake = std::min(wake.value_or(_breaker.retryAt()), _breaker.retryAt());
+    }
+    if (wake) {
+      _cv.wait_until(lk, wake.value());
+    } else {
+      _cv.wait(lk);
+    }
+  }
+}
+
+GuardStats GuardedBackend::stats() const {
+  std::lock_guard<std::mutex> lk(_mut);
+  GuardStats stats;
+  stats.breaker = _breaker.stats();
+  stats.pending = _pending.size();
+  stats.recovered = _recovered;
+  return stats;
+}
+
+std::string GuardedBackend::statsString() const {
+  GuardStats guard_stats = stats();
+  const BreakerStats &breaker = guard_stats.breaker;
+  std::stringstream ss;
+  ss << "breaker " << breaker_state_name(breaker.state) << " timeouts "
+     << breaker.timeouts << " rejected " << breaker.rejected << " opened "
+     << breaker.opened << " probes " << breaker.probes << " backoff_ms "
+     << breaker.backoff.count() << " pending " << guard_stats.pending
+     << " recovered " << guard_stats.recovered;
+  return ss.str();
+}
+
+GuardedBackend::~GuardedBackend() {
+  {
+    std::lock_guard<std::mutex> lk(_mut);
+    _stop = true;
+    for (const auto &[display, deadline] : _in_flight) {
+      _backend->cancelUpdate(display);
+    }
+  }
+  _cv.notify_all();
+  _supervisor.join();
+  if (_recovery.joinable()) {
+    _recovery.join();
+  }
+}
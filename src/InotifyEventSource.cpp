@@ -0,0 +1,46 @@
+#include "InotifyEventSource.h"
+#include <cstring>
+#include <easylogging++.h>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+// -----------------Helper  functions----------------
+
+void log_file_watch_error(file_watch_error error) {
+  LOG(ERROR) << "Error occured on starting the filewatcher! ERROR:";
+  switch (error) {
+  case file_watch_error::error_unknown:
+    LOG(ERROR) << "Unknown Error";
+    break;
+  case file_watch_error::error_still_watching:
+    LOG(ERROR) << "Already watching";
+    break;
+  default:
+    LOG(ERROR) << "Errno: " << strerror((int)error);
+  }
+}
+
+// -------------------------------------
+
+InotifyEventSource::InotifyEventSource(std::filesystem::path brightness_file)
+    : _file_watcher(brightness_file) {}
+
+bool InotifyEventSource::start() {
+  file_watch_error started = _file_watcher.startWatching();
+  if (started != file_watch_error::success) {
+    log_file_watch_error(started);
+    return false;
+  }
+  return true;
+}
+
+std::optional<std::string> InotifyEventSource::waitAndGet() {
+  return _file_watcher.waitAndGet();
+}
+
+std::optional<std::string> InotifyEventSource::readFile() {
+  return _file_watcher.readFile();
+}
+
+bool InotifyEventSource::stop() { return _file_watcher.stopWatching(); }
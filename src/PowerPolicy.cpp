@@ -0,0 +1,82 @@
+#include "PowerPolicy.h"
+#include <chrono>
+#include <easylogging++.h>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+PowerPolicy::PowerPolicy(UpdatePolicy ac, UpdatePolicy battery)
+    : _policies({ac, battery}), _apply_callback(), _on_battery(false),
+      _stats(), _switched(std::chrono::steady_clock::now()), _mut() {}
+
+void PowerPolicy::setApplyCallback(
+    std::function<void(const UpdatePolicy &)> callback) {
+  std::lock_guard<std::mutex> lk(_mut);
+  _apply_callback = callback;
+  if (_apply_callback) {
+    _apply_callback(_policies[_on_battery]);
+  }
+}
+
+bool PowerPolicy::setOnBattery(bool on_battery) {
+  std::lock_guard<std::mutex> lk(_mut);
+  if (on_battery == _on_battery) {
+    return false;
+  }
+  auto now = std::chrono::steady_clock::now();
+  _stats[_on_battery].active_s +=
+      std::chrono::duration<double>(now - _switched).count();
+  _switched = now;
+  _on_battery = on_battery;
+  LOG(INFO) << "Switched to the update policy " << _policies[_on_battery].name;
+  if (_apply_callback) {
+    _apply_callback(_policies[_on_battery]);
+  }
+  return true;
+}
+
+bool PowerPolicy::onBattery() const {
+  std::lock_guard<std::mutex> lk(_mut);
+  return _on_battery;
+}
+
+UpdatePolicy PowerPolicy::current() const {
+  std::lock_guard<std::mutex> lk(_mut);
+  return _policies[_on_battery];
+}
+
+void PowerPolicy::countUpdate() {
+  std::lock_guard<std::mutex> lk(_mut);
+  _stats[_on_battery].updates++;
+}
+
+std::array<PolicyStats, 2> PowerPolicy::stats() const {
+  std::lock_guard<std::mutex> lk(_mut);
+  std::array<PolicyStats, 2> stats = _stats;
+  stats[_on_battery].active_s += std::chrono::duration<double>(
+                                     std::chrono::steady_clock::now() -
+                                     _switched)
+                                     .count();
+  return stats;
+}
+
+std::string PowerPolicy::statsString() const {
+  std::array<PolicyStats, 2> current_stats = stats();
+  UpdatePolicy active = current();
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(1) << "power policy " << active.name
+     << " min_interval_ms " << active.min_interval.count() << " level_step "
+     << active.level_step << " prefetch_depth " << active.prefetch_depth;
+  for (size_t i = 0; i < _policies.size(); i++) {
+    const PolicyStats &policy_stats = current_stats[i];
+    ss << "\npolicy " << _policies[i].name << " active_s "
+       << policy_stats.active_s << " updates " << policy_stats.updates
+       << " updates_per_min "
+       << (policy_stats.active_s > 0
+               ? policy_stats.updates * 60.0 / policy_stats.active_s
+               : 0.0);
+  }
+  return ss.str();
+}
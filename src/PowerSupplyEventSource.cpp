@@ -0,0 +1,64 @@
+#include "PowerSupplyEventSource.h"
+#include <easylogging++.h>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+
+// -----------------Helper  functions----------------
+
+std::optional<std::string> readSupplyAttribute(std::filesystem::path file) {
+  std::ifstream in(file);
+  std::string content;
+  if (!std::getline(in, content)) {
+    return std::nullopt;
+  }
+  return content;
+}
+
+// -------------------------------------
+
+PowerSupplyEventSource::PowerSupplyEventSource(
+    std::filesystem::path power_supply_dir)
+    : PowerSupplyEventSource(power_supply_dir, openSocket()) {}
+
+PowerSupplyEventSource::PowerSupplyEventSource(
+    std::filesystem::path power_supply_dir, int uevent_fd)
+    : UeventEventSource("power_supply", "", power_supply_dir, uevent_fd) {}
+
+bool PowerSupplyEventSource::onExternalPower(
+    std::filesystem::path power_supply_dir) {
+  bool external_supply = false;
+  bool discharging = false;
+  std::error_code ec;
+  for (const std::filesystem::directory_entry &supply :
+       std::filesystem::directory_iterator(power_supply_dir, ec)) {
+    std::optional<std::string> type =
+        readSupplyAttribute(supply.path() / "type");
+    if (!type) {
+      continue;
+    }
+    if (type == "Battery") {
+      discharging |=
+          readSupplyAttribute(supply.path() / "status") == "Discharging";
+      continue;
+    }
+    // Mains, USB and the like
+    std::optional<std::string> online =
+        readSupplyAttribute(supply.path() / "online");
+    if (!online) {
+      continue;
+    }
+    if (online != "0") {
+      return true;
+    }
+    external_supply = true;
+  }
+  LOG_IF(ec, WARNING) << "Couldn't list the power supplies in "
+                      << power_supply_dir << ": " << ec.message();
+  return !external_supply && !discharging;
+}
+
+std::optional<std::string> PowerSupplyEventSource::readFile() {
+  return onExternalPower(_attribute) ? "1\n" : "0\n";
+}
@@ -0,0 +1,49 @@
+#include "ProfileApplier.h"
+#include "ProfileGenerator.h"
+#include <cstdint>
+#include <easylogging++.h>
+#include <memory>
+#include <optional>
+#include <vector>
+
+ProfileApplier::ProfileApplier(std::shared_ptr<ProfileBackend> backend,
+                               std::shared_ptr<ProfileAtlas> atlas)
+    : _backend(backend), _atlas(atlas) {}
+
+std::optional<ProfileBlob>
+ProfileApplier::prepare(uint32_t level, std::vector<uint8_t> &storage) {
+  if (_atlas) {
+    if (std::optional<ProfileBlob> blob =
+            _atlas->find(SRGB_BASE_PROFILE_ID, level)) {
+      LOG(DEBUG) << "Profile for level " << level << " served from atlas";
+      return blob;
+    }
+  }
+
+  storage = generate_srgb_profile_data(level_to_brightness(level));
+  if (storage.empty()) {
+    return std::nullopt;
+  }
+  if (_atlas) {
+    LOG_IF(!_atlas->insert(SRGB_BASE_PROFILE_ID, level, storage.data(),
+                           storage.size()),
+           DEBUG)
+        << "Profile for level " << level << " not added to atlas";
+  }
+  return ProfileBlob{storage.data(), storage.size()};
+}
+
+bool ProfileApplier::apply(uint32_t level, uint display_device_id) {
+  std::vector<uint8_t> storage;
+  std::optional<ProfileBlob> blob = prepare(level, storage);
+  if (!blob.has_value()) {
+    return false;
+  }
+  return _backend->setIccFromData(blob->data, blob->size, display_device_id);
+}
+
+std::shared_ptr<ProfileBackend> ProfileApplier::backend() const {
+  return _backend;
+}
+
+std::shared_ptr<ProfileAtlas> ProfileApplier::atlas() const { return _atlas; }
@@ -0,0 +1,285 @@
+#include "ProfileAtlas.h"
+#include "ProfileGenerator.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <easylogging++.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+// -----------------On-disk format----------------
+
+#define ATLAS_MAGIC "CBATLAS"
+#define ATLAS_HEADER_SIZE 64
+
+struct AtlasHeader {
+  char magic[8];
+  uint32_t format_version;
+  uint32_t generator_version; /*!< PROFILE_GENERATOR_VERSION of the blobs */
+  uint32_t capacity;
+  uint32_t entry_count;
+  uint64_t data_end;
+};
+
+struct AtlasEntry {
+  uint32_t base_id;
+  uint32_t level;
+  uint64_t offset;
+  uint32_t size;
+  uint32_t checksum; /*!< fnv1a of the blob */
+};
+
+static_assert(sizeof(AtlasHeader) <= ATLAS_HEADER_SIZE);
+
+#define ATLAS_DATA_START                                                       \
+  (ATLAS_HEADER_SIZE + ATLAS_INDEX_CAPACITY * sizeof(AtlasEntry))
+
+// -----------------Helper  functions----------------
+
+uint32_t fnv1aChecksum(const uint8_t *data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+uint64_t atlasKey(uint32_t base_id, uint32_t level) {
+  return (static_cast<uint64_t>(base_id) << 32) | level;
+}
+
+bool writeAtlas(int fd, const void *data, size_t size, off_t offset) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  while (size > 0) {
+    ssize_t written = pwrite(fd, bytes, size, offset);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      LOG(ERROR) << "Couldn't write to profile atlas, errno: "
+                 << strerror(errno);
+      return false;
+    }
+    bytes += written;
+    size -= written;
+    offset += written;
+  }
+  return true;
+}
+
+AtlasHeader emptyHeader() {
+  AtlasHeader header = {};
+  std::memcpy(header.magic, ATLAS_MAGIC, sizeof(ATLAS_MAGIC));
+  header.format_version = ATLAS_FORMAT_VERSION;
+  header.generator_version = PROFILE_GENERATOR_VERSION;
+  header.capacity = ATLAS_INDEX_CAPACITY;
+  header.entry_count = 0;
+  header.data_end = ATLAS_DATA_START;
+  return header;
+}
+
+int openAtlasFile(const std::filesystem::path &atlas_file) {
+  std::error_code ec;
+  if (atlas_file.has_parent_path()) {
+    std::filesystem::create_directories(atlas_file.parent_path(), ec);
+    LOG_IF(ec, WARNING) << "Couldn't create directory for the profile atlas: "
+                        << ec.message();
+  }
+
+  int fd = open(atlas_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    std::stringstream ss;
+    ss << "Profile atlas " << atlas_file << " couldn't get opened";
+    throw std::system_error(errno, std::generic_category(), ss.str());
+  }
+  return fd;
+}
+
+// -------------------------------------
+
+ProfileAtlas::ProfileAtlas(std::filesystem::path atlas_file)
+    : ProfileAtlas(atlas_file, openAtlasFile(atlas_file)) {}
+
+ProfileAtlas::ProfileAtlas(std::filesystem::path name, int fd)
+    : _path(name), _fd(fd), _map(nullptr), _entry_count(0),
+      _data_end(ATLAS_DATA_START), _index(), _mut() {
+  // only one daemon may append to the atlas
+  if (flock(_fd, LOCK_EX | LOCK_NB) != 0) {
+    int err = errno;
+    close(_fd);
+    throw std::system_error(err, std::generic_category(),
+                            "Profile atlas is locked by another process");
+  }
+
+  // map the maximal size once, so blobs handed out never move, only the
+  // validated part below the file size gets accessed
+  void *map = mmap(NULL, ATLAS_MAX_SIZE, PROT_READ, MAP_SHARED, _fd, 0);
+  if (map == MAP_FAILED) {
+    int err = errno;
+    close(_fd);
+    throw std::system_error(err, std::generic_category(),
+                            "Profile atlas couldn't get mapped");
+  }
+  _map = static_cast<const uint8_t *>(map);
+
+  if (!validate()) {
+    LOG(INFO) << "Profile atlas " << _path
+              << " is outdated or corrupted, rebuilding it";
+    if (!rebuild()) {
+      munmap(const_cast<uint8_t *>(_map), ATLAS_MAX_SIZE);
+      close(_fd);
+      throw std::system_error(errno, std::generic_category(),
+                              "Profile atlas couldn't get rebuilt");
+    }
+  }
+  LOG(DEBUG) << "Profile atlas " << _path << " opened with " << _entry_count
+             << " profiles";
+}
+
+std::unique_ptr<ProfileAtlas> ProfileAtlas::inMemory() {
+  int fd = memfd_create("colord-brightness-atlas", MFD_CLOEXEC);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Memfd for the profile atlas couldn't get created");
+  }
+  return std::unique_ptr<ProfileAtlas>(
+      new ProfileAtlas("memfd:colord-brightness-atlas", fd));
+}
+
+std::optional<std::filesystem::path> ProfileAtlas::defaultPath() {
+  const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+  if (!runtime_dir || runtime_dir[0] == '\0') {
+    return std::nullopt;
+  }
+  return std::filesystem::path(runtime_dir) / "colord-brightness" /
+         "profiles.atlas";
+}
+
+bool ProfileAtlas::validate() {
+  struct stat st;
+  if (fstat(_fd, &st) != 0 ||
+      static_cast<uint64_t>(st.st_size) < ATLAS_DATA_START) {
+    return false;
+  }
+
+  AtlasHeader header;
+  if (pread(_fd, &header, sizeof(header), 0) != sizeof(header)) {
+    return false;
+  }
+  if (std::memcmp(header.magic, ATLAS_MAGIC, sizeof(ATLAS_MAGIC)) != 0 ||
+      header.format_version != ATLAS_FORMAT_VERSION ||
+      header.generator_version != PROFILE_GENERATOR_VERSION ||
+      header.capacity != ATLAS_INDEX_CAPACITY ||
+      header.entry_count > header.capacity ||
+      header.data_end < ATLAS_DATA_START ||
+      header.data_end > static_cast<uint64_t>(st.st_size) ||
+      header.data_end > ATLAS_MAX_SIZE) {
+    return false;
+  }
+
+  const AtlasEntry *entries =
+      reinterpret_cast<const AtlasEntry *>(_map + ATLAS_HEADER_SIZE);
+  std::unordered_map<uint64_t, ProfileBlob> index;
+  for (uint32_t i = 0; i < header.entry_count; i++) {
+    const AtlasEntry &entry = entries[i];
+    // without the sum, an offset near UINT64_MAX would wrap around
+    if (entry.offset < ATLAS_DATA_START || entry.size == 0 ||
+        entry.offset > header.data_end ||
+        entry.size > header.data_end - entry.offset) {
+      LOG(WARNING) << "Profile atlas entry " << i << " is out of bounds";
+      return false;
+    }
+    const uint8_t *blob = _map + entry.offset;
+    if (fnv1aChecksum(blob, entry.size) != entry.checksum) {
+      LOG(WARNING) << "Profile atlas entry " << i << " is corrupted";
+      return false;
+    }
+    index[atlasKey(entry.base_id, entry.level)] = {blob, entry.size};
+  }
+
+  _index = std::move(index);
+  _entry_count = header.entry_count;
+  _data_end = header.data_end;
+  return true;
+}
+
+bool ProfileAtlas::rebuild() {
+  _index.clear();
+  _entry_count = 0;
+  _data_end = ATLAS_DATA_START;
+  // truncating first zeroes the old index
+  if (ftruncate(_fd, 0) != 0 || ftruncate(_fd, ATLAS_DATA_START) != 0) {
+    LOG(ERROR) << "Couldn't truncate the profile atlas, errno: "
+               << strerror(errno);
+    return false;
+  }
+  AtlasHeader header = emptyHeader();
+  return writeAtlas(_fd, &header, sizeof(header), 0);
+}
+
+std::optional<ProfileBlob> ProfileAtlas::find(uint32_t base_id,
+                                              uint32_t level) const {
+  std::lock_guard<std::mutex> lk(_mut);
+  auto it = _index.find(atlasKey(base_id, level));
+  if (it == _index.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+bool ProfileAtlas::insert(uint32_t base_id, uint32_t level,
+                          const uint8_t *data, size_t size) {
+  std::lock_guard<std::mutex> lk(_mut);
+  if (size == 0 || _index.count(atlasKey(base_id, level))) {
+    return false;
+  }
+  if (_entry_count >= ATLAS_INDEX_CAPACITY ||
+      _data_end + size > ATLAS_MAX_SIZE) {
+    LOG(WARNING) << "Profile atlas is full, profile for level " << level
+                 << " not cached";
+    return false;
+  }
+
+  // blob first, then its index entry and at last the header, which commits
+  // the entry, so an interrupted append is never visible
+  AtlasEntry entry = {base_id, level, _data_end, static_cast<uint32_t>(size),
+                      fnv1aChecksum(data, size)};
+  off_t entry_offset = ATLAS_HEADER_SIZE + _entry_count * sizeof(AtlasEntry);
+  if (!writeAtlas(_fd, data, size, _data_end) ||
+      !writeAtlas(_fd, &entry, sizeof(entry), entry_offset)) {
+    return false;
+  }
+  AtlasHeader header = emptyHeader();
+  header.entry_count = _entry_count + 1;
+  header.data_end = _data_end + size;
+  if (!writeAtlas(_fd, &header, sizeof(header), 0)) {
+    return false;
+  }
+
+  _index[atlasKey(base_id, level)] = {_map + _data_end, size};
+  _entry_count = header.entry_count;
+  _data_end = header.data_end;
+  return true;
+}
+
+size_t ProfileAtlas::size() const {
+  std::lock_guard<std::mutex> lk(_mut);
+  return _entry_count;
+}
+
+ProfileAtlas::~ProfileAtlas() {
+  munmap(const_cast<uint8_t *>(_map), ATLAS_MAX_SIZE);
+  // also releases the lock
+  LOG_IF(close(_fd) != 0, ERROR)
+      << "Couldnt close profile atlas fd, errno: " << strerror(errno);
+}
@@ -0,0 +1,87 @@
+#include "ProfileGenerator.h"
+#include "LcmsHandles.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <easylogging++.h>
+#include <lcms2.h>
+#include <vector>
+
+// based on color profile creation from:
+// https://github.com/udifuchs/icc-brightness/blob/master/icc-brightness-gen.c
+CmsProfileHandle create_srgb_profile(double brightness, cmsContext context) {
+  CmsProfileHandle hsRGB(cmsCreate_sRGBProfileTHR(context));
+  if (!hsRGB) {
+    LOG(ERROR) << "Couldn't create sRGB profile!";
+    return hsRGB;
+  }
+
+  {
+    CmsMLUHandle mlu(cmsMLUalloc(context, 1));
+    char description[20];
+    snprintf(description, 20, "Brightness %.2f", brightness);
+    cmsMLUsetASCII(mlu.get(), "en", "US", description);
+    cmsWriteTag(hsRGB.get(), cmsSigProfileDescriptionTag, mlu.get());
+  }
+
+  double used_brightness = std::clamp(brightness, 0.1, 1.0);
+  double curve[] = {1.0, used_brightness,
+                    0.0}; // gamma, a, b for (a X +b)^gamma
+  CmsToneCurveHandle tone_curves[3] = {
+      CmsToneCurveHandle(cmsBuildParametricToneCurve(context, 2, curve)),
+      CmsToneCurveHandle(cmsBuildParametricToneCurve(context, 2, curve)),
+      CmsToneCurveHandle(cmsBuildParametricToneCurve(context, 2, curve)),
+  };
+  cmsToneCurve *tone_curve[3] = {tone_curves[0].get(), tone_curves[1].get(),
+                                 tone_curves[2].get()};
+  cmsWriteTag(hsRGB.get(), cmsSigVcgtTag, tone_curve);
+
+  return hsRGB;
+}
+
+std::vector<uint8_t> generate_srgb_profile_data(double brightness) {
+  // own context per profile, no lcms2 state is shared between threads
+  CmsContextHandle context(cmsCreateContext(NULL, NULL));
+  CmsProfileHandle profile = create_srgb_profile(brightness, context.get());
+  if (!profile) {
+    return {};
+  }
+  return serialize_profile(profile.get());
+}
+
+std::vector<uint8_t> serialize_profile(cmsHPROFILE profile) {
+  if (!cmsMD5computeID(profile))
+    LOG(WARNING) << "Couldn't recompute hash for lcms2 color profile!";
+
+  cmsUInt32Number bytes_needed = 0;
+  if (!cmsSaveProfileToMem(profile, NULL, &bytes_needed) ||
+      bytes_needed == 0) {
+    LOG(ERROR) << "Couldn't compute the size of the lcms2 color profile!";
+    return {};
+  }
+  std::vector<uint8_t> data(bytes_needed);
+  if (!cmsSaveProfileToMem(profile, data.data(), &bytes_needed)) {
+    LOG(ERROR) << "Lcms2-profile couldn't get serialized!";
+    return {};
+  }
+  data.resize(bytes_needed);
+  return data;
+}
+
+uint32_t quantize_brightness(double brightness) {
+  double clamped = std::clamp(brightness, 0.0, 1.0);
+  return static_cast<uint32_t>(std::lround(clamped * BRIGHTNESS_LEVEL_SCALE));
+}
+
+double level_to_brightness(uint32_t level) {
+  return static_cast<double>(level) / BRIGHTNESS_LEVEL_SCALE;
+}
+
+uint32_t round_level(uint32_t level, uint32_t step) {
+  if (step <= 1 || level >= BRIGHTNESS_LEVEL_SCALE) {
+    return std::min<uint32_t>(level, BRIGHTNESS_LEVEL_SCALE);
+  }
+  uint32_t rounded = (level + step / 2) / step * step;
+  return std::min<uint32_t>(rounded, BRIGHTNESS_LEVEL_SCALE);
+}
@@ -0,0 +1,347 @@
+#include "ProfilePipeline.h"
+#include "ProfileGenerator.h"
+#include "ThreadScheduling.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <easylogging++.h>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// -----------------Helper  functions----------------
+
+int64_t steadyNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// -------------------------------------
+
+ProfilePipeline::ProfilePipeline(std::shared_ptr<ProfileApplier> applier,
+                                 std::shared_ptr<BrightnessTargets> targets,
+                                 std::shared_ptr<ProfilePrefetcher> prefetcher)
+    : _applier(applier), _targets(targets), _prefetcher(prefetcher),
+      _applied_callback(), _slots(), _published(), _generator_done(false),
+      _generate_busy_ns(0), _apply_busy_ns(0), _generated(0), _applied(0),
+      _dropped(0), _preempted(0), _in_flight(), _preempt_requested(),
+      _in_flight_mut(), _display_stats(), _stats_mut(), _started_ns(0),
+      _stopped_ns(0), _min_interval_ns(0), _level_step(1), _workers(),
+      _round_pending(0), _stop_workers(false), _round_mut(), _round_cv() {
+  for (std::atomic<PreparedProfile *> &slot : _slots) {
+    slot.store(nullptr);
+  }
+  if (sem_init(&_published, 0, 0) != 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Semaphore of the pipeline couldn't get created");
+  }
+}
+
+uint32_t ProfilePipeline::run(uint32_t last_level,
+                              std::optional<std::chrono::seconds> idle_exit) {
+  _generator_done = false;
+  _stop_workers = false;
+  _started_ns = steadyNowNs();
+  _stopped_ns = 0;
+  std::thread generator(&ProfilePipeline::generateStage, this, idle_exit);
+  apply_thread_scheduling(thread_role::apply);
+
+  while (true) {
+    if (sem_wait(&_published) != 0) {
+      if (errno == EINTR)
+        continue;
+      LOG(ERROR) << "Waiting for the generator stage failed, errno: "
+                 << strerror(errno);
+      break;
+    }
+    // read before taking, so nothing published before the end gets lost
+    bool done = _generator_done.load(std::memory_order_acquire);
+    std::vector<std::unique_ptr<PreparedProfile>> round;
+    for (std::atomic<PreparedProfile *> &slot : _slots) {
+      if (PreparedProfile *prepared =
+              slot.exchange(nullptr, std::memory_order_acq_rel)) {
+        round.emplace_back(prepared);
+      }
+    }
+
+    // all displays of a round get applied concurrently by their workers, so
+    // the round takes as long as the slowest display
+    if (!round.empty()) {
+      int64_t begin = steadyNowNs();
+      std::unique_lock<std::mutex> lk(_round_mut);
+      for (std::unique_ptr<PreparedProfile> &prepared : round) {
+        std::unique_ptr<ApplyWorker> &worker =
+            _workers[prepared->target.display_device_id];
+        if (!worker) {
+          // started on the first profile of the display, kept until the end
+          worker = std::make_unique<ApplyWorker>();
+          worker->thread =
+              std::thread(&ProfilePipeline::applyWorker, this,
+                          std::ref(*worker));
+        }
+        worker->prepared = prepared.get();
+      }
+      _round_pending = round.size();
+      _round_cv.notify_all();
+      _round_cv.wait(lk, [this]() { return _round_pending == 0; });
+      for (std::unique_ptr<PreparedProfile> &prepared : round) {
+        if (prepared->target.display_device_id == 0 && _workers[0]->applied) {
+          last_level = prepared->target.level;
+        }
+      }
+      lk.unlock();
+      int64_t round_ns = steadyNowNs() - begin;
+      _apply_busy_ns += round_ns;
+      LOG_IF(round.size() > 1, DEBUG)
+          << "Applied " << round.size() << " displays in "
+          << round_ns / 1000000.0 << " ms";
+    }
+    if (done) {
+      break;
+    }
+  }
+
+  generator.join();
+  {
+    std::lock_guard<std::mutex> lk(_round_mut);
+    _stop_workers = true;
+  }
+  _round_cv.notify_all();
+  for (std::unique_ptr<ApplyWorker> &worker : _workers) {
+    if (worker) {
+      worker->thread.join();
+      worker.reset();
+    }
+  }
+  _stopped_ns = steadyNowNs();
+  return last_level;
+}
+
+void ProfilePipeline::applyWorker(ApplyWorker &worker) {
+  apply_thread_scheduling(thread_role::apply);
+  std::unique_lock<std::mutex> lk(_round_mut);
+  while (true) {
+    _round_cv.wait(lk, [&]() { return worker.prepared || _stop_workers; });
+    if (!worker.prepared) {
+      break;
+    }
+    PreparedProfile *prepared = worker.prepared;
+    lk.unlock();
+    bool applied = applyPrepared(*prepared);
+    lk.lock();
+    worker.applied = applied;
+    worker.prepared = nullptr;
+    if (--_round_pending == 0) {
+      _round_cv.notify_all();
+    }
+  }
+}
+
+bool ProfilePipeline::applyPrepared(PreparedProfile &prepared) {
+  const BrightnessTarget &target = prepared.target;
+  uint display = target.display_device_id;
+  // a preemption hits this update as soon as it counts as in flight
+  _applier->backend()->prepareUpdate(display);
+  {
+    std::lock_guard<std::mutex> lk(_in_flight_mut);
+    _in_flight.insert(display);
+    _preempt_requested.erase(display);
+  }
+  int64_t begin = steadyNowNs();
+  bool applied = _applier->backend()->setIccFromData(
+      prepared.blob.data, prepared.blob.size, display);
+  double apply_ms = (steadyNowNs() - begin) / 1000000.0;
+  bool preempted;
+  {
+    std::lock_guard<std::mutex> lk(_in_flight_mut);
+    _in_flight.erase(display);
+    preempted = _preempt_requested.count(display) > 0;
+  }
+
+  if (applied) {
+    _applied++;
+    std::lock_guard<std::mutex> lk(_stats_mut);
+    DisplayApplyStats &display_stats = _display_stats[display];
+    display_stats.applied++;
+    display_stats.last_ms = apply_ms;
+    display_stats.max_ms = std::max(display_stats.max_ms, apply_ms);
+    display_stats.total_ms += apply_ms;
+  } else if (preempted) {
+    // the newer profile is already in the slot
+    _preempted++;
+  } else {
+    LOG(WARNING) << "Icc Profile not updated for display " << display << "!";
+  }
+  if (_applied_callback) {
+    _applied_callback(target, applied);
+  }
+  return applied;
+}
+
+void ProfilePipeline::generateStage(
+    std::optional<std::chrono::seconds> idle_exit) {
+  apply_thread_scheduling(thread_role::generator);
+  auto wait_for_target = [&]() {
+    return idle_exit ? _targets->waitNextFor(idle_exit.value())
+                     : _targets->waitNext();
+  };
+  std::optional<BrightnessTarget> target;
+  int64_t last_batch_ns = 0;
+  while ((target = wait_for_target())) {
+    // paced, e.g. on battery: the targets posted until the next batch is due
+    // replace the taken one
+    int64_t due_ns = last_batch_ns + _min_interval_ns.load();
+    if (last_batch_ns != 0 && steadyNowNs() < due_ns) {
+      std::this_thread::sleep_for(
+          std::chrono::nanoseconds(due_ns - steadyNowNs()));
+    }
+    last_batch_ns = steadyNowNs();
+
+    // targets posted together (e.g. for all displays) get published
+    // together, so the apply stage can apply them concurrently
+    std::vector<BrightnessTarget> batch = {target.value()};
+    while (std::optional<BrightnessTarget> pending =
+               _targets->waitNextFor(std::chrono::milliseconds(0))) {
+      auto same_display = std::find_if(
+          batch.begin(), batch.end(), [&](const BrightnessTarget &taken) {
+            return taken.display_device_id == pending->display_device_id;
+          });
+      if (same_display != batch.end()) {
+        // not generated yet, replaced like in the mailbox
+        *same_display = pending.value();
+      } else {
+        batch.push_back(pending.value());
+      }
+    }
+    uint32_t level_step = _level_step.load();
+    for (BrightnessTarget &batch_target : batch) {
+      batch_target.level = round_level(batch_target.level, level_step);
+    }
+
+    std::vector<std::unique_ptr<PreparedProfile>> prepared_batch;
+    for (const BrightnessTarget &batch_target : batch) {
+      if (batch_target.display_device_id >= PIPELINE_MAX_DISPLAYS) {
+        LOG(WARNING) << "Display " << batch_target.display_device_id
+                     << " is not supported by the pipeline!";
+        continue;
+      }
+      // the next profiles get generated while colord applies this one
+      if (_prefetcher) {
+        _prefetcher->observe(batch_target.display_device_id,
+                             batch_target.level);
+      }
+      int64_t begin = steadyNowNs();
+      auto prepared = std::make_unique<PreparedProfile>();
+      prepared->target = batch_target;
+      std::optional<ProfileBlob> blob =
+          _applier->prepare(batch_target.level, prepared->storage);
+      if (blob.has_value()) {
+        prepared->blob = blob.value();
+        _generated++;
+        prepared_batch.push_back(std::move(prepared));
+      } else {
+        LOG(WARNING) << "Icc Profile for level " << batch_target.level
+                     << " couldn't get generated!";
+        // never reaches the apply stage, reported like a failed apply
+        if (_applied_callback) {
+          _applied_callback(batch_target, false);
+        }
+      }
+      _generate_busy_ns += steadyNowNs() - begin;
+    }
+    publish(std::move(prepared_batch));
+  }
+
+  _generator_done.store(true, std::memory_order_release);
+  sem_post(&_published);
+}
+
+void ProfilePipeline::publish(
+    std::vector<std::unique_ptr<PreparedProfile>> prepared_batch) {
+  if (prepared_batch.empty()) {
+    return;
+  }
+  for (std::unique_ptr<PreparedProfile> &prepared : prepared_batch) {
+    uint display = prepared->target.display_device_id;
+    {
+      // the apply stage applies an older profile of this display, preempt it
+      // before publishing, so the newer one can't get hit
+      std::lock_guard<std::mutex> lk(_in_flight_mut);
+      if (_in_flight.count(display) && !_preempt_requested.count(display) &&
+          _applier->backend()->cancelUpdate(display)) {
+        _preempt_requested.insert(display);
+      }
+    }
+    std::unique_ptr<PreparedProfile> replaced(_slots[display].exchange(
+        prepared.release(), std::memory_order_acq_rel));
+    if (replaced) {
+      _dropped++;
+    }
+  }
+  sem_post(&_published);
+}
+
+void ProfilePipeline::setAppliedCallback(
+    std::function<void(const BrightnessTarget &, bool)> callback) {
+  _applied_callback = callback;
+}
+
+void ProfilePipeline::setMinInterval(std::chrono::milliseconds interval) {
+  _min_interval_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count();
+}
+
+void ProfilePipeline::setLevelStep(uint32_t step) { _level_step = step; }
+
+PipelineStats ProfilePipeline::stats() const {
+  int64_t started = _started_ns.load();
+  int64_t stopped = _stopped_ns.load();
+  double runtime_ns =
+      started ? static_cast<double>((stopped ? stopped : steadyNowNs()) -
+                                    started)
+              : 0.0;
+  auto utilization = [runtime_ns](uint64_t busy_ns) {
+    return runtime_ns > 0 ? busy_ns / runtime_ns : 0.0;
+  };
+  std::lock_guard<std::mutex> lk(_stats_mut);
+  return {utilization(_generate_busy_ns.load()),
+          utilization(_apply_busy_ns.load()),
+          _generated.load(),
+          _applied.load(),
+          _dropped.load(),
+          _preempted.load(),
+          _display_stats};
+}
+
+std::string ProfilePipeline::statsString() const {
+  PipelineStats current = stats();
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(1) << "pipeline generate_busy "
+     << current.generate_utilization * 100.0 << "% apply_busy "
+     << current.apply_utilization * 100.0 << "% generated "
+     << current.generated << " applied " << current.applied << " dropped "
+     << current.dropped << " preempted " << current.preempted;
+  for (const auto &[display, display_stats] : current.displays) {
+    ss << std::setprecision(2) << "\ndisplay " << display << " applied "
+       << display_stats.applied << " last_ms " << display_stats.last_ms
+       << " mean_ms " << display_stats.total_ms / display_stats.applied
+       << " max_ms " << display_stats.max_ms;
+  }
+  return ss.str();
+}
+
+ProfilePipeline::~ProfilePipeline() {
+  for (std::atomic<PreparedProfile *> &slot : _slots) {
+    delete slot.exchange(nullptr);
+  }
+  sem_destroy(&_published);
+}
@@ -0,0 +1,152 @@
+#include "ProfilePrefetcher.h"
+#include "ProfileGenerator.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <easylogging++.h>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+ProfilePrefetcher::ProfilePrefetcher(std::shared_ptr<ProfileApplier> applier,
+                                     uint depth)
+    : _applier(applier), _depth(depth), _history(), _queue(), _unused(),
+      _stats({0, 0, 0, 0, 0.0}), _running(false), _mut(), _cv(),
+      _prefetch_thread() {}
+
+bool ProfilePrefetcher::start() {
+  std::lock_guard<std::mutex> lk(_mut);
+  if (_running || !_applier->atlas()) {
+    LOG_IF(!_applier->atlas(), INFO) << "No profile atlas, prefetch disabled";
+    return false;
+  }
+  _running = true;
+  _prefetch_thread = std::thread(&ProfilePrefetcher::prefetchThread, this);
+  return true;
+}
+
+bool ProfilePrefetcher::stop() {
+  {
+    std::lock_guard<std::mutex> lk(_mut);
+    if (!_running) {
+      return false;
+    }
+    _running = false;
+    _queue.clear();
+  }
+  _cv.notify_all();
+  _prefetch_thread.join();
+  return true;
+}
+
+void ProfilePrefetcher::observe(uint display_device_id, uint32_t level) {
+  {
+    std::lock_guard<std::mutex> lk(_mut);
+    _stats.observed++;
+    auto unused = _unused.find(level);
+    if (unused != _unused.end()) {
+      _stats.hits++;
+      _unused.erase(unused);
+    }
+
+    std::deque<uint32_t> &history = _history[display_device_id];
+    history.push_back(level);
+    if (history.size() > PREFETCH_HISTORY_SIZE) {
+      history.pop_front();
+    }
+    if (!_running || _depth == 0 || history.size() < PREFETCH_HISTORY_SIZE) {
+      return;
+    }
+
+    // same step twice in a row, predict the next levels in this direction
+    int64_t step = static_cast<int64_t>(history[2]) - history[1];
+    int64_t previous_step = static_cast<int64_t>(history[1]) - history[0];
+    if (step == 0 || step != previous_step) {
+      return;
+    }
+    _queue.clear();
+    for (uint i = 1; i <= _depth; i++) {
+      int64_t next = static_cast<int64_t>(level) + step * i;
+      if (next < 0 || next > BRIGHTNESS_LEVEL_SCALE) {
+        break;
+      }
+      _queue.push_back(static_cast<uint32_t>(next));
+    }
+  }
+  _cv.notify_one();
+}
+
+void ProfilePrefetcher::prefetchThread() {
+  std::shared_ptr<ProfileAtlas> atlas = _applier->atlas();
+  std::vector<uint8_t> storage;
+  std::unique_lock<std::mutex> lk(_mut);
+  while (true) {
+    _cv.wait(lk, [this] { return !_running || !_queue.empty(); });
+    if (!_running) {
+      break;
+    }
+    uint32_t level = _queue.front();
+    _queue.pop_front();
+    lk.unlock();
+
+    bool generated = false;
+    auto begin = std::chrono::steady_clock::now();
+    if (!atlas->find(SRGB_BASE_PROFILE_ID, level)) {
+      generated = _applier->prepare(level, storage).has_value();
+    }
+    double generation_ms = std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - begin)
+                               .count();
+
+    lk.lock();
+    if (generated) {
+      LOG(DEBUG) << "Prefetched profile for level " << level;
+      _stats.prefetched++;
+      _unused[level] = generation_ms;
+    }
+  }
+}
+
+void ProfilePrefetcher::setDepth(uint depth) {
+  std::lock_guard<std::mutex> lk(_mut);
+  _depth = depth;
+  if (_depth == 0) {
+    _queue.clear();
+  }
+}
+
+PrefetchStats ProfilePrefetcher::stats() const {
+  std::lock_guard<std::mutex> lk(_mut);
+  PrefetchStats stats = _stats;
+  stats.wasted = _unused.size();
+  stats.wasted_ms = 0.0;
+  for (auto [level, generation_ms] : _unused) {
+    stats.wasted_ms += generation_ms;
+  }
+  return stats;
+}
+
+std::string ProfilePrefetcher::statsString() const {
+  PrefetchStats current = stats();
+  uint depth;
+  {
+    std::lock_guard<std::mutex> lk(_mut);
+    depth = _depth;
+  }
+  double hit_rate =
+      current.observed ? 100.0 * current.hits / current.observed : 0.0;
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(1) << "prefetch depth " << depth
+     << " observed " << current.observed << " prefetched "
+     << current.prefetched << " hits " << current.hits << " hit_rate "
+     << hit_rate << "% wasted " << current.wasted << " wasted_ms "
+     << current.wasted_ms;
+  return ss.str();
+}
+
+ProfilePrefetcher::~ProfilePrefetcher() {
+  stop();
+  LOG(INFO) << "Prefetch stats: " << statsString();
+}
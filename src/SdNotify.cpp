@@ -0,0 +1,45 @@
+#include "SdNotify.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <easylogging++.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+bool sdNotify(const std::string &state) {
+  const char *socket_path = std::getenv("NOTIFY_SOCKET");
+  if (!socket_path || socket_path[0] == '\0') {
+    return false;
+  }
+  size_t path_len = strlen(socket_path);
+  sockaddr_un addr = {};
+  if (path_len >= sizeof(addr.sun_path) ||
+      (socket_path[0] != '/' && socket_path[0] != '@')) {
+    LOG(WARNING) << "Invalid NOTIFY_SOCKET: " << socket_path;
+    return false;
+  }
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, socket_path, path_len);
+  // abstract namespace socket
+  if (addr.sun_path[0] == '@') {
+    addr.sun_path[0] = '\0';
+  }
+
+  int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    LOG(WARNING) << "Couldn't create socket for sd_notify, errno: "
+                 << strerror(errno);
+    return false;
+  }
+  ssize_t sent =
+      sendto(fd, state.data(), state.size(), MSG_NOSIGNAL,
+             reinterpret_cast<sockaddr *>(&addr),
+             offsetof(sockaddr_un, sun_path) + path_len);
+  LOG_IF(sent < 0, WARNING) << "Couldn't notify service manager, errno: "
+                            << strerror(errno);
+  close(fd);
+  return sent == static_cast<ssize_t>(state.size());
+}
@@ -0,0 +1,83 @@
+#include "SealedProfile.h"
+#include "GHandles.h"
+#include <cerrno>
+#include <cstring>
+#include <easylogging++.h>
+#include <fcntl.h>
+#include <gio/gunixfdlist.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <system_error>
+#include <unistd.h>
+
+SealedProfile::SealedProfile(const std::string &name, const uint8_t *data,
+                             size_t size)
+    : _fd(memfd_create(name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING)) {
+  if (_fd < 0) {
+    throw std::system_error(errno, std::system_category(),
+                            "memfd couldn't get created");
+  }
+  size_t written = 0;
+  while (written < size) {
+    ssize_t len = pwrite(_fd, data + written, size - written, written);
+    if (len < 0 && errno == EINTR) {
+      continue;
+    }
+    if (len < 0) {
+      int write_errno = errno;
+      close(_fd);
+      throw std::system_error(write_errno, std::system_category(),
+                              "icc data couldn't get written");
+    }
+    written += len;
+  }
+  // F_SEAL_WRITE only succeeds without writable mappings, there are none
+  if (fcntl(_fd, F_ADD_SEALS, SEALED_PROFILE_SEALS) != 0) {
+    int seal_errno = errno;
+    close(_fd);
+    throw std::system_error(seal_errno, std::system_category(),
+                            "memfd couldn't get sealed");
+  }
+}
+
+int SealedProfile::fd() const { return _fd; }
+
+std::filesystem::path SealedProfile::path() const {
+  std::stringstream ss;
+  ss << "/proc/" << getpid() << "/fd/" << _fd;
+  return ss.str();
+}
+
+SealedProfile::~SealedProfile() { close(_fd); }
+
+std::optional<std::string>
+create_profile_with_fd(GDBusConnection *connection,
+                       const std::string &profile_id, CdObjectScope scope,
+                       int fd, const std::filesystem::path &filename,
+                       GCancellable *cancellable, GError **error) {
+  GUnixFDListHandle fd_list(g_unix_fd_list_new());
+  // duplicates the fd, the list closes its copy
+  gint fd_index = g_unix_fd_list_append(fd_list.get(), fd, error);
+  if (fd_index < 0) {
+    return std::nullopt;
+  }
+
+  GVariantBuilder properties;
+  g_variant_builder_init(&properties, G_VARIANT_TYPE("a{ss}"));
+  g_variant_builder_add(&properties, "{ss}", CD_PROFILE_PROPERTY_FILENAME,
+                        filename.c_str());
+  GVariantHandle result(g_dbus_connection_call_with_unix_fd_list_sync(
+      connection, COLORD_DBUS_SERVICE, COLORD_DBUS_PATH, COLORD_DBUS_INTERFACE,
+      "CreateProfileWithFd",
+      g_variant_new("(ssha{ss})", profile_id.c_str(),
+                    cd_object_scope_to_string(scope), fd_index, &properties),
+      G_VARIANT_TYPE("(o)"), G_DBUS_CALL_FLAGS_NONE, -1, fd_list.get(), NULL,
+      cancellable, error));
+  if (!result) {
+    return std::nullopt;
+  }
+  const gchar *object_path = NULL;
+  g_variant_get(result.get(), "(&o)", &object_path);
+  LOG(DEBUG) << "Created profile " << object_path << " from fd " << fd;
+  return std::string(object_path);
+}
@@ -0,0 +1,55 @@
+#include "SysfsPollEventSource.h"
+#include <cerrno>
+#include <cstring>
+#include <easylogging++.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <optional>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+
+#define SYSFS_ATTRIBUTE_MAX_SIZE 64
+
+SysfsPollEventSource::SysfsPollEventSource(std::filesystem::path attribute)
+    : FdEventSource(attribute), _attribute_fd(-1) {
+  _attribute_fd = open(_attribute.c_str(), O_RDONLY | O_CLOEXEC);
+  if (_attribute_fd < 0) {
+    std::stringstream ss;
+    ss << "Sysfs attribute " << _attribute << " couldn't get opened";
+    throw std::system_error(errno, std::generic_category(), ss.str());
+  }
+}
+
+bool SysfsPollEventSource::start() {
+  // sysfs only notifies after the attribute got read once
+  return FdEventSource::start() && readAttribute().has_value();
+}
+
+std::optional<std::string> SysfsPollEventSource::waitAndGet() {
+  if (!waitForEvent(_attribute_fd, POLLPRI)) {
+    return std::nullopt;
+  }
+  return readAttribute();
+}
+
+std::optional<std::string> SysfsPollEventSource::readAttribute() {
+  char buf[SYSFS_ATTRIBUTE_MAX_SIZE];
+  ssize_t len;
+  do {
+    len = pread(_attribute_fd, buf, sizeof(buf), 0);
+  } while (len < 0 && errno == EINTR);
+  if (len < 0) {
+    LOG(ERROR) << "Couldn't read sysfs attribute " << _attribute
+               << ", errno: " << strerror(errno);
+    return std::nullopt;
+  }
+  return std::string(buf, len);
+}
+
+SysfsPollEventSource::~SysfsPollEventSource() {
+  LOG_IF(close(_attribute_fd) != 0, ERROR)
+      << "Couldnt close sysfs attribute fd, errno: " << strerror(errno);
+}
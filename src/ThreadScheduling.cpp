@@ -0,0 +1,215 @@
+#include "ThreadScheduling.h"
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <easylogging++.h>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+// -----------------Helper  functions----------------
+
+std::mutex scheduling_mut;
+std::array<std::optional<ThreadScheduling>, 3> role_scheduling;
+
+const char *role_name(thread_role role) {
+  switch (role) {
+  case thread_role::watcher:
+    return "watcher";
+  case thread_role::generator:
+    return "generator";
+  case thread_role::apply:
+    return "apply";
+  }
+  return "unknown";
+}
+
+/*! \brief parses "0-3,6", nullopt on invalid or too big cpus */
+std::optional<std::vector<int>> parse_cpu_list(const std::string &list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  try {
+    while (std::getline(ss, range, ',')) {
+      size_t dash = range.find('-');
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos
+                     ? first
+                     : std::stoi(range.substr(dash + 1));
+      if (first < 0 || last < first || last >= CPU_SETSIZE) {
+        return std::nullopt;
+      }
+      for (int cpu = first; cpu <= last; cpu++) {
+        cpus.push_back(cpu);
+      }
+    }
+  } catch (std::exception &e) {
+    return std::nullopt;
+  }
+  if (cpus.empty()) {
+    return std::nullopt;
+  }
+  return cpus;
+}
+
+// -------------------------------------
+
+std::optional<thread_role> parse_thread_role(const std::string &role) {
+  if (role == "watcher") {
+    return thread_role::watcher;
+  }
+  if (role == "generator") {
+    return thread_role::generator;
+  }
+  if (role == "apply") {
+    return thread_role::apply;
+  }
+  return std::nullopt;
+}
+
+std::optional<ThreadScheduling>
+parse_thread_scheduling(const std::string &spec) {
+  ThreadScheduling scheduling;
+  size_t at = spec.find('@');
+  if (at != std::string::npos) {
+    std::optional<std::vector<int>> cpus = parse_cpu_list(spec.substr(at + 1));
+    if (!cpus) {
+      return std::nullopt;
+    }
+    scheduling.cpus = cpus.value();
+  }
+  std::string policy = spec.substr(0, at);
+  size_t colon = policy.find(':');
+  std::optional<int> value;
+  if (colon != std::string::npos) {
+    try {
+      size_t parsed = 0;
+      value = std::stoi(policy.substr(colon + 1), &parsed);
+      if (parsed != policy.size() - colon - 1) {
+        return std::nullopt;
+      }
+    } catch (std::exception &e) {
+      return std::nullopt;
+    }
+    policy = policy.substr(0, colon);
+  }
+
+  if (policy == "other") {
+    if (value && (value < -20 || value > 19)) {
+      return std::nullopt;
+    }
+    scheduling.nice = value;
+    return scheduling;
+  }
+  if (policy == "fifo" || policy == "rr") {
+    scheduling.policy = policy == "fifo" ? SCHED_FIFO : SCHED_RR;
+    scheduling.priority = value.value_or(
+        sched_get_priority_min(scheduling.policy));
+    if (scheduling.priority < sched_get_priority_min(scheduling.policy) ||
+        scheduling.priority > sched_get_priority_max(scheduling.policy)) {
+      return std::nullopt;
+    }
+    return scheduling;
+  }
+  return std::nullopt;
+}
+
+std::string thread_scheduling_string(const ThreadScheduling &scheduling) {
+  std::stringstream ss;
+  switch (scheduling.policy) {
+  case SCHED_FIFO:
+    ss << "fifo:" << scheduling.priority;
+    break;
+  case SCHED_RR:
+    ss << "rr:" << scheduling.priority;
+    break;
+  default:
+    ss << "other";
+    if (scheduling.nice) {
+      ss << ":" << scheduling.nice.value();
+    }
+  }
+  for (size_t i = 0; i < scheduling.cpus.size(); i++) {
+    ss << (i == 0 ? "@" : ",") << scheduling.cpus[i];
+  }
+  return ss.str();
+}
+
+void set_thread_scheduling(thread_role role,
+                           const ThreadScheduling &scheduling) {
+  std::lock_guard<std::mutex> lk(scheduling_mut);
+  role_scheduling[static_cast<size_t>(role)] = scheduling;
+}
+
+bool apply_thread_scheduling(thread_role role) {
+  std::optional<ThreadScheduling> scheduling;
+  {
+    std::lock_guard<std::mutex> lk(scheduling_mut);
+    scheduling = role_scheduling[static_cast<size_t>(role)];
+  }
+  if (!scheduling) {
+    return true;
+  }
+  bool applied = apply_thread_scheduling(scheduling.value());
+  LOG_IF(applied, DEBUG) << "Scheduling of the " << role_name(role)
+                         << " thread: "
+                         << thread_scheduling_string(scheduling.value());
+  LOG_IF(!applied, WARNING) << "Scheduling of the " << role_name(role)
+                            << " thread couldn't get set to "
+                            << thread_scheduling_string(scheduling.value());
+  return applied;
+}
+
+bool apply_thread_scheduling(const ThreadScheduling &scheduling) {
+  bool applied = true;
+  if (!scheduling.cpus.empty()) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu : scheduling.cpus) {
+      CPU_SET(cpu, &cpus);
+    }
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (error != 0) {
+      LOG(WARNING) << "CPU affinity couldn't get set, errno: "
+                   << strerror(error);
+      applied = false;
+    }
+  }
+
+  if (scheduling.policy == SCHED_FIFO || scheduling.policy == SCHED_RR) {
+    sched_param param = {};
+    param.sched_priority = scheduling.priority;
+    int error =
+        pthread_setschedparam(pthread_self(), scheduling.policy, &param);
+    if (error != 0) {
+      LOG(WARNING) << "Real-time scheduling couldn't get set, errno: "
+                   << strerror(error);
+      applied = false;
+    }
+  } else if (scheduling.nice) {
+    // the nice value of a thread, not of the whole process on linux
+    if (setpriority(PRIO_PROCESS, syscall(SYS_gettid),
+                    scheduling.nice.value()) != 0) {
+      LOG(WARNING) << "Nice value couldn't get set, errno: "
+                   << strerror(errno);
+      applied = false;
+    }
+  }
+  return applied;
+}
+
+bool lock_memory() {
+  // MCL_ONFAULT: only the touched pages, not the whole reserved stacks
+  if (mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT) != 0) {
+    LOG(WARNING) << "Memory couldn't get locked, errno: " << strerror(errno);
+    return false;
+  }
+  return true;
+}
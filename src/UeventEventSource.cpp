@@ -0,0 +1,130 @@
+#include "UeventEventSource.h"
+#include <cerrno>
+#include <cstring>
+#include <easylogging++.h>
+#include <filesystem>
+#include <linux/netlink.h>
+#include <optional>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+
+#define UEVENT_KERNEL_GROUP 1
+
+// -----------------Helper  functions----------------
+
+std::string deviceName(std::filesystem::path device_dir) {
+  // the directory is usually given with a trailing slash
+  if (!device_dir.has_filename()) {
+    device_dir = device_dir.parent_path();
+  }
+  return device_dir.filename();
+}
+
+// -------------------------------------
+
+int UeventEventSource::openSocket() {
+  int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  NETLINK_KOBJECT_UEVENT);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Uevent socket couldn't get created");
+  }
+  sockaddr_nl addr = {};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = UEVENT_KERNEL_GROUP;
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    int err = errno;
+    close(fd);
+    throw std::system_error(err, std::generic_category(),
+                            "Uevent socket couldn't get bound");
+  }
+  return fd;
+}
+
+UeventEventSource::UeventEventSource(std::filesystem::path device_dir)
+    : UeventEventSource(device_dir, openSocket()) {}
+
+UeventEventSource::UeventEventSource(std::filesystem::path device_dir,
+                                     int uevent_fd)
+    : UeventEventSource("backlight", deviceName(device_dir),
+                        device_dir / ACTUAL_BRIGHTNESS_FILE, uevent_fd) {}
+
+UeventEventSource::UeventEventSource(std::string subsystem,
+                                     std::string device_name,
+                                     std::filesystem::path attribute,
+                                     int uevent_fd)
+    : FdEventSource(attribute), _subsystem(subsystem),
+      _device_name(device_name), _uevent_fd(uevent_fd) {}
+
+std::optional<std::string> UeventEventSource::waitAndGet() {
+  char buf[UEVENT_BUF_SIZE];
+  while (waitForEvent(_uevent_fd, POLLIN)) {
+    sockaddr_nl sender = {};
+    socklen_t sender_len = sizeof(sender);
+    ssize_t len = recvfrom(_uevent_fd, buf, sizeof(buf), MSG_DONTWAIT,
+                           reinterpret_cast<sockaddr *>(&sender), &sender_len);
+    if (len < 0) {
+      if (errno == ENOBUFS) {
+        // events got lost, one of them could have been ours
+        return readFile();
+      }
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      LOG(ERROR) << "Couldn't receive uevent, errno: " << strerror(errno);
+      return std::nullopt;
+    }
+    // only trust the kernel on a netlink socket
+    if (sender_len >= sizeof(sender) && sender.nl_family == AF_NETLINK &&
+        sender.nl_pid != 0) {
+      continue;
+    }
+    if (isChange(buf, len, _subsystem, _device_name)) {
+      return readFile();
+    }
+  }
+  return std::nullopt;
+}
+
+bool UeventEventSource::isBacklightChange(const char *message, size_t size,
+                                          const std::string &device_name) {
+  return isChange(message, size, "backlight", device_name);
+}
+
+bool UeventEventSource::isChange(const char *message, size_t size,
+                                 const std::string &subsystem,
+                                 const std::string &device_name) {
+  bool change = false;
+  bool in_subsystem = false;
+  bool device = device_name.empty();
+  size_t start = 0;
+  while (start < size) {
+    size_t end = start;
+    while (end < size && message[end] != '\0') {
+      end++;
+    }
+    std::string entry(message + start, end - start);
+    start = end + 1;
+
+    if (entry.rfind("libudev", 0) == 0) {
+      return false; // rebroadcast by udevd, binary format
+    } else if (entry == "ACTION=change") {
+      change = true;
+    } else if (entry == "SUBSYSTEM=" + subsystem) {
+      in_subsystem = true;
+    } else if (entry.rfind("DEVPATH=", 0) == 0 && !device_name.empty()) {
+      std::string suffix = "/" + device_name;
+      device = entry.size() >= suffix.size() &&
+               entry.compare(entry.size() - suffix.size(), suffix.size(),
+                             suffix) == 0;
+    }
+  }
+  return change && in_subsystem && device;
+}
+
+UeventEventSource::~UeventEventSource() {
+  LOG_IF(close(_uevent_fd) != 0, ERROR)
+      << "Couldnt close uevent socket, errno: " << strerror(errno);
+}
@@ -1,116 +1,285 @@
+#include "AmbientLightEventSource.h"
+#include "AsyncLogSink.h"
+#include "BrightnessEventSource.h"
+#include "BrightnessTargets.h"
+#include "BrightnessTrace.h"
 #include "ColordHandler.h"
-#include "FileWatcher.h"
+#include "ControlSocket.h"
+#include "DaemonState.h"
+#include "DisplayFanOut.h"
+#include "GuardedBackend.h"
+#include "PowerPolicy.h"
+#include "PowerSupplyEventSource.h"
+#include "ProfileApplier.h"
+#include "ProfileAtlas.h"
+#include "ProfileGenerator.h"
+#include "ProfilePipeline.h"
+#include "ProfilePrefetcher.h"
+#include "SdNotify.h"
+#include "ThreadScheduling.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cctype>
-#include <climits>
+#include <chrono>
 #include <cstddef>
 #include <easylogging++.h>
 #include <exception>
 #include <filesystem>
+#include <fstream>
+#include <future>
 #include <lcms2.h>
+#include <map>
 #include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 INITIALIZE_EASYLOGGINGPP
 #define ELPP_LOGGING_FLAGS_FROM_ARGS
 
 #define MAX_BRIGHTNESS_FILE "max_brightness"
-#define BRIGHTNESS_FILE "brightness"
-
-// based on color profile creation from:
-// https://github.com/udifuchs/icc-brightness/blob/master/icc-brightness-gen.c
-cmsHPROFILE create_srgb_profile(double brightness) {
-  // cmsHPROFILE hsRGB = cmsCreate_sRGBProfile();
-  cmsContext ctx = cmsCreateContext(NULL, NULL);
-  cmsHPROFILE hsRGB = cmsCreate_sRGBProfileTHR(ctx);
-
-  cmsMLU *mlu = cmsMLUalloc(NULL, 1);
-  char description[20];
-  snprintf(description, 20, "Brightness %.2f", brightness);
-  cmsMLUsetASCII(mlu, "en", "US", description);
-  cmsWriteTag(hsRGB, cmsSigProfileDescriptionTag, mlu);
-  cmsMLUfree(mlu);
-
-  cmsContext context_id = cmsCreateContext(NULL, NULL);
-  double used_brightness = std::clamp(brightness, 0.1, 1.0);
-  double curve[] = {1.0, used_brightness,
-                    0.0}; // gamma, a, b for (a X +b)^gamma
-  cmsToneCurve *tone_curve[3] = {
-      cmsBuildParametricToneCurve(context_id, 2, curve),
-      cmsBuildParametricToneCurve(context_id, 2, curve),
-      cmsBuildParametricToneCurve(context_id, 2, curve),
-  };
-  cmsWriteTag(hsRGB, cmsSigVcgtTag, tone_curve);
-  cmsFreeToneCurve(tone_curve[0]);
-  cmsFreeToneCurve(tone_curve[1]);
-  cmsFreeToneCurve(tone_curve[2]);
-
-  return hsRGB;
+
+struct ColordBrightnessConfig {
+  std::filesystem::path icc_file;
+  std::filesystem::path brightness_driver_dir;
+  std::optional<std::chrono::seconds>
+      idle_exit; /*!< exit after this time without a change */
+  uint prefetch_depth; /*!< profiles generated ahead, 0 disables prefetch */
+  std::optional<std::filesystem::path>
+      record_file; /*!< trace of the backlight changes */
+  std::map<std::string, event_source_kind>
+      event_sources; /*!< per backlight device, "" for all others */
+  std::optional<std::vector<uint>>
+      fan_out_displays; /*!< also following the backlight, empty: all */
+  std::map<uint, double> display_scales;
+  bool async_log; /*!< log messages written on their own thread */
+  std::optional<std::filesystem::path>
+      ambient_light; /*!< iio light sensor, empty: the first one */
+  bool sealed_profiles; /*!< profiles passed to colord as sealed memfds */
+  std::optional<std::string>
+      power_policy; /*!< auto (following the power supply), ac or battery */
+  std::map<thread_role, ThreadScheduling> thread_scheduling;
+  bool lock_memory; /*!< mlockall, no page faults on wakeups */
+  std::chrono::milliseconds
+      apply_timeout; /*!< deadline of a profile update, 0 disables it */
+};
+
+/*! \brief parses the content of the brightness file to a quantized level
+ *  \return nullopt if the content is no number
+ */
+std::optional<uint32_t> parse_brightness_level(std::string brightness_str,
+                                               uint max_abs_brightness) {
+  if (!brightness_str.empty() && brightness_str.back() == '\n') {
+    brightness_str.pop_back();
+  }
+  if (brightness_str.empty() || max_abs_brightness == 0) {
+    return std::nullopt;
+  }
+  // check, if value of file is integer
+  for (auto c : brightness_str) {
+    if (!std::isdigit(c)) {
+      LOG(WARNING) << "Content of file to watch is no a number! "
+                   << brightness_str << " at char: " << c;
+      return std::nullopt;
+    }
+  }
+  double brightness = std::stod(brightness_str);
+  return quantize_brightness(brightness / max_abs_brightness);
+}
+
+std::optional<uint> read_max_brightness(std::filesystem::path file) {
+  std::ifstream max_brightness_file(file);
+  if (!max_brightness_file.is_open()) {
+    LOG(ERROR) << "Couldn't open file with max brightness! Path: " << file;
+    return std::nullopt;
+  }
+  uint max_brightness = 0;
+  if (!(max_brightness_file >> max_brightness) || max_brightness == 0) {
+    LOG(ERROR) << "Invalid max brightness in " << file;
+    return std::nullopt;
+  }
+  return max_brightness;
 }
 
-/*! TODO: maybe remove assertions?
- *  \todo maybe remove assertions?
+double elapsed_ms(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - since)
+      .count();
+}
+
+/*! \brief posts the brightness of the backlight for the displays of the
+ * fan-out on every change reported by the event source
+ *
+ *  \param recorder optional, records every change
+ *  \param max_abs_brightness content of the source at full brightness
  */
-void startWatchAndApplyBrightness(std::shared_ptr<ColordHandler> cd_handle,
-                                  std::shared_ptr<FileWatcher> fw,
-                                  uint max_abs_brightness) {
-  LOG_IF(!fw, FATAL)
-      << "FileWatcher coudn't get constructed but no exception was thrown!?!";
-  LOG_IF(!cd_handle, FATAL)
-      << "ColordHandler coudn't get constructed but no exception was thrown!?!";
-  assert(fw);
-  assert(cd_handle);
-
-  file_watch_error started = fw->startWatching();
-  if (started == file_watch_error::success) {
-  } else {
-    LOG(ERROR) << "Error occured on starting the filewatcher! ERROR:";
-    switch (started) {
-    case file_watch_error::error_unknown:
-      LOG(ERROR) << "Unknown Error";
-      break;
-    case file_watch_error::error_still_watching:
-      LOG(ERROR) << "Already watching";
-      break;
-    default:
-      LOG(ERROR) << "Errno: " << strerror((int)started);
-    }
-    return;
-  }
-  assert(fw->startWatching() == file_watch_error::error_still_watching);
-  // fw started
-
-  std::optional<std::string> new_brightness = fw->readFile();
-  do {
-    if (new_brightness.has_value()) {
-      std::string brightness_str = new_brightness.value();
-      int end = brightness_str.length() - 1;
-      if (!brightness_str.empty() && brightness_str[end] == '\n') {
-        brightness_str.erase(end);
+void forwardBacklightChanges(std::shared_ptr<BrightnessEventSource> source,
+                             std::shared_ptr<BrightnessTargets> targets,
+                             std::shared_ptr<TraceRecorder> recorder,
+                             DisplayFanOut fan_out, uint max_abs_brightness) {
+  apply_thread_scheduling(thread_role::watcher);
+  std::optional<std::string> new_brightness;
+  while ((new_brightness = source->waitAndGet())) {
+    if (std::optional<uint32_t> level = parse_brightness_level(
+            new_brightness.value(), max_abs_brightness)) {
+      if (recorder) {
+        recorder->record(0, level.value());
       }
+      targets->postBatch(fan_out.levels(level.value()));
+    } else {
+      LOG(WARNING) << "Error retreiving brightness value from filewatcher!";
+    }
+  }
+}
+
+/*! \brief switches the update policy on every change of the power supply
+ */
+void forwardPowerChanges(std::shared_ptr<BrightnessEventSource> source,
+                         std::shared_ptr<PowerPolicy> policy) {
+  std::optional<std::string> external_power;
+  while ((external_power = source->waitAndGet())) {
+    policy->setOnBattery(external_power.value() == "0\n");
+  }
+}
 
-      // check, if value of file is integer
-      for (auto c : brightness_str) {
-        if (!std::isdigit(c)) {
-          LOG(WARNING) << "Content of file to watch is no a number! "
-                       << new_brightness.value() << " at char: " << c;
-          continue;
+/*! \brief parses the daemon options, unknown options are left to
+ * easylogging++
+ *  \return false on an invalid value
+ */
+bool parse_args(int argc, char *argv[], ColordBrightnessConfig &conf) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--async-log") {
+      conf.async_log = true;
+      continue;
+    }
+    if (arg == "--sealed-profiles") {
+      conf.sealed_profiles = true;
+      continue;
+    }
+    if (arg == "--mlock") {
+      conf.lock_memory = true;
+      continue;
+    }
+    std::string option = arg.substr(0, arg.find('='));
+    if (option != "--idle-exit" && option != "--prefetch-depth" &&
+        option != "--record" && option != "--event-source" &&
+        option != "--fan-out" && option != "--display-scale" &&
+        option != "--ambient-light" && option != "--power-policy" &&
+        option != "--sched" && option != "--apply-timeout") {
+      continue;
+    }
+    std::string value;
+    if (option != arg) {
+      value = arg.substr(arg.find('=') + 1);
+    } else if (i + 1 < argc) {
+      value = argv[++i];
+    }
+    if (option == "--record") {
+      if (value.empty()) {
+        LOG(ERROR) << "Missing trace file for --record";
+        return false;
+      }
+      conf.record_file = value;
+      continue;
+    }
+    if (option == "--ambient-light") {
+      // auto or <iio device dir>
+      conf.ambient_light =
+          std::filesystem::path(value == "auto" ? "" : value);
+      continue;
+    }
+    if (option == "--power-policy") {
+      if (value != "auto" && value != "ac" && value != "battery") {
+        LOG(ERROR) << "Invalid power policy: " << value;
+        return false;
+      }
+      conf.power_policy = value;
+      continue;
+    }
+    if (option == "--sched") {
+      // <role>=<policy>[:<value>][@<cpus>]
+      size_t separator = value.find('=');
+      std::optional<thread_role> role =
+          parse_thread_role(value.substr(0, separator));
+      std::optional<ThreadScheduling> scheduling =
+          separator == std::string::npos
+              ? std::nullopt
+              : parse_thread_scheduling(value.substr(separator + 1));
+      if (!role || !scheduling) {
+        LOG(ERROR) << "Invalid thread scheduling: " << value;
+        return false;
+      }
+      conf.thread_scheduling[role.value()] = scheduling.value();
+      continue;
+    }
+    if (option == "--event-source") {
+      // [<device>=]<kind>
+      size_t separator = value.find('=');
+      std::string device =
+          separator == std::string::npos ? "" : value.substr(0, separator);
+      std::optional<event_source_kind> kind = parse_event_source_kind(
+          separator == std::string::npos ? value
+                                         : value.substr(separator + 1));
+      if (!kind) {
+        LOG(ERROR) << "Invalid event source: " << value;
+        return false;
+      }
+      conf.event_sources[device] = kind.value();
+      continue;
+    }
+    try {
+      if (option == "--fan-out") {
+        // all or <display>[,<display>...]
+        conf.fan_out_displays = std::vector<uint>();
+        std::stringstream displays(value == "all" ? "" : value);
+        std::string display;
+        while (std::getline(displays, display, ',')) {
+          conf.fan_out_displays->push_back(std::stoul(display));
         }
+        continue;
       }
-      // calculate profile and set it do display
-      double brightness = std::stod(brightness_str);
-      cmsHPROFILE new_profile =
-          create_srgb_profile(brightness / max_abs_brightness);
-      LOG_IF(!cd_handle->setIccFromCmsProfile(new_profile), WARNING)
-          << "Icc Profile not updated!";
-    } else {
-      LOG(WARNING) << "Error retreiving brightness value from filewatcher!";
+      if (option == "--display-scale") {
+        // <display>=<factor>
+        size_t separator = value.find('=');
+        double scale = std::stod(value.substr(separator + 1));
+        if (separator == std::string::npos || scale < 0) {
+          throw std::out_of_range(value);
+        }
+        conf.display_scales[std::stoul(value.substr(0, separator))] = scale;
+        continue;
+      }
+      long number = std::stol(value);
+      if (option == "--idle-exit") {
+        if (number <= 0) {
+          throw std::out_of_range(value);
+        }
+        conf.idle_exit = std::chrono::seconds(number);
+      } else if (option == "--apply-timeout") {
+        if (number < 0) {
+          throw std::out_of_range(value);
+        }
+        conf.apply_timeout = std::chrono::milliseconds(number);
+      } else {
+        if (number < 0 || number > BRIGHTNESS_LEVEL_SCALE) {
+          throw std::out_of_range(value);
+        }
+        conf.prefetch_depth = number;
+      }
+    } catch (std::exception &e) {
+      LOG(ERROR) << "Invalid value for " << option << ": " << value;
+      return false;
     }
-  } while ((new_brightness = fw->waitAndGet()));
+  }
+  return true;
 }
 
 int main(int argc, char *argv[]) {
+  auto startup_begin = std::chrono::steady_clock::now();
   START_EASYLOGGINGPP(argc, argv);
   el::Loggers::addFlag(el::LoggingFlag::HierarchicalLogging);
   el::Loggers::setLoggingLevel(el::Level::Warning);
@@ -121,43 +290,386 @@ int main(int argc, char *argv[]) {
                            "%datetime %level %msg");
   el::Loggers::reconfigureAllLoggers(default_conf);
 
-  struct ColordBrightnessConfig {
-    std::filesystem::path icc_file;
-    std::filesystem::path brightness_driver_dir;
-  } conf = {"colord_brightness_profile.icc",
-            "/sys/class/backlight/intel_backlight/"};
+  ColordBrightnessConfig conf = {"colord_brightness_profile.icc",
+                                 "/sys/class/backlight/intel_backlight/",
+                                 std::nullopt, DEFAULT_PREFETCH_DEPTH,
+                                 std::nullopt, {},
+                                 std::nullopt, {},
+                                 false, std::nullopt,
+                                 false, std::nullopt,
+                                 {}, false,
+                                 DEFAULT_APPLY_TIMEOUT};
+  if (!parse_args(argc, argv, conf)) {
+    return -1;
+  }
+  // before any thread gets started
+  for (const auto &[role, scheduling] : conf.thread_scheduling) {
+    set_thread_scheduling(role, scheduling);
+  }
+  if (conf.lock_memory) {
+    lock_memory();
+  }
+  // declared before the threads, so it gets destroyed after they logged
+  std::unique_ptr<AsyncLogSink> log_sink;
+  if (conf.async_log) {
+    log_sink = std::make_unique<AsyncLogSink>();
+    log_sink->start();
+  }
+
+  // idle exit needs the runtime dir for the state and the icc file
+  std::optional<std::filesystem::path> state_path;
+  std::optional<DaemonState> restored_state;
+  if (conf.idle_exit) {
+    state_path = default_state_path();
+    if (state_path) {
+      restored_state = load_daemon_state(state_path.value());
+    } else {
+      LOG(WARNING) << "XDG_RUNTIME_DIR not set, idle exit disabled!";
+      conf.idle_exit = std::nullopt;
+    }
+  }
 
   std::shared_ptr<ColordHandler> cd_handle;
-  std::shared_ptr<FileWatcher> fw;
+  std::shared_ptr<BrightnessEventSource> source;
   /*! TODO: improve error handling
    *  \todo improve error handling
    */
   assert(!conf.brightness_driver_dir.has_filename());
   assert(conf.icc_file.has_filename());
+
+  // connecting colord and discovering the display devices takes the most
+  // time, do it while sysfs gets read and the first profile gets prepared
+  std::filesystem::path icc_file = conf.icc_file;
+  std::optional<std::filesystem::path> persistent_icc_file;
+  if (conf.idle_exit) {
+    persistent_icc_file = state_path->parent_path() / conf.icc_file;
+  }
+  bool sealed_profiles = conf.sealed_profiles;
+  std::future<std::shared_ptr<ColordHandler>> cd_handle_future = std::async(
+      std::launch::async, [icc_file, persistent_icc_file, sealed_profiles]() {
+        auto handle = std::make_shared<ColordHandler>(icc_file);
+        if (persistent_icc_file) {
+          handle->usePersistentProfiles(persistent_icc_file.value());
+        }
+        LOG_IF(sealed_profiles && !handle->useSealedProfiles(), WARNING)
+            << "Profiles get passed by path, not sealed!";
+        handle->discoverDisplayDevices();
+        return handle;
+      });
+
+  std::filesystem::path device_dir = conf.brightness_driver_dir;
+  std::string device_name = device_dir.parent_path().filename();
+  event_source_kind source_kind = event_source_kind::automatic;
+  if (conf.event_sources.count(device_name)) {
+    source_kind = conf.event_sources[device_name];
+  } else if (conf.event_sources.count("")) {
+    source_kind = conf.event_sources[""];
+  }
   try {
-    fw = std::make_shared<FileWatcher>(conf.brightness_driver_dir /
-                                       BRIGHTNESS_FILE);
+    source = make_event_source(device_dir, source_kind);
   } catch (std::exception &e) {
-    LOG(ERROR) << "Exception in creation of FileWatcher! Exception:"
+    LOG(ERROR) << "Exception in creation of the event source! Exception:"
                << e.what();
     return -1;
   }
+  // watch before reading the current value, so no change gets lost
+  if (!source->start()) {
+    LOG(ERROR) << "Event source couldn't get started!";
+    return -1;
+  }
+
+  // the atlas is only an optimisation, fall back to one in memory (which
+  // still serves prefetched profiles) or run without it if it can't be used
+  std::shared_ptr<ProfileAtlas> atlas;
+  if (std::optional<std::filesystem::path> atlas_path =
+          ProfileAtlas::defaultPath()) {
+    try {
+      atlas = std::make_shared<ProfileAtlas>(atlas_path.value());
+    } catch (std::exception &e) {
+      LOG(WARNING) << "Profile atlas couldn't get opened! Exception:"
+                   << e.what();
+    }
+  }
+  if (!atlas) {
+    try {
+      atlas = ProfileAtlas::inMemory();
+    } catch (std::exception &e) {
+      LOG(WARNING) << "In-memory profile atlas couldn't get created! "
+                      "Exception:"
+                   << e.what();
+    }
+  }
+  std::optional<uint> max_brightness =
+      read_max_brightness(conf.brightness_driver_dir / MAX_BRIGHTNESS_FILE);
+  if (!max_brightness.has_value()) {
+    return -1;
+  }
+
+  // the applier gets its backend when colord is ready
+  ProfileApplier profile_source(nullptr, atlas);
+  std::vector<uint8_t> first_storage;
+  std::optional<ProfileBlob> first_profile;
+  std::optional<uint32_t> first_level; /*!< of the first display */
+  std::optional<uint32_t> backlight_level;
+  if (std::optional<std::string> content = source->readFile()) {
+    backlight_level =
+        parse_brightness_level(content.value(), max_brightness.value());
+    if (backlight_level) {
+      first_level = DisplayFanOut({0}, conf.display_scales)
+                        .levels(backlight_level.value())[0];
+      first_profile =
+          profile_source.prepare(first_level.value(), first_storage);
+    }
+  }
+  double profile_ready_ms = elapsed_ms(startup_begin);
+
   try {
-    cd_handle = std::make_shared<ColordHandler>(conf.icc_file);
+    cd_handle = cd_handle_future.get();
   } catch (std::exception &e) {
     LOG(ERROR) << "Exception in creation of ColordHandler! Exception:"
                << e.what();
     return -1;
   }
-  std::ifstream max_brightness_file(conf.brightness_driver_dir /
-                                    MAX_BRIGHTNESS_FILE);
-  if (!max_brightness_file.is_open()) {
-    LOG(ERROR) << "Couldn't open file with max brightness! Path: "
-               << (conf.brightness_driver_dir / MAX_BRIGHTNESS_FILE);
+  double colord_ready_ms = elapsed_ms(startup_begin);
+
+  // the profile of the previous instance is still applied, if the level
+  // didn't change since the idle exit nothing needs to be done
+  bool restored = false;
+  if (restored_state &&
+      cd_handle->adoptProfile(restored_state->profile_object_path)) {
+    restored = first_level == restored_state->level;
+    LOG_IF(restored, INFO) << "Restored state of the previous instance";
+  }
+  bool first_applied = restored;
+  std::string first_error;
+  if (restored) {
+  } else if (first_profile.has_value()) {
+    first_applied =
+        cd_handle->setIccFromData(first_profile->data, first_profile->size);
+    first_error = "colord didn't apply the first profile, retrying";
+  } else {
+    first_error = "brightness couldn't get read, waiting for a change";
+  }
+  double first_apply_ms = elapsed_ms(startup_begin);
+
+  // not ready before a profile is applied, the pipeline retries the first
+  // level and reports ready once it succeeds
+  std::stringstream status;
+  if (first_applied) {
+    status << "first profile applied after " << first_apply_ms << " ms";
+    sdNotify("READY=1\nSTATUS=" + status.str());
+  } else {
+    status << first_error;
+    sdNotify("STATUS=" + status.str());
+    LOG(WARNING) << "Initial Icc Profile not applied, " << first_error;
+  }
+  LOG(INFO) << "Startup: profile ready after " << profile_ready_ms
+            << " ms, colord ready after " << colord_ready_ms << " ms, "
+            << status.str();
+  // after the first apply, it doesn't delay it
+  if (persistent_icc_file) {
+    size_t orphaned = cd_handle->removeOrphanedProfiles();
+    LOG_IF(orphaned > 0, INFO)
+        << "Deleted " << orphaned << " profiles of earlier instances";
+  }
+
+  // a stalled colord gets cut off after the deadline, its profiles get
+  // applied once it responds again
+  std::shared_ptr<ProfileBackend> backend = cd_handle;
+  std::shared_ptr<GuardedBackend> guarded_backend;
+  if (conf.apply_timeout.count() > 0) {
+    guarded_backend =
+        std::make_shared<GuardedBackend>(cd_handle, conf.apply_timeout);
+    backend = guarded_backend;
+  }
+  auto applier = std::make_shared<ProfileApplier>(backend, atlas);
+  auto targets = std::make_shared<BrightnessTargets>();
+  auto prefetcher =
+      std::make_shared<ProfilePrefetcher>(applier, conf.prefetch_depth);
+  if (conf.prefetch_depth > 0) {
+    prefetcher->start();
+  }
+  std::shared_ptr<ProfilePipeline> pipeline;
+  try {
+    pipeline = std::make_shared<ProfilePipeline>(applier, targets, prefetcher);
+  } catch (std::exception &e) {
+    LOG(ERROR) << "Exception in creation of ProfilePipeline! Exception:"
+               << e.what();
     return -1;
   }
-  char max_brightness[sizeof(UINT_MAX)];
-  max_brightness_file.read(max_brightness, sizeof(max_brightness));
+  // the first display always follows the backlight
+  std::vector<uint> fan_out_displays = {0};
+  if (conf.fan_out_displays && conf.fan_out_displays->empty()) {
+    for (uint display = 1; display < cd_handle->displayDeviceCount();
+         display++) {
+      fan_out_displays.push_back(display);
+    }
+  } else if (conf.fan_out_displays) {
+    for (uint display : conf.fan_out_displays.value()) {
+      if (display != 0) {
+        fan_out_displays.push_back(display);
+      }
+    }
+  }
+  DisplayFanOut fan_out(fan_out_displays, conf.display_scales);
+
+  // on battery fewer and coarser profiles get generated and applied
+  std::shared_ptr<PowerPolicy> power_policy;
+  std::shared_ptr<BrightnessEventSource> power_source;
+  if (conf.power_policy) {
+    UpdatePolicy ac = AC_UPDATE_POLICY;
+    UpdatePolicy battery = BATTERY_UPDATE_POLICY;
+    ac.prefetch_depth = conf.prefetch_depth;
+    battery.prefetch_depth =
+        std::min(battery.prefetch_depth, conf.prefetch_depth);
+    power_policy = std::make_shared<PowerPolicy>(ac, battery);
+    if (conf.power_policy == "auto") {
+      try {
+        power_source = std::make_shared<PowerSupplyEventSource>();
+        power_source->start();
+        power_policy->setOnBattery(power_source->readFile() == "0\n");
+      } catch (std::exception &e) {
+        LOG(WARNING) << "Power supply couldn't get watched! Exception:"
+                     << e.what();
+      }
+    } else {
+      power_policy->setOnBattery(conf.power_policy == "battery");
+    }
+    power_policy->setApplyCallback(
+        [pipeline, prefetcher](const UpdatePolicy &policy) {
+          pipeline->setMinInterval(policy.min_interval);
+          pipeline->setLevelStep(policy.level_step);
+          prefetcher->setDepth(policy.prefetch_depth);
+        });
+  }
+  auto ready = std::make_shared<std::atomic_bool>(first_applied);
+  pipeline->setAppliedCallback([power_policy, ready](
+                                   const BrightnessTarget &target,
+                                   bool applied) {
+    if (!applied) {
+      return;
+    }
+    if (power_policy) {
+      power_policy->countUpdate();
+    }
+    if (!ready->exchange(true)) {
+      sdNotify("READY=1\nSTATUS=first profile applied by the pipeline");
+      LOG(INFO) << "First profile applied by the pipeline";
+    }
+  });
+  if (backlight_level) {
+    std::map<uint, uint32_t> first_levels =
+        fan_out.levels(backlight_level.value());
+    // the other displays get applied by the pipeline, the first one too if
+    // colord didn't apply it
+    if (first_applied) {
+      targets->setCurrent(0, first_levels[0]);
+      first_levels.erase(0);
+    }
+    targets->postBatch(first_levels);
+  }
+
+  // the control socket is optional, e.g. for displays without a backlight
+  std::unique_ptr<ControlSocket> control_socket;
+  if (std::optional<std::filesystem::path> socket_path =
+          ControlSocket::defaultPath()) {
+    try {
+      control_socket =
+          std::make_unique<ControlSocket>(socket_path.value(), targets);
+      control_socket->addStatsProvider(
+          [prefetcher]() { return prefetcher->statsString(); });
+      control_socket->addStatsProvider(
+          [pipeline]() { return pipeline->statsString(); });
+      if (guarded_backend) {
+        control_socket->addStatsProvider([guarded_backend]() {
+          return "colord " + guarded_backend->statsString();
+        });
+      }
+      if (power_policy) {
+        control_socket->addStatsProvider(
+            [power_policy]() { return power_policy->statsString(); });
+      }
+      control_socket->start();
+    } catch (std::exception &e) {
+      LOG(WARNING) << "Control socket couldn't get created! Exception:"
+                   << e.what();
+    }
+  }
+  std::shared_ptr<TraceRecorder> recorder;
+  if (conf.record_file) {
+    try {
+      recorder = std::make_shared<TraceRecorder>(conf.record_file.value());
+    } catch (std::exception &e) {
+      LOG(ERROR) << "Exception in creation of TraceRecorder! Exception:"
+                 << e.what();
+      return -1;
+    }
+  }
+  std::thread backlight_forwarder(&forwardBacklightChanges, source, targets,
+                                  recorder, fan_out, max_brightness.value());
+  // the ambient light reports levels, the latest change of both wins
+  std::shared_ptr<BrightnessEventSource> ambient_source;
+  std::thread ambient_forwarder;
+  if (conf.ambient_light) {
+    std::optional<std::filesystem::path> sensor =
+        conf.ambient_light->empty() ? AmbientLightEventSource::find()
+                                    : conf.ambient_light;
+    try {
+      if (!sensor) {
+        throw std::runtime_error("no iio device with an illuminance");
+      }
+      ambient_source =
+          std::make_shared<AmbientLightEventSource>(sensor.value());
+      if (!ambient_source->start()) {
+        throw std::runtime_error("the sensor couldn't get read");
+      }
+      // not recorded, a replay would post the levels as backlight changes
+      ambient_forwarder =
+          std::thread(&forwardBacklightChanges, ambient_source, targets,
+                      nullptr, fan_out, BRIGHTNESS_LEVEL_SCALE);
+    } catch (std::exception &e) {
+      LOG(WARNING) << "Ambient light sensor couldn't get used! Exception:"
+                   << e.what();
+    }
+  }
+
+  std::thread power_forwarder;
+  if (power_source) {
+    power_forwarder =
+        std::thread(&forwardPowerChanges, power_source, power_policy);
+  }
 
-  startWatchAndApplyBrightness(cd_handle, fw, std::stod(max_brightness));
+  // only returns on an idle exit
+  uint32_t last_level =
+      pipeline->run(first_level.value_or(BRIGHTNESS_LEVEL_SCALE),
+                    conf.idle_exit);
+  LOG(INFO) << "Pipeline stats: " << pipeline->statsString();
+  LOG_IF(power_policy, INFO) << "Power policy stats: "
+                             << power_policy->statsString();
+  LOG_IF(guarded_backend, INFO) << "Colord stats: "
+                                << guarded_backend->statsString();
+  targets->close();
+  control_socket.reset();
+  prefetcher->stop();
+  source->stop();
+  backlight_forwarder.join();
+  if (ambient_forwarder.joinable()) {
+    ambient_source->stop();
+    ambient_forwarder.join();
+  }
+  if (power_forwarder.joinable()) {
+    power_source->stop();
+    power_forwarder.join();
+  }
+
+  if (conf.idle_exit) {
+    sdNotify("STOPPING=1");
+    LOG(INFO) << "No brightness change for " << conf.idle_exit->count()
+              << " s, exiting";
+    DaemonState state = {last_level,
+                         cd_handle->currentProfilePath().value_or("")};
+    LOG_IF(!save_daemon_state(state_path.value(), state), ERROR)
+        << "Couldn't save the state before the idle exit!";
+  }
+  return 0;
 }
@@ -0,0 +1,304 @@
+#include "colord_brightness.h"
+#include "BrightnessTargets.h"
+#include "ColordHandler.h"
+#include "ProfileApplier.h"
+#include "ProfileAtlas.h"
+#include "ProfileBackend.h"
+#include "ProfileGenerator.h"
+#include "ProfilePipeline.h"
+#include "ProfilePrefetcher.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <easylogging++.h>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_ICC_NAME "colord_brightness_lib.icc"
+
+static_assert(COLORD_BRIGHTNESS_LEVEL_SCALE == BRIGHTNESS_LEVEL_SCALE,
+              "the level scale is part of the C API");
+
+/*! \class CallbackBackend
+ *  \brief backend of colord_brightness_new_with_backend()
+ */
+class CallbackBackend : public ProfileBackend {
+public:
+  CallbackBackend(colord_brightness_apply_func apply, void *user_data)
+      : _apply(apply), _user_data(user_data) {}
+
+  bool setIccFromData(const uint8_t *data, size_t size,
+                      uint display_device_id = 0) override {
+    return _apply(data, size, display_device_id, _user_data) == 0;
+  }
+
+protected:
+  colord_brightness_apply_func _apply;
+  void *_user_data;
+};
+
+/*! \struct AppliedLevel
+ *  \brief results of the applied targets of a display
+ */
+struct AppliedLevel {
+  uint32_t level; /*!< of the last target */
+  uint64_t seq;   /*!< of the last target, see BrightnessTargets::postedSeq */
+  bool applied;   /*!< false if the backend failed on the last target */
+  std::optional<uint32_t> last_applied;
+};
+
+struct colord_brightness {
+  std::shared_ptr<ColordHandler> colord; /*!< nullptr with an own backend */
+  std::shared_ptr<BrightnessTargets> targets;
+  std::shared_ptr<ProfilePrefetcher> prefetcher;
+  std::shared_ptr<ProfilePipeline> pipeline;
+  std::thread pipeline_thread;
+  std::map<uint, AppliedLevel> applied;
+  std::mutex applied_mut;
+  std::condition_variable applied_cv;
+};
+
+// -----------------Helper  functions----------------
+
+/*! \brief the atlas of the user, locked while the daemon runs, so the
+ * library falls back to one in memory
+ */
+std::shared_ptr<ProfileAtlas> open_atlas() {
+  if (std::optional<std::filesystem::path> atlas_path =
+          ProfileAtlas::defaultPath()) {
+    try {
+      return std::make_shared<ProfileAtlas>(atlas_path.value());
+    } catch (std::exception &e) {
+      LOG(DEBUG) << "Profile atlas couldn't get opened! Exception:"
+                 << e.what();
+    }
+  }
+  try {
+    return ProfileAtlas::inMemory();
+  } catch (std::exception &e) {
+    LOG(WARNING) << "In-memory profile atlas couldn't get created! "
+                    "Exception:"
+                 << e.what();
+  }
+  return nullptr;
+}
+
+colord_brightness_status
+start_pipeline(std::unique_ptr<colord_brightness> handle,
+               std::shared_ptr<ProfileBackend> backend,
+               colord_brightness **out) {
+  auto applier = std::make_shared<ProfileApplier>(backend, open_atlas());
+  handle->targets = std::make_shared<BrightnessTargets>();
+  handle->prefetcher =
+      std::make_shared<ProfilePrefetcher>(applier, DEFAULT_PREFETCH_DEPTH);
+  try {
+    handle->pipeline = std::make_shared<ProfilePipeline>(
+        applier, handle->targets, handle->prefetcher);
+  } catch (std::system_error &e) {
+    LOG(ERROR) << "Exception in creation of ProfilePipeline! Exception:"
+               << e.what();
+    errno = e.code().value();
+    return COLORD_BRIGHTNESS_ERROR_SYSTEM;
+  }
+  colord_brightness *raw = handle.get();
+  handle->pipeline->setAppliedCallback(
+      [raw](const BrightnessTarget &target, bool applied) {
+        {
+          std::lock_guard<std::mutex> lk(raw->applied_mut);
+          AppliedLevel &result = raw->applied[target.display_device_id];
+          result.level = target.level;
+          result.seq = target.seq;
+          result.applied = applied;
+          if (applied) {
+            result.last_applied = target.level;
+          }
+        }
+        raw->applied_cv.notify_all();
+      });
+  handle->prefetcher->start();
+  handle->pipeline_thread =
+      std::thread([raw]() { raw->pipeline->run(BRIGHTNESS_LEVEL_SCALE); });
+  *out = handle.release();
+  return COLORD_BRIGHTNESS_OK;
+}
+
+void init_logging() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    // the library logs into its own, hidden storage (see CMakeLists.txt),
+    // only warnings and errors
+    el::Loggers::setLoggingLevel(el::Level::Warning);
+  });
+}
+
+// -------------------------------------
+
+unsigned colord_brightness_api_version(void) {
+  return COLORD_BRIGHTNESS_API_VERSION;
+}
+
+const char *colord_brightness_status_string(colord_brightness_status status) {
+  switch (status) {
+  case COLORD_BRIGHTNESS_OK:
+    return "success";
+  case COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT:
+    return "invalid argument";
+  case COLORD_BRIGHTNESS_ERROR_NO_COLORD:
+    return "colord is not running";
+  case COLORD_BRIGHTNESS_ERROR_SYSTEM:
+    return "system error";
+  case COLORD_BRIGHTNESS_ERROR_GENERATE:
+    return "profile couldn't get generated";
+  case COLORD_BRIGHTNESS_ERROR_BUFFER_TOO_SMALL:
+    return "buffer too small";
+  case COLORD_BRIGHTNESS_ERROR_TIMEOUT:
+    return "timeout";
+  case COLORD_BRIGHTNESS_ERROR_NOT_APPLIED:
+    return "profile couldn't get applied";
+  }
+  return "unknown status";
+}
+
+uint32_t colord_brightness_level(double brightness) {
+  return quantize_brightness(std::clamp(brightness, 0.0, 1.0));
+}
+
+colord_brightness_status colord_brightness_generate(uint32_t level,
+                                                    uint8_t *data,
+                                                    size_t size,
+                                                    size_t *written) {
+  if (level > BRIGHTNESS_LEVEL_SCALE || written == nullptr) {
+    return COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT;
+  }
+  init_logging();
+  std::vector<uint8_t> profile =
+      generate_srgb_profile_data(level_to_brightness(level));
+  if (profile.empty()) {
+    return COLORD_BRIGHTNESS_ERROR_GENERATE;
+  }
+  *written = profile.size();
+  if (data == nullptr || size < profile.size()) {
+    return COLORD_BRIGHTNESS_ERROR_BUFFER_TOO_SMALL;
+  }
+  std::memcpy(data, profile.data(), profile.size());
+  return COLORD_BRIGHTNESS_OK;
+}
+
+colord_brightness_status colord_brightness_new(const char *icc_name,
+                                               colord_brightness **handle) {
+  if (handle == nullptr) {
+    return COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT;
+  }
+  init_logging();
+  auto created = std::make_unique<colord_brightness>();
+  try {
+    created->colord = std::make_shared<ColordHandler>(
+        icc_name != nullptr ? icc_name : DEFAULT_ICC_NAME);
+  } catch (std::system_error &e) {
+    LOG(ERROR) << "Exception in creation of ColordHandler! Exception:"
+               << e.what();
+    errno = e.code().value();
+    return COLORD_BRIGHTNESS_ERROR_SYSTEM;
+  } catch (std::exception &e) {
+    LOG(ERROR) << "Exception in creation of ColordHandler! Exception:"
+               << e.what();
+    return COLORD_BRIGHTNESS_ERROR_NO_COLORD;
+  }
+  LOG_IF(!created->colord->discoverDisplayDevices(), WARNING)
+      << "Couldn't discover the display devices!";
+  std::shared_ptr<ProfileBackend> backend = created->colord;
+  return start_pipeline(std::move(created), backend, handle);
+}
+
+colord_brightness_status
+colord_brightness_new_with_backend(colord_brightness_apply_func apply,
+                                   void *user_data,
+                                   colord_brightness **handle) {
+  if (apply == nullptr || handle == nullptr) {
+    return COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT;
+  }
+  init_logging();
+  return start_pipeline(std::make_unique<colord_brightness>(),
+                        std::make_shared<CallbackBackend>(apply, user_data),
+                        handle);
+}
+
+void colord_brightness_free(colord_brightness *handle) {
+  if (handle == nullptr) {
+    return;
+  }
+  handle->targets->close();
+  handle->pipeline_thread.join();
+  handle->prefetcher->stop();
+  delete handle;
+}
+
+unsigned colord_brightness_display_count(colord_brightness *handle) {
+  if (handle == nullptr || !handle->colord) {
+    return 0;
+  }
+  return handle->colord->displayDeviceCount();
+}
+
+colord_brightness_status colord_brightness_set_level(colord_brightness *handle,
+                                                     unsigned display,
+                                                     uint32_t level) {
+  if (handle == nullptr || display >= PIPELINE_MAX_DISPLAYS ||
+      level > BRIGHTNESS_LEVEL_SCALE) {
+    return COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT;
+  }
+  handle->targets->post(display, level);
+  return COLORD_BRIGHTNESS_OK;
+}
+
+colord_brightness_status
+colord_brightness_wait_applied(colord_brightness *handle, unsigned display,
+                               int timeout_ms) {
+  if (handle == nullptr || display >= PIPELINE_MAX_DISPLAYS) {
+    return COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT;
+  }
+  // the level can't tell, it gets rounded and may repeat an older one
+  uint64_t requested = handle->targets->postedSeq(display);
+  if (requested == 0) {
+    return COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT;
+  }
+  std::unique_lock<std::mutex> lk(handle->applied_mut);
+  auto reached = [&]() {
+    auto it = handle->applied.find(display);
+    return it != handle->applied.end() && it->second.seq >= requested;
+  };
+  if (timeout_ms < 0) {
+    handle->applied_cv.wait(lk, reached);
+  } else if (!handle->applied_cv.wait_for(
+                 lk, std::chrono::milliseconds(timeout_ms), reached)) {
+    return COLORD_BRIGHTNESS_ERROR_TIMEOUT;
+  }
+  return handle->applied[display].applied
+             ? COLORD_BRIGHTNESS_OK
+             : COLORD_BRIGHTNESS_ERROR_NOT_APPLIED;
+}
+
+colord_brightness_status
+colord_brightness_applied_level(colord_brightness *handle, unsigned display,
+                                uint32_t *level) {
+  if (handle == nullptr || level == nullptr) {
+    return COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT;
+  }
+  std::lock_guard<std::mutex> lk(handle->applied_mut);
+  auto it = handle->applied.find(display);
+  if (it == handle->applied.end() || !it->second.last_applied) {
+    return COLORD_BRIGHTNESS_ERROR_NOT_APPLIED;
+  }
+  *level = it->second.last_applied.value();
+  return COLORD_BRIGHTNESS_OK;
+}
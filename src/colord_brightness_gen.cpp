@@ -0,0 +1,186 @@
+#include "ProfileAtlas.h"
+#include "ProfileGenerator.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <easylogging++.h>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+INITIALIZE_EASYLOGGINGPP
+
+struct GenConfig {
+  uint32_t from; /*!< first level */
+  uint32_t to;   /*!< last level, inclusive */
+  uint32_t step;
+  uint jobs;                       /*!< generating threads */
+  std::filesystem::path out_dir;   /*!< one icc file per level */
+  std::filesystem::path atlas_file; /*!< all levels packed in one atlas */
+};
+
+void print_usage() {
+  std::cerr << "Usage: colord-brightness-gen (--out-dir <dir> | --atlas "
+               "<file>) [--from <level>] [--to <level>] [--step <levels>] "
+               "[--jobs <n>]"
+            << std::endl
+            << "levels are the brightness in permille" << std::endl;
+}
+
+bool parse_gen_args(int argc, char *argv[], GenConfig &conf) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--", 0) != 0) {
+      return false;
+    }
+    if (arg != "--out-dir" && arg != "--atlas" && arg != "--from" &&
+        arg != "--to" && arg != "--step" && arg != "--jobs") {
+      continue; // left to easylogging++, e.g. --v=2
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--out-dir") {
+      conf.out_dir = value;
+      continue;
+    }
+    if (arg == "--atlas") {
+      conf.atlas_file = value;
+      continue;
+    }
+    long number;
+    try {
+      number = std::stol(value);
+    } catch (std::exception &e) {
+      return false;
+    }
+    if (number < 0 || number > BRIGHTNESS_LEVEL_SCALE ||
+        ((arg == "--step" || arg == "--jobs") && number == 0)) {
+      return false;
+    }
+    if (arg == "--from") {
+      conf.from = number;
+    } else if (arg == "--to") {
+      conf.to = number;
+    } else if (arg == "--step") {
+      conf.step = number;
+    } else {
+      conf.jobs = number;
+    }
+  }
+  // exactly one output
+  return conf.out_dir.empty() != conf.atlas_file.empty() &&
+         conf.from <= conf.to;
+}
+
+std::filesystem::path profile_file_name(uint32_t level) {
+  std::stringstream ss;
+  ss << "colord_brightness_" << std::setw(4) << std::setfill('0') << level
+     << ".icc";
+  return ss.str();
+}
+
+bool write_profile(std::filesystem::path file,
+                   const std::vector<uint8_t> &data) {
+  std::ofstream out(file, std::ios::out | std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(data.data()), data.size());
+  out.close();
+  LOG_IF(!out, ERROR) << "Couldn't write the profile " << file;
+  return static_cast<bool>(out);
+}
+
+int main(int argc, char *argv[]) {
+  START_EASYLOGGINGPP(argc, argv);
+  el::Loggers::setLoggingLevel(el::Level::Warning);
+
+  GenConfig conf = {0,  BRIGHTNESS_LEVEL_SCALE,
+                    1,  std::max(std::thread::hardware_concurrency(), 1u),
+                    "", ""};
+  if (!parse_gen_args(argc, argv, conf)) {
+    print_usage();
+    return -1;
+  }
+
+  std::vector<uint32_t> levels;
+  for (uint32_t level = conf.from; level <= conf.to; level += conf.step) {
+    levels.push_back(level);
+  }
+
+  std::unique_ptr<ProfileAtlas> atlas;
+  if (!conf.out_dir.empty()) {
+    std::error_code ec;
+    std::filesystem::create_directories(conf.out_dir, ec);
+  } else {
+    try {
+      // a new atlas, not merged with the profiles of an older one
+      std::filesystem::remove(conf.atlas_file);
+      atlas = std::make_unique<ProfileAtlas>(conf.atlas_file);
+    } catch (std::exception &e) {
+      std::cerr << "Profile atlas couldn't get created! Exception:"
+                << e.what() << std::endl;
+      return -1;
+    }
+  }
+
+  // every profile gets generated in its own lcms2 context, the workers
+  // share only the index of the next level
+  std::atomic<size_t> next = 0;
+  std::atomic<size_t> failed = 0;
+  std::vector<std::vector<uint8_t>> packed(atlas ? levels.size() : 0);
+  auto worker = [&]() {
+    size_t i;
+    while ((i = next.fetch_add(1)) < levels.size()) {
+      std::vector<uint8_t> data =
+          generate_srgb_profile_data(level_to_brightness(levels[i]));
+      if (data.empty()) {
+        failed++;
+      } else if (atlas) {
+        packed[i] = std::move(data);
+      } else if (!write_profile(conf.out_dir / profile_file_name(levels[i]),
+                                data)) {
+        failed++;
+      }
+    }
+  };
+
+  auto begin = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (uint job = 0; job < std::min<size_t>(conf.jobs, levels.size());
+       job++) {
+    workers.emplace_back(worker);
+  }
+  for (std::thread &thread : workers) {
+    thread.join();
+  }
+  // in level order, so the same range always packs the same atlas
+  for (size_t i = 0; i < packed.size(); i++) {
+    if (!packed[i].empty() &&
+        !atlas->insert(SRGB_BASE_PROFILE_ID, levels[i], packed[i].data(),
+                       packed[i].size())) {
+      failed++;
+    }
+  }
+  double elapsed_s = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - begin)
+                         .count();
+
+  size_t generated = levels.size() - failed;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "generated: " << generated << " failed: " << failed
+            << std::endl;
+  std::cout << "jobs: " << workers.size() << " time: " << elapsed_s * 1000.0
+            << " ms" << std::endl;
+  std::cout << "throughput: "
+            << (elapsed_s > 0 ? generated / elapsed_s : 0.0)
+            << " profiles/s" << std::endl;
+  return failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,197 @@
+#include "BrightnessTargets.h"
+#include "BrightnessTrace.h"
+#include "ColordHandler.h"
+#include "ProfileApplier.h"
+#include "ProfileBackend.h"
+#include "ProfileGenerator.h"
+#include "ProfilePipeline.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <easylogging++.h>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+INITIALIZE_EASYLOGGINGPP
+
+/*! \class NullBackend
+ *  \brief discards the profiles, measures only the generation
+ */
+class NullBackend : public ProfileBackend {
+public:
+  bool setIccFromData(const uint8_t *data, size_t size,
+                      uint display_device_id = 0) override {
+    return size > 0;
+  }
+};
+
+struct ReplayConfig {
+  std::filesystem::path trace_file;
+  double speed;        /*!< 1 is the original speed, 0 as fast as possible */
+  std::string backend; /*!< "colord" or "null" */
+};
+
+void print_usage() {
+  std::cerr << "Usage: colord-brightness-replay <trace> [--speed <factor>] "
+               "[--backend colord|null]"
+            << std::endl;
+}
+
+bool parse_replay_args(int argc, char *argv[], ReplayConfig &conf) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--speed" && i + 1 < argc) {
+      try {
+        conf.speed = std::stod(argv[++i]);
+      } catch (std::exception &e) {
+        return false;
+      }
+      if (conf.speed < 0) {
+        return false;
+      }
+    } else if (arg == "--backend" && i + 1 < argc) {
+      conf.backend = argv[++i];
+      if (conf.backend != "colord" && conf.backend != "null") {
+        return false;
+      }
+    } else if (arg.rfind("--", 0) == 0) {
+      continue; // left to easylogging++, e.g. --v=2
+    } else if (conf.trace_file.empty()) {
+      conf.trace_file = arg;
+    } else {
+      return false;
+    }
+  }
+  return !conf.trace_file.empty();
+}
+
+double percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  size_t index = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int main(int argc, char *argv[]) {
+  START_EASYLOGGINGPP(argc, argv);
+  el::Loggers::setLoggingLevel(el::Level::Warning);
+
+  ReplayConfig conf = {"", 1.0, "null"};
+  if (!parse_replay_args(argc, argv, conf)) {
+    print_usage();
+    return -1;
+  }
+
+  std::vector<TraceEvent> events;
+  try {
+    events = read_trace(conf.trace_file);
+  } catch (std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
+
+  std::shared_ptr<ProfileBackend> backend;
+  if (conf.backend == "colord") {
+    try {
+      auto handle =
+          std::make_shared<ColordHandler>("colord_brightness_replay.icc");
+      handle->discoverDisplayDevices();
+      backend = handle;
+    } catch (std::exception &e) {
+      std::cerr << "Exception in creation of ColordHandler! Exception:"
+                << e.what() << std::endl;
+      return -1;
+    }
+  } else {
+    backend = std::make_shared<NullBackend>();
+  }
+
+  // no atlas, every profile gets generated like on a cold start
+  auto applier = std::make_shared<ProfileApplier>(backend, nullptr);
+  auto targets = std::make_shared<BrightnessTargets>();
+  ProfilePipeline pipeline(applier, targets);
+
+  // end-to-end latency from posting a target until it is applied
+  std::mutex mut;
+  std::condition_variable cv;
+  std::vector<double> latencies_ms;
+  size_t failed = 0;
+  std::map<uint, std::chrono::steady_clock::time_point> last_posted;
+  std::map<uint, std::chrono::steady_clock::time_point> last_applied;
+  pipeline.setAppliedCallback([&](const BrightnessTarget &target,
+                                  bool applied) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lk(mut);
+    if (applied) {
+      latencies_ms.push_back(
+          std::chrono::duration<double, std::milli>(now - target.issued)
+              .count());
+    } else {
+      failed++;
+    }
+    last_applied[target.display_device_id] = target.issued;
+    cv.notify_all();
+  });
+
+  std::thread pipeline_thread(
+      [&]() { pipeline.run(BRIGHTNESS_LEVEL_SCALE); });
+  auto begin = std::chrono::steady_clock::now();
+  for (const TraceEvent &event : events) {
+    if (conf.speed > 0) {
+      std::this_thread::sleep_until(
+          begin + std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      event.offset / conf.speed));
+    }
+    if (event.display_device_id >= PIPELINE_MAX_DISPLAYS) {
+      continue;
+    }
+    // taken before posting, the target is issued at or after this time
+    auto posted = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> lk(mut);
+      last_posted[event.display_device_id] = posted;
+    }
+    targets->post(event.display_device_id, event.level);
+  }
+
+  // the last target of every display gets applied, it can't be replaced
+  {
+    std::unique_lock<std::mutex> lk(mut);
+    cv.wait(lk, [&]() {
+      for (auto [display, posted] : last_posted) {
+        if (last_applied[display] < posted) {
+          return false;
+        }
+      }
+      return true;
+    });
+  }
+  double replay_ms = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - begin)
+                         .count();
+  targets->close();
+  pipeline_thread.join();
+
+  std::sort(latencies_ms.begin(), latencies_ms.end());
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "events: " << events.size() << std::endl;
+  std::cout << "coalesced: " << targets->coalesced() << std::endl;
+  std::cout << "applied: " << latencies_ms.size() << " failed: " << failed
+            << std::endl;
+  std::cout << "replay: " << replay_ms << " ms" << std::endl;
+  std::cout << "latency ms p50: " << percentile(latencies_ms, 50)
+            << " p90: " << percentile(latencies_ms, 90)
+            << " p99: " << percentile(latencies_ms, 99) << " max: "
+            << (latencies_ms.empty() ? 0.0 : latencies_ms.back()) << std::endl;
+  std::cout << pipeline.statsString() << std::endl;
+  return 0;
+}
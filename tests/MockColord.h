@@ -0,0 +1,467 @@
+#ifndef MOCKCOLORD_H
+
+#define MOCKCOLORD_H
+
+#include "GHandles.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <colord.h>
+#include <cstdint>
+#include <fcntl.h>
+#include <gio/gunixfdlist.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define MOCK_DEVICE_PATH "/org/freedesktop/ColorManager/devices/mock_"
+#define MOCK_PROFILE_PATH "/org/freedesktop/ColorManager/profiles/mock_"
+#define MOCK_DEVICE_INTERFACE "org.freedesktop.ColorManager.Device"
+#define MOCK_PROFILE_INTERFACE "org.freedesktop.ColorManager.Profile"
+#define MOCK_ERROR_NOT_FOUND "org.freedesktop.ColorManager.NotFound"
+#define MOCK_ERROR_ALREADY_EXISTS "org.freedesktop.ColorManager.AlreadyExists"
+#define MOCK_ERROR_FAILED "org.freedesktop.ColorManager.Failed"
+#define MOCK_ERROR_NOT_ADDED                                                  \
+  "org.freedesktop.ColorManager.Device.ProfileDoesNotExist"
+#define MOCK_ERROR_ALREADY_ADDED                                              \
+  "org.freedesktop.ColorManager.Device.ProfileAlreadyAdded"
+
+static const char mock_colord_introspection[] =
+    "<node>"
+    "  <interface name='org.freedesktop.ColorManager'>"
+    "    <method name='GetDevicesByKind'>"
+    "      <arg type='s' name='kind' direction='in'/>"
+    "      <arg type='ao' name='devices' direction='out'/>"
+    "    </method>"
+    "    <method name='GetProfiles'>"
+    "      <arg type='ao' name='profiles' direction='out'/>"
+    "    </method>"
+    "    <method name='FindProfileById'>"
+    "      <arg type='s' name='id' direction='in'/>"
+    "      <arg type='o' name='object_path' direction='out'/>"
+    "    </method>"
+    "    <method name='CreateProfileWithFd'>"
+    "      <arg type='s' name='profile_id' direction='in'/>"
+    "      <arg type='s' name='scope' direction='in'/>"
+    "      <arg type='h' name='handle' direction='in'/>"
+    "      <arg type='a{ss}' name='properties' direction='in'/>"
+    "      <arg type='o' name='object_path' direction='out'/>"
+    "    </method>"
+    "    <method name='CreateProfile'>"
+    "      <arg type='s' name='profile_id' direction='in'/>"
+    "      <arg type='s' name='scope' direction='in'/>"
+    "      <arg type='a{ss}' name='properties' direction='in'/>"
+    "      <arg type='o' name='object_path' direction='out'/>"
+    "    </method>"
+    "    <method name='DeleteProfile'>"
+    "      <arg type='o' name='object_path' direction='in'/>"
+    "    </method>"
+    "    <property type='s' name='DaemonVersion' access='read'/>"
+    "  </interface>"
+    "  <interface name='org.freedesktop.ColorManager.Device'>"
+    "    <method name='AddProfile'>"
+    "      <arg type='s' name='relation' direction='in'/>"
+    "      <arg type='o' name='object_path' direction='in'/>"
+    "    </method>"
+    "    <method name='RemoveProfile'>"
+    "      <arg type='o' name='object_path' direction='in'/>"
+    "    </method>"
+    "    <method name='MakeProfileDefault'>"
+    "      <arg type='o' name='object_path' direction='in'/>"
+    "    </method>"
+    "    <property type='s' name='Id' access='read'/>"
+    "    <property type='s' name='Kind' access='read'/>"
+    "    <property type='ao' name='Profiles' access='read'/>"
+    "  </interface>"
+    "  <interface name='org.freedesktop.ColorManager.Profile'>"
+    "    <property type='s' name='Id' access='read'/>"
+    "    <property type='s' name='Filename' access='read'/>"
+    "    <property type='s' name='Scope' access='read'/>"
+    "  </interface>"
+    "</node>";
+
+/*! \struct MockCall
+ *  \brief what the mock colord got to create a profile
+ */
+struct MockCall {
+  std::string profile_id;
+  std::string scope;
+  std::string filename;
+  bool with_fd = false;
+  int seals = 0;
+  std::vector<uint8_t> content;
+  bool write_refused = false;
+  bool truncate_refused = false;
+};
+
+/*! \class MockColord
+ *  \brief ColorManager with display devices and profiles on a private bus,
+ * checks the passed fd like colord would read it
+ */
+class MockColord {
+public:
+  MockColord(const std::string &address, size_t displays = 1)
+      : _address(address), _stop(false), _devices(displays) {
+    std::atomic_bool ready = false;
+    _thread = std::thread(&MockColord::serve, this, std::ref(ready));
+    while (!ready) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  MockCall lastCall() {
+    std::lock_guard<std::mutex> lk(_mut);
+    return _last_call;
+  }
+
+  size_t calls() {
+    std::lock_guard<std::mutex> lk(_mut);
+    return _calls;
+  }
+
+  /*! \brief number of GetDevicesByKind calls */
+  size_t deviceQueries() {
+    std::lock_guard<std::mutex> lk(_mut);
+    return _device_queries;
+  }
+
+  /*! \brief object paths of all profiles colord knows */
+  std::vector<std::string> profiles() {
+    std::lock_guard<std::mutex> lk(_mut);
+    std::vector<std::string> object_paths;
+    for (const auto &[object_path, profile] : _profiles) {
+      object_paths.push_back(object_path);
+    }
+    return object_paths;
+  }
+
+  /*! \brief the profile created for the object path */
+  MockCall profile(const std::string &object_path) {
+    std::lock_guard<std::mutex> lk(_mut);
+    auto it = _profiles.find(object_path);
+    return it == _profiles.end() ? MockCall() : it->second.call;
+  }
+
+  /*! \brief profiles added to the display, the default first */
+  std::vector<std::string> deviceProfiles(size_t display) {
+    std::lock_guard<std::mutex> lk(_mut);
+    return _devices.at(display);
+  }
+
+  /*! \brief the next FindProfileById calls find nothing, like while another
+   * client creates the profile
+   */
+  void failNextFinds(size_t count) {
+    std::lock_guard<std::mutex> lk(_mut);
+    _failing_finds = count;
+  }
+
+  /*! \brief the next RemoveProfile calls fail */
+  void failNextRemoves(size_t count) {
+    std::lock_guard<std::mutex> lk(_mut);
+    _failing_removes = count;
+  }
+
+  ~MockColord() {
+    _stop = true;
+    g_main_context_wakeup(_context);
+    _thread.join();
+  }
+
+protected:
+  struct MockProfile {
+    MockCall call;
+    guint registration;
+  };
+
+  static std::string devicePath(size_t display) {
+    return MOCK_DEVICE_PATH + std::to_string(display);
+  }
+
+  static void handleMethodCall(GDBusConnection *connection,
+                               const gchar *sender, const gchar *object_path,
+                               const gchar *interface_name,
+                               const gchar *method_name, GVariant *parameters,
+                               GDBusMethodInvocation *invocation,
+                               gpointer user_data) {
+    MockColord *mock = static_cast<MockColord *>(user_data);
+    std::lock_guard<std::mutex> lk(mock->_mut);
+    std::string method = method_name;
+    if (g_strcmp0(interface_name, MOCK_DEVICE_INTERFACE) == 0) {
+      mock->handleDeviceCall(object_path, method, parameters, invocation);
+    } else if (method == "GetDevicesByKind") {
+      const gchar *kind;
+      g_variant_get(parameters, "(&s)", &kind);
+      mock->_device_queries++;
+      GVariantBuilder builder;
+      g_variant_builder_init(&builder, G_VARIANT_TYPE("ao"));
+      for (size_t i = 0; g_strcmp0(kind, "display") == 0 &&
+                         i < mock->_devices.size();
+           i++) {
+        g_variant_builder_add(&builder, "o", devicePath(i).c_str());
+      }
+      g_dbus_method_invocation_return_value(
+          invocation, g_variant_new("(ao)", &builder));
+    } else if (method == "GetProfiles") {
+      GVariantBuilder builder;
+      g_variant_builder_init(&builder, G_VARIANT_TYPE("ao"));
+      for (const auto &[path, profile] : mock->_profiles) {
+        g_variant_builder_add(&builder, "o", path.c_str());
+      }
+      g_dbus_method_invocation_return_value(
+          invocation, g_variant_new("(ao)", &builder));
+    } else if (method == "FindProfileById") {
+      const gchar *id;
+      g_variant_get(parameters, "(&s)", &id);
+      auto it = std::find_if(
+          mock->_profiles.begin(), mock->_profiles.end(),
+          [&id](const auto &profile) {
+            return profile.second.call.profile_id == id;
+          });
+      if (mock->_failing_finds > 0 || it == mock->_profiles.end()) {
+        mock->_failing_finds -= mock->_failing_finds > 0;
+        g_dbus_method_invocation_return_dbus_error(
+            invocation, MOCK_ERROR_NOT_FOUND, "profile not found");
+        return;
+      }
+      g_dbus_method_invocation_return_value(
+          invocation, g_variant_new("(o)", it->first.c_str()));
+    } else if (method == "CreateProfileWithFd" || method == "CreateProfile") {
+      mock->createProfile(connection, method == "CreateProfileWithFd",
+                          parameters, invocation);
+    } else if (method == "DeleteProfile") {
+      const gchar *path;
+      g_variant_get(parameters, "(&o)", &path);
+      auto it = mock->_profiles.find(path);
+      if (it == mock->_profiles.end()) {
+        g_dbus_method_invocation_return_dbus_error(
+            invocation, MOCK_ERROR_NOT_FOUND, "profile not found");
+        return;
+      }
+      g_dbus_connection_unregister_object(connection,
+                                          it->second.registration);
+      mock->_profiles.erase(it);
+      for (std::vector<std::string> &device : mock->_devices) {
+        device.erase(std::remove(device.begin(), device.end(), path),
+                     device.end());
+      }
+      g_dbus_method_invocation_return_value(invocation, NULL);
+    }
+  }
+
+  void handleDeviceCall(const gchar *object_path, const std::string &method,
+                        GVariant *parameters,
+                        GDBusMethodInvocation *invocation) {
+    size_t display = 0;
+    while (display < _devices.size() && devicePath(display) != object_path) {
+      display++;
+    }
+    const gchar *path;
+    if (method == "AddProfile") {
+      g_variant_get(parameters, "(&s&o)", NULL, &path);
+    } else {
+      g_variant_get(parameters, "(&o)", &path);
+    }
+    std::vector<std::string> &device = _devices.at(display);
+    auto it = std::find(device.begin(), device.end(), path);
+    if (method == "AddProfile" &&
+        (it != device.end() || !_profiles.count(path))) {
+      g_dbus_method_invocation_return_dbus_error(
+          invocation, MOCK_ERROR_ALREADY_ADDED,
+          "profile already added or unknown");
+      return;
+    }
+    if (method != "AddProfile" && it == device.end()) {
+      g_dbus_method_invocation_return_dbus_error(
+          invocation, MOCK_ERROR_NOT_ADDED, "profile not added");
+      return;
+    }
+    if (method == "RemoveProfile" && _failing_removes > 0) {
+      _failing_removes--;
+      g_dbus_method_invocation_return_dbus_error(
+          invocation, MOCK_ERROR_FAILED, "removal failed");
+      return;
+    }
+    if (method == "AddProfile") {
+      device.push_back(path);
+    } else if (method == "RemoveProfile") {
+      device.erase(it);
+    } else {
+      std::rotate(device.begin(), it, it + 1);
+    }
+    g_dbus_method_invocation_return_value(invocation, NULL);
+  }
+
+  void createProfile(GDBusConnection *connection, bool with_fd,
+                     GVariant *parameters,
+                     GDBusMethodInvocation *invocation) {
+    const gchar *profile_id;
+    const gchar *scope;
+    gint32 fd_index = -1;
+    GVariant *properties;
+    if (with_fd) {
+      g_variant_get(parameters, "(&s&sh@a{ss})", &profile_id, &scope,
+                    &fd_index, &properties);
+    } else {
+      g_variant_get(parameters, "(&s&s@a{ss})", &profile_id, &scope,
+                    &properties);
+    }
+    GVariantHandle properties_handle(properties);
+    MockCall call;
+    call.profile_id = profile_id;
+    call.scope = scope;
+    call.with_fd = with_fd;
+    const gchar *filename = NULL;
+    if (g_variant_lookup(properties, "Filename", "&s", &filename)) {
+      call.filename = filename;
+    }
+    for (const auto &[object_path, profile] : _profiles) {
+      if (profile.call.profile_id == call.profile_id) {
+        g_dbus_method_invocation_return_dbus_error(
+            invocation, MOCK_ERROR_ALREADY_EXISTS, "profile id exists");
+        return;
+      }
+    }
+
+    int fd = -1;
+    if (with_fd) {
+      GUnixFDList *fd_list = g_dbus_message_get_unix_fd_list(
+          g_dbus_method_invocation_get_message(invocation));
+      fd = fd_list ? g_unix_fd_list_get(fd_list, fd_index, NULL) : -1;
+    } else if (!call.filename.empty()) {
+      fd = open(call.filename.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+      g_dbus_method_invocation_return_error(
+          invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "no fd");
+      return;
+    }
+    call.seals = fcntl(fd, F_GET_SEALS);
+    off_t size = lseek(fd, 0, SEEK_END);
+    call.content.resize(size > 0 ? size : 0);
+    ssize_t read_size = pread(fd, call.content.data(), call.content.size(), 0);
+    if (read_size != static_cast<ssize_t>(call.content.size())) {
+      call.content.clear();
+    }
+    // the receiver can't change it either
+    uint8_t byte = 0;
+    call.write_refused = pwrite(fd, &byte, 1, 0) < 0 && errno == EPERM;
+    call.truncate_refused = ftruncate(fd, 0) != 0 && errno == EPERM;
+    close(fd);
+
+    std::string object_path = MOCK_PROFILE_PATH + std::to_string(_calls);
+    GDBusInterfaceVTable vtable = {NULL, &MockColord::getProperty, NULL,
+                                   {NULL}};
+    guint registration = g_dbus_connection_register_object(
+        connection, object_path.c_str(),
+        g_dbus_node_info_lookup_interface(_node, MOCK_PROFILE_INTERFACE),
+        &vtable, this, NULL, NULL);
+    _profiles[object_path] = {call, registration};
+    _last_call = call;
+    _calls++;
+    g_dbus_method_invocation_return_value(
+        invocation, g_variant_new("(o)", object_path.c_str()));
+  }
+
+  static GVariant *getProperty(GDBusConnection *connection,
+                               const gchar *sender, const gchar *object_path,
+                               const gchar *interface_name,
+                               const gchar *property_name, GError **error,
+                               gpointer user_data) {
+    MockColord *mock = static_cast<MockColord *>(user_data);
+    std::lock_guard<std::mutex> lk(mock->_mut);
+    std::string property = property_name;
+    if (g_strcmp0(interface_name, COLORD_DBUS_INTERFACE) == 0) {
+      return g_variant_new_string("1.4.6");
+    }
+    if (g_strcmp0(interface_name, MOCK_PROFILE_INTERFACE) == 0) {
+      const MockCall &call = mock->_profiles.at(object_path).call;
+      const std::string &value = property == "Id"      ? call.profile_id
+                                 : property == "Scope" ? call.scope
+                                                       : call.filename;
+      return g_variant_new_string(value.c_str());
+    }
+    size_t display = 0;
+    while (display < mock->_devices.size() &&
+           devicePath(display) != object_path) {
+      display++;
+    }
+    if (property == "Id") {
+      return g_variant_new_string(
+          ("xrandr-mock-" + std::to_string(display)).c_str());
+    }
+    if (property == "Kind") {
+      return g_variant_new_string("display");
+    }
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("ao"));
+    for (const std::string &path : mock->_devices.at(display)) {
+      g_variant_builder_add(&builder, "o", path.c_str());
+    }
+    return g_variant_builder_end(&builder);
+  }
+
+  void serve(std::atomic_bool &ready) {
+    _context = g_main_context_new();
+    g_main_context_push_thread_default(_context);
+    GErrorHandle error;
+    GDBusConnectionHandle connection(g_dbus_connection_new_for_address_sync(
+        _address.c_str(),
+        static_cast<GDBusConnectionFlags>(
+            G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+            G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        NULL, NULL, error.out()));
+    assert(connection);
+    _node = g_dbus_node_info_new_for_xml(mock_colord_introspection, NULL);
+    assert(_node);
+    GDBusInterfaceVTable vtable = {&MockColord::handleMethodCall,
+                                   &MockColord::getProperty, NULL, {NULL}};
+    guint registration = g_dbus_connection_register_object(
+        connection.get(), COLORD_DBUS_PATH,
+        g_dbus_node_info_lookup_interface(_node, COLORD_DBUS_INTERFACE),
+        &vtable, this, NULL, NULL);
+    assert(registration > 0);
+    for (size_t i = 0; i < _devices.size(); i++) {
+      registration = g_dbus_connection_register_object(
+          connection.get(), devicePath(i).c_str(),
+          g_dbus_node_info_lookup_interface(_node, MOCK_DEVICE_INTERFACE),
+          &vtable, this, NULL, NULL);
+      assert(registration > 0);
+    }
+    GVariantHandle reply(g_dbus_connection_call_sync(
+        connection.get(), "org.freedesktop.DBus", "/org/freedesktop/DBus",
+        "org.freedesktop.DBus", "RequestName",
+        g_variant_new("(su)", COLORD_DBUS_SERVICE, 0), G_VARIANT_TYPE("(u)"),
+        G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL));
+    assert(reply);
+    ready = true;
+    while (!_stop) {
+      g_main_context_iteration(_context, TRUE);
+    }
+    connection.reset();
+    g_dbus_node_info_unref(_node);
+    g_main_context_pop_thread_default(_context);
+    g_main_context_unref(_context);
+  }
+
+  std::string _address;
+  std::atomic_bool _stop;
+  GMainContext *_context;
+  GDBusNodeInfo *_node;
+  std::thread _thread;
+  std::mutex _mut;
+  MockCall _last_call;
+  size_t _calls = 0;
+  size_t _failing_finds = 0;
+  size_t _failing_removes = 0;
+  size_t _device_queries = 0;
+  std::map<std::string, MockProfile> _profiles; /*!< by object path */
+  std::vector<std::vector<std::string>> _devices; /*!< profile paths */
+};
+
+#endif /* end of include guard: MOCKCOLORD_H */
@@ -0,0 +1,318 @@
+#include "BrightnessTargets.h"
+#include "FileWatcher.h"
+#include "ProfileApplier.h"
+#include "ProfileBackend.h"
+#include "ProfileGenerator.h"
+#include "ProfilePipeline.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <easylogging++.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+INITIALIZE_EASYLOGGINGPP
+
+#define RECORD_SIZE 16 /*!< "ww:ssssssssssss\n" */
+#define SETTLE_TIME std::chrono::milliseconds(200)
+#define MAX_SHUTDOWN_MS 1000.0
+
+struct StressConfig {
+  uint writers;
+  uint rate; /*!< writes per second of every writer, 0 unthrottled */
+  std::chrono::milliseconds duration; /*!< of every cycle */
+  uint cycles;                        /*!< stop/start cycles of the watcher */
+};
+
+struct StressReport {
+  uint64_t writes = 0;
+  uint64_t delivered = 0;
+  uint64_t torn = 0;  /*!< truncated or partial content */
+  uint64_t stale = 0; /*!< older than content delivered before */
+  uint64_t read_writes = 0; /*!< writes while the reader was running */
+  uint64_t fresh = 0;       /*!< deliveries of a write not seen before */
+  uint lost_final = 0; /*!< cycles whose last write never got delivered */
+  double max_latency_ms = 0.0;
+  double total_latency_ms = 0.0;
+  uint64_t latencies = 0;
+  double max_shutdown_ms = 0.0;
+};
+
+int64_t steadyNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/*! \class NullBackend
+ *  \brief discards the profiles, only the apply loop gets loaded
+ */
+class NullBackend : public ProfileBackend {
+public:
+  bool setIccFromData(const uint8_t *data, size_t size,
+                      uint display_device_id = 0) override {
+    return size > 0;
+  }
+};
+
+/*! \class Writers
+ *  \brief threads truncating and rewriting the watched file
+ *
+ *  Every write is a fixed size record of the writer and its sequence
+ * number, the time it completed is kept for the wakeup latency.
+ */
+class Writers {
+public:
+  Writers(std::filesystem::path file, const StressConfig &conf)
+      : _file(file), _conf(conf), _stop(false), _threads(), _completed() {
+    size_t per_cycle =
+        _conf.rate > 0 ? _conf.rate * (_conf.duration.count() / 1000 + 1) * 2
+                       : 1 << 20;
+    for (uint w = 0; w < _conf.writers; w++) {
+      _completed.emplace_back(per_cycle);
+      _seq.push_back(0);
+    }
+  }
+
+  void start() {
+    _stop = false;
+    for (uint w = 0; w < _conf.writers; w++) {
+      _threads.emplace_back(&Writers::writeLoop, this, w);
+    }
+  }
+
+  void stop() {
+    _stop = true;
+    for (std::thread &thread : _threads) {
+      thread.join();
+    }
+    _threads.clear();
+  }
+
+  /*! \return 0 if not completed yet or not tracked */
+  int64_t completedNs(uint writer, uint64_t seq) const {
+    return seq < _completed[writer].size() ? _completed[writer][seq].load()
+                                           : 0;
+  }
+
+  uint64_t writes() const {
+    uint64_t sum = 0;
+    for (uint64_t seq : _seq) {
+      sum += seq;
+    }
+    return sum;
+  }
+
+protected:
+  void writeLoop(uint writer) {
+    auto period = _conf.rate > 0 ? std::chrono::nanoseconds(1000000000 /
+                                                            _conf.rate)
+                                 : std::chrono::nanoseconds(0);
+    auto next = std::chrono::steady_clock::now();
+    char record[RECORD_SIZE + 1];
+    while (!_stop) {
+      uint64_t seq = ++_seq[writer];
+      snprintf(record, sizeof(record), "%02u:%012llu\n", writer,
+               static_cast<unsigned long long>(seq));
+      // truncated first, like the sysfs and ofstream writers
+      int fd = open(_file.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+      if (fd >= 0) {
+        (void)!write(fd, record, RECORD_SIZE);
+        close(fd);
+      }
+      if (seq < _completed[writer].size()) {
+        _completed[writer][seq] = steadyNs();
+      }
+      if (_conf.rate > 0) {
+        next += period;
+        std::this_thread::sleep_until(next);
+      }
+    }
+  }
+
+  std::filesystem::path _file;
+  StressConfig _conf;
+  std::atomic_bool _stop;
+  std::vector<std::thread> _threads;
+  std::vector<std::vector<std::atomic<int64_t>>> _completed;
+  std::vector<uint64_t> _seq; /*!< only written by its writer */
+};
+
+/*! \return writer and sequence number, nullopt if the record is torn */
+std::optional<std::pair<uint, uint64_t>> parseRecord(const std::string &s) {
+  unsigned writer;
+  unsigned long long seq;
+  if (s.size() != RECORD_SIZE ||
+      sscanf(s.c_str(), "%2u:%12llu", &writer, &seq) != 2) {
+    return std::nullopt;
+  }
+  return std::make_pair(writer, static_cast<uint64_t>(seq));
+}
+
+bool parseArgs(int argc, char *argv[], StressConfig &conf) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string option = argv[i];
+    long value = std::atol(argv[i + 1]);
+    if (value < 0) {
+      return false;
+    }
+    if (option == "--writers" && value > 0) {
+      conf.writers = value;
+    } else if (option == "--rate") {
+      conf.rate = value;
+    } else if (option == "--duration" && value > 0) {
+      conf.duration = std::chrono::milliseconds(value);
+    } else if (option == "--cycles" && value > 0) {
+      conf.cycles = value;
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1;
+}
+
+int main(int argc, char *argv[]) {
+  el::Loggers::addFlag(el::LoggingFlag::HierarchicalLogging);
+  el::Loggers::setLoggingLevel(el::Level::Error);
+  StressConfig conf = {4, 1000, std::chrono::milliseconds(1000), 3};
+  if (!parseArgs(argc, argv, conf)) {
+    std::cerr << "Usage: stress_file_watcher [--writers <n>] [--rate "
+                 "<writes/s>] [--duration <ms>] [--cycles <n>]"
+              << std::endl;
+    return -1;
+  }
+
+  // unique, so parallel runs don't write into each other's file
+  std::string file_template =
+      (std::filesystem::temp_directory_path() / "stress_file_watcher.XXXXXX")
+          .string();
+  int file_fd = mkstemp(file_template.data());
+  if (file_fd < 0) {
+    std::cerr << "Watched file couldn't get created, errno: "
+              << strerror(errno) << std::endl;
+    return -1;
+  }
+  close(file_fd);
+  std::filesystem::path file = file_template;
+
+  // the delivered changes load the apply loop like in the daemon
+  auto backend = std::make_shared<NullBackend>();
+  auto applier = std::make_shared<ProfileApplier>(backend, nullptr);
+  auto targets = std::make_shared<BrightnessTargets>();
+  ProfilePipeline pipeline(applier, targets);
+  std::thread pipeline_thread([&]() { pipeline.run(BRIGHTNESS_LEVEL_SCALE); });
+
+  StressReport report;
+  Writers writers(file, conf);
+  FileWatcher watcher(file);
+  std::vector<uint64_t> last_seq(conf.writers, 0);
+  for (uint cycle = 0; cycle < conf.cycles; cycle++) {
+    if (watcher.startWatching() != file_watch_error::success) {
+      std::cerr << "FileWatcher couldn't get started!" << std::endl;
+      return -1;
+    }
+    std::atomic_bool reading = true;
+    std::string last_delivered;
+    std::thread reader([&]() {
+      while (reading) {
+        std::optional<std::string> content =
+            watcher.waitForAndGet(std::chrono::milliseconds(50));
+        if (!content) {
+          continue;
+        }
+        int64_t now = steadyNs();
+        report.delivered++;
+        last_delivered = content.value();
+        auto record = parseRecord(content.value());
+        if (!record || record->first >= conf.writers) {
+          report.torn++;
+          continue;
+        }
+        auto [writer, seq] = record.value();
+        if (seq < last_seq[writer]) {
+          report.stale++;
+        } else if (seq > last_seq[writer]) {
+          report.fresh++;
+        }
+        last_seq[writer] = std::max(last_seq[writer], seq);
+        if (int64_t completed = writers.completedNs(writer, seq)) {
+          double latency_ms = (now - completed) / 1000000.0;
+          report.max_latency_ms = std::max(report.max_latency_ms, latency_ms);
+          report.total_latency_ms += latency_ms;
+          report.latencies++;
+        }
+        targets->post(0, seq % (BRIGHTNESS_LEVEL_SCALE + 1));
+      }
+    });
+
+    uint64_t writes_before = writers.writes();
+    writers.start();
+    std::this_thread::sleep_for(conf.duration);
+    writers.stop();
+    report.read_writes += writers.writes() - writes_before;
+    // the last write has to get delivered, nothing follows it
+    std::this_thread::sleep_for(SETTLE_TIME);
+    reading = false;
+    reader.join();
+    if (last_delivered != watcher.readFile()) {
+      report.lost_final++;
+    }
+
+    // stopped while the writers keep the watcher busy
+    writers.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto stop_begin = std::chrono::steady_clock::now();
+    watcher.stopWatching();
+    double shutdown_ms = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - stop_begin)
+                             .count();
+    report.max_shutdown_ms = std::max(report.max_shutdown_ms, shutdown_ms);
+    writers.stop();
+  }
+  targets->close();
+  pipeline_thread.join();
+  report.writes = writers.writes();
+  std::filesystem::remove(file);
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "writers: " << conf.writers << " rate: " << conf.rate
+            << " writes/s cycles: " << conf.cycles << std::endl;
+  std::cout << "writes: " << report.writes
+            << " delivered: " << report.delivered << " torn: " << report.torn
+            << " stale: " << report.stale << std::endl;
+  // overwritten before the watcher read them, the latest value wins
+  uint64_t lost_intermediate =
+      report.read_writes > report.fresh ? report.read_writes - report.fresh
+                                        : 0;
+  std::cout << "lost intermediate updates: " << lost_intermediate << " of "
+            << report.read_writes << " writes" << std::endl;
+  std::cout << "lost final updates: " << report.lost_final << " of "
+            << conf.cycles << " cycles" << std::endl;
+  std::cout << "wakeup latency ms mean: "
+            << (report.latencies ? report.total_latency_ms / report.latencies
+                                 : 0.0)
+            << " max: " << report.max_latency_ms << std::endl;
+  std::cout << "shutdown ms max: " << report.max_shutdown_ms << std::endl;
+  std::cout << pipeline.statsString() << std::endl;
+
+  // lost and torn updates are reported, the design doesn't prevent them
+  if (report.stale > 0 || report.max_shutdown_ms > MAX_SHUTDOWN_MS) {
+    std::cout << "Failed!" << std::endl;
+    return -1;
+  }
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
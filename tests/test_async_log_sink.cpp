@@ -0,0 +1,65 @@
+#include "AsyncLogSink.h"
+#include <cassert>
+#include <chrono>
+#include <easylogging++.h>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+INITIALIZE_EASYLOGGINGPP
+
+std::string readAll(int fd) {
+  std::string content;
+  char buf[4096];
+  ssize_t len;
+  while ((len = read(fd, buf, sizeof(buf))) > 0) {
+    content.append(buf, len);
+  }
+  return content;
+}
+
+int main(int argc, char *argv[]) {
+  el::Loggers::addFlag(el::LoggingFlag::HierarchicalLogging);
+  el::Loggers::setLoggingLevel(el::Level::Warning);
+  int fds[2];
+  int piped = pipe2(fds, O_CLOEXEC);
+  assert(piped == 0);
+
+  {
+    AsyncLogSink sink(fds[1], 4);
+    // without the writer thread the ring buffer fills up
+    for (int i = 0; i < 6; i++) {
+      bool queued = sink.push(el::Level::Info, "queued " + std::to_string(i));
+      assert(queued == (i < 4));
+    }
+    assert(sink.dropped() == 2);
+
+    bool started = sink.start();
+    assert(started);
+    started = sink.start();
+    assert(!started);
+    // the writer drains the full ring buffer first
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    LOG(WARNING) << "through easylogging";
+    bool stopped = sink.stop();
+    assert(stopped);
+    stopped = sink.stop();
+    assert(!stopped);
+  }
+  close(fds[1]);
+
+  std::string output = readAll(fds[0]);
+  close(fds[0]);
+  // the drop gets reported first, then the messages oldest first
+  size_t dropped = output.find("2 log messages dropped");
+  size_t first = output.find("queued 0");
+  size_t last = output.find("queued 3");
+  assert(dropped != std::string::npos && first != std::string::npos);
+  assert(dropped < first && first < last);
+  assert(output.find("queued 4") == std::string::npos);
+  assert(output.find("through easylogging") != std::string::npos);
+
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
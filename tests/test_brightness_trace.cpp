@@ -0,0 +1,59 @@
+#include "BrightnessTrace.h"
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <easylogging++.h>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+INITIALIZE_EASYLOGGINGPP
+
+int main(int argc, char *argv[]) {
+  std::filesystem::path trace_path =
+      std::filesystem::temp_directory_path() / "test_brightness_trace.trace";
+
+  {
+    TraceRecorder recorder(trace_path);
+    recorder.record(0, 1000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    recorder.record(0, 950);
+    recorder.record(1, 0);
+    assert(recorder.recorded() == 3);
+  }
+
+  std::vector<TraceEvent> events = read_trace(trace_path);
+  assert(events.size() == 3);
+  assert(events[0].display_device_id == 0 && events[0].level == 1000);
+  assert(events[1].display_device_id == 0 && events[1].level == 950);
+  assert(events[2].display_device_id == 1 && events[2].level == 0);
+  assert(events[1].offset - events[0].offset >=
+         std::chrono::milliseconds(20));
+  assert(events[2].offset >= events[1].offset);
+
+  // a partial record at the end gets ignored
+  {
+    std::ofstream file(trace_path, std::ios::app | std::ios::binary);
+    file.write("abc", 3);
+  }
+  assert(read_trace(trace_path).size() == 3);
+
+  // no trace
+  {
+    std::ofstream file(trace_path, std::ios::trunc);
+    file << "no trace at all";
+  }
+  bool thrown = false;
+  try {
+    read_trace(trace_path);
+  } catch (std::exception &e) {
+    thrown = true;
+  }
+  assert(thrown);
+  std::filesystem::remove(trace_path);
+
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
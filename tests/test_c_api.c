@@ -0,0 +1,116 @@
+#include "colord_brightness.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// plain C, so the header gets checked without a C++ compiler
+
+struct applied_profiles {
+  pthread_mutex_t mut;
+  unsigned count[2];
+  size_t last_size;
+};
+
+static int count_profile(const uint8_t *data, size_t size, unsigned display,
+                         void *user_data) {
+  struct applied_profiles *applied = user_data;
+  pthread_mutex_lock(&applied->mut);
+  if (display < 2) {
+    applied->count[display]++;
+  }
+  applied->last_size = size;
+  pthread_mutex_unlock(&applied->mut);
+  return data != NULL && size > 0 ? 0 : -1;
+}
+
+static int fail_profile(const uint8_t *data, size_t size, unsigned display,
+                        void *user_data) {
+  return -1;
+}
+
+int main(void) {
+  // in-memory atlas, the one of the user stays untouched
+  unsetenv("XDG_RUNTIME_DIR");
+  assert(colord_brightness_api_version() == COLORD_BRIGHTNESS_API_VERSION);
+  assert(colord_brightness_level(0.5) == 500);
+  assert(colord_brightness_level(2.0) == COLORD_BRIGHTNESS_LEVEL_SCALE);
+  assert(colord_brightness_level(-1.0) == 0);
+
+  // size query first, then into a buffer of that size
+  size_t size = 0;
+  assert(colord_brightness_generate(700, NULL, 0, &size) ==
+         COLORD_BRIGHTNESS_ERROR_BUFFER_TOO_SMALL);
+  assert(size > 0);
+  uint8_t *profile = malloc(size);
+  size_t written = 0;
+  assert(colord_brightness_generate(700, profile, size, &written) ==
+         COLORD_BRIGHTNESS_OK);
+  assert(written == size);
+  free(profile);
+  assert(colord_brightness_generate(COLORD_BRIGHTNESS_LEVEL_SCALE + 1, NULL,
+                                    0, &size) ==
+         COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT);
+
+  struct applied_profiles applied = {PTHREAD_MUTEX_INITIALIZER, {0, 0}, 0};
+  colord_brightness *handle = NULL;
+  assert(colord_brightness_new_with_backend(NULL, NULL, &handle) ==
+         COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT);
+  assert(colord_brightness_new_with_backend(count_profile, &applied,
+                                            &handle) == COLORD_BRIGHTNESS_OK);
+  assert(handle != NULL);
+  assert(colord_brightness_display_count(handle) == 0);
+
+  uint32_t level = 0;
+  assert(colord_brightness_applied_level(handle, 0, &level) ==
+         COLORD_BRIGHTNESS_ERROR_NOT_APPLIED);
+  assert(colord_brightness_set_level(handle, 0, 1001) ==
+         COLORD_BRIGHTNESS_ERROR_INVALID_ARGUMENT);
+
+  // latest value wins, the last level of every display gets applied
+  for (uint32_t l = 100; l <= 600; l += 50) {
+    assert(colord_brightness_set_level(handle, 0, l) == COLORD_BRIGHTNESS_OK);
+  }
+  assert(colord_brightness_set_level(handle, 1, 300) == COLORD_BRIGHTNESS_OK);
+  assert(colord_brightness_wait_applied(handle, 0, 5000) ==
+         COLORD_BRIGHTNESS_OK);
+  assert(colord_brightness_wait_applied(handle, 1, 5000) ==
+         COLORD_BRIGHTNESS_OK);
+  assert(colord_brightness_applied_level(handle, 0, &level) ==
+         COLORD_BRIGHTNESS_OK);
+  assert(level == 600);
+  assert(colord_brightness_applied_level(handle, 1, &level) ==
+         COLORD_BRIGHTNESS_OK);
+  assert(level == 300);
+  pthread_mutex_lock(&applied.mut);
+  assert(applied.count[0] >= 1 && applied.count[0] <= 11);
+  assert(applied.count[1] == 1);
+  assert(applied.last_size > 0);
+  unsigned applied_before = applied.count[0];
+  pthread_mutex_unlock(&applied.mut);
+
+  // the same level again, the wait is for the new request and doesn't end
+  // on the equal level applied before
+  colord_brightness_status status = colord_brightness_set_level(handle, 0, 600);
+  assert(status == COLORD_BRIGHTNESS_OK);
+  status = colord_brightness_wait_applied(handle, 0, 5000);
+  assert(status == COLORD_BRIGHTNESS_OK);
+  pthread_mutex_lock(&applied.mut);
+  assert(applied.count[0] == applied_before + 1);
+  pthread_mutex_unlock(&applied.mut);
+  colord_brightness_free(handle);
+
+  // failures of the backend get reported to the waiter
+  assert(colord_brightness_new_with_backend(fail_profile, NULL, &handle) ==
+         COLORD_BRIGHTNESS_OK);
+  assert(colord_brightness_set_level(handle, 0, 400) == COLORD_BRIGHTNESS_OK);
+  assert(colord_brightness_wait_applied(handle, 0, 5000) ==
+         COLORD_BRIGHTNESS_ERROR_NOT_APPLIED);
+  assert(colord_brightness_applied_level(handle, 0, &level) ==
+         COLORD_BRIGHTNESS_ERROR_NOT_APPLIED);
+  colord_brightness_free(handle);
+
+  printf("Success!\n");
+  return 0;
+}
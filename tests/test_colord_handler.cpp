@@ -0,0 +1,178 @@
+#include "ColordHandler.h"
+#include "MockColord.h"
+#include "ProfileGenerator.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <easylogging++.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+INITIALIZE_EASYLOGGINGPP
+
+// -----------------Helper  functions----------------
+/*! \brief what colord reads for the default profile of the display */
+std::vector<uint8_t> default_content(MockColord &mock, size_t display) {
+  std::vector<std::string> profiles = mock.deviceProfiles(display);
+  assert(!profiles.empty());
+  std::ifstream file(mock.profile(profiles.front()).filename,
+                     std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                              std::istreambuf_iterator<char>());
+}
+
+size_t open_fds() {
+  return std::distance(std::filesystem::directory_iterator("/proc/self/fd"),
+                       std::filesystem::directory_iterator());
+}
+
+bool apply(ColordHandler &handler, const std::vector<uint8_t> &data,
+           uint display) {
+  return handler.setIccFromData(data.data(), data.size(), display);
+}
+// -------------------------------------
+
+int main(int argc, char *argv[]) {
+  el::Loggers::setLoggingLevel(el::Level::Warning);
+  std::vector<uint8_t> dim = generate_srgb_profile_data(0.3);
+  std::vector<uint8_t> half = generate_srgb_profile_data(0.5);
+  std::vector<uint8_t> bright = generate_srgb_profile_data(0.9);
+
+  GTestDBus *bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+  g_test_dbus_up(bus);
+  // libcolord looks for colord on the system bus
+  setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(bus), 1);
+  {
+    MockColord mock(g_test_dbus_get_bus_address(bus), 2);
+    auto owned_handler = std::make_unique<ColordHandler>("test_colord_handler");
+    ColordHandler &handler = *owned_handler;
+    bool discovered = handler.discoverDisplayDevices();
+    assert(discovered);
+    assert(handler.displayDeviceCount() == 2);
+
+    // the same level on both displays, each reads its own memfd
+    bool applied = apply(handler, half, 0);
+    assert(applied);
+    applied = apply(handler, half, 1);
+    assert(applied);
+    std::vector<std::string> first = mock.deviceProfiles(0);
+    std::vector<std::string> second = mock.deviceProfiles(1);
+    assert(first.size() == 1 && second.size() == 1);
+    assert(first.front() != second.front());
+    assert(mock.profile(first.front()).filename !=
+           mock.profile(second.front()).filename);
+
+    // different levels, a later update of the first display must not
+    // change the curve of the second one
+    applied = apply(handler, dim, 0);
+    assert(applied);
+    applied = apply(handler, bright, 1);
+    assert(applied);
+    applied = apply(handler, half, 0);
+    assert(applied);
+    applied = apply(handler, bright, 0);
+    assert(applied);
+    assert(default_content(mock, 0) == bright);
+    assert(default_content(mock, 1) == bright);
+    applied = apply(handler, dim, 0);
+    assert(applied);
+    assert(default_content(mock, 0) == dim);
+    assert(default_content(mock, 1) == bright);
+    assert(mock.deviceProfiles(0).size() == 1);
+    assert(mock.deviceProfiles(1).size() == 1);
+
+    // the level didn't change
+    applied = apply(handler, dim, 0);
+    assert(applied);
+    assert(mock.deviceProfiles(0).size() == 1);
+    assert(default_content(mock, 0) == dim);
+
+    // a display colord doesn't have gets no memfd, and doesn't query colord
+    // on every request
+    size_t fds = open_fds();
+    size_t queries = mock.deviceQueries();
+    for (int i = 0; i < 5; i++) {
+      applied = apply(handler, dim, 7);
+      assert(!applied);
+    }
+    assert(open_fds() == fds);
+    assert(mock.deviceQueries() <= queries + 1);
+
+    // the handler tracks what the display shows
+    std::string current = mock.deviceProfiles(1).front();
+    assert(handler.currentProfilePath(1) == current);
+
+    // a replaced profile colord didn't remove stays tracked, its removal
+    // gets retried by the next update of the display
+    mock.failNextRemoves(1);
+    applied = apply(handler, half, 1);
+    assert(applied);
+    assert(mock.deviceProfiles(1).size() == 2);
+    applied = apply(handler, dim, 1);
+    assert(applied);
+    assert(mock.deviceProfiles(1).size() == 1);
+    assert(default_content(mock, 1) == dim);
+
+    // and on shutdown
+    mock.failNextRemoves(1);
+    applied = apply(handler, half, 1);
+    assert(applied);
+    assert(mock.deviceProfiles(1).size() == 2);
+    current = mock.deviceProfiles(1).front();
+    owned_handler.reset();
+    assert(mock.deviceProfiles(1) == std::vector<std::string>{current});
+
+    // persistent profiles of an instance whose state got lost get deleted by
+    // the next one, the adopted one and temporary ones stay
+    std::filesystem::path icc_dir =
+        std::filesystem::temp_directory_path() /
+        ("test_colord_handler-" + std::to_string(getpid()));
+    std::filesystem::create_directories(icc_dir);
+    std::string orphaned;
+    std::string adopted;
+    {
+      ColordHandler earlier("test_colord_handler");
+      bool persistent = earlier.usePersistentProfiles(icc_dir / "icc");
+      assert(persistent);
+      discovered = earlier.discoverDisplayDevices();
+      assert(discovered);
+      applied = apply(earlier, dim, 0);
+      assert(applied);
+      orphaned = earlier.currentProfilePath(0).value();
+      applied = apply(earlier, half, 1);
+      assert(applied);
+      adopted = earlier.currentProfilePath(1).value();
+    }
+    ColordHandler later("test_colord_handler");
+    bool persistent = later.usePersistentProfiles(icc_dir / "icc");
+    assert(persistent);
+    discovered = later.discoverDisplayDevices();
+    assert(discovered);
+    bool adopted_profile = later.adoptProfile("", 1);
+    assert(!adopted_profile);
+    adopted_profile = later.adoptProfile(adopted, 1);
+    assert(adopted_profile);
+    size_t removed = later.removeOrphanedProfiles();
+    assert(removed == 1);
+    std::vector<std::string> profiles = mock.profiles();
+    auto known = [&profiles](const std::string &object_path) {
+      return std::find(profiles.begin(), profiles.end(), object_path) !=
+             profiles.end();
+    };
+    assert(!known(orphaned));
+    assert(known(adopted));
+    assert(known(current));
+    std::filesystem::remove_all(icc_dir);
+  }
+  g_test_dbus_down(bus);
+  g_object_unref(bus);
+
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include "BrightnessTargets.h"
+#include "ControlSocket.h"
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <easylogging++.h>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+INITIALIZE_EASYLOGGINGPP
+
+int connectTo(std::filesystem::path socket_path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  int connected =
+      connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+  assert(connected == 0);
+  return fd;
+}
+
+std::string readLine(int fd) {
+  std::string line;
+  char c;
+  while (read(fd, &c, 1) == 1 && c != '\n') {
+    line += c;
+  }
+  return line;
+}
+
+int main(int argc, char *argv[]) {
+  std::filesystem::path socket_path =
+      std::filesystem::temp_directory_path() / "test_control_socket" /
+      "control";
+  auto targets = std::make_shared<BrightnessTargets>();
+  targets->setCurrent(0, 500);
+  {
+    ControlSocket control_socket(socket_path, targets);
+    bool started = control_socket.start();
+    assert(started);
+    int fd = connectTo(socket_path);
+
+    // pipelined slider drag, only the latest value gets posted
+    std::string drag;
+    for (int percent = 10; percent <= 80; percent += 10) {
+      drag += "set 1 " + std::to_string(percent) + "\n";
+    }
+    drag += "step 1 -5\nget 1\n";
+    ssize_t written = write(fd, drag.data(), drag.size());
+    assert(written == static_cast<ssize_t>(drag.size()));
+    std::string reply = readLine(fd);
+    assert(reply == "1 75.0");
+
+    std::optional<BrightnessTarget> target =
+        targets->waitNextFor(std::chrono::milliseconds(500));
+    assert(target.has_value());
+    assert(target->display_device_id == 1);
+    assert(target->level == 750);
+    // the socket posted the batch once, the mailbox had nothing to coalesce
+    assert(targets->coalesced() == 0);
+    target = targets->waitNextFor(std::chrono::milliseconds(50));
+    assert(!target.has_value());
+
+    // relative to the current level
+    std::string step = "step 0 10\nget 0\n";
+    written = write(fd, step.data(), step.size());
+    assert(written == static_cast<ssize_t>(step.size()));
+    reply = readLine(fd);
+    assert(reply == "0 60.0");
+    target = targets->waitNextFor(std::chrono::milliseconds(500));
+    assert(target.has_value());
+    assert(target->display_device_id == 0);
+    assert(target->level == 600);
+
+    std::string invalid = "dim 0 10\n";
+    written = write(fd, invalid.data(), invalid.size());
+    assert(written == static_cast<ssize_t>(invalid.size()));
+    reply = readLine(fd);
+    assert(reply == "error unknown command");
+
+    // negative and too large displays don't wrap around
+    invalid = "set -1 50\nget 4294967296\nstep 1x 5\n";
+    written = write(fd, invalid.data(), invalid.size());
+    assert(written == static_cast<ssize_t>(invalid.size()));
+    for (int i = 0; i < 3; i++) {
+      reply = readLine(fd);
+      assert(reply == "error invalid display");
+    }
+    target = targets->waitNextFor(std::chrono::milliseconds(50));
+    assert(!target.has_value());
+    close(fd);
+  }
+  assert(!std::filesystem::exists(socket_path));
+  std::filesystem::remove_all(socket_path.parent_path());
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
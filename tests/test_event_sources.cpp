@@ -0,0 +1,327 @@
+#include "AmbientLightEventSource.h"
+#include "BrightnessEventSource.h"
+#include "FakeEventSource.h"
+#include "PowerSupplyEventSource.h"
+#include "ProfileGenerator.h"
+#include "SysfsPollEventSource.h"
+#include "UeventEventSource.h"
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <easylogging++.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+INITIALIZE_EASYLOGGINGPP
+
+void writeFile(std::filesystem::path file, std::string content) {
+  std::ofstream out(file, std::ios::trunc);
+  out << content;
+}
+
+std::string readFile(std::filesystem::path file) {
+  std::ifstream in(file);
+  std::string content;
+  std::getline(in, content);
+  return content;
+}
+
+void sendUevent(int fd, const std::string &message) {
+  ssize_t sent = send(fd, message.data(), message.size(), 0);
+  assert(sent == static_cast<ssize_t>(message.size()));
+}
+
+std::string uevent(const std::string &action, const std::string &subsystem,
+                   const std::string &device) {
+  std::string devpath = "/devices/pci0000:00/0000:00:02.0/drm/card0/"
+                        "card0-eDP-1/" +
+                        device;
+  std::string message = action + "@" + devpath;
+  message.push_back('\0');
+  for (std::string entry :
+       {"ACTION=" + action, "DEVPATH=" + devpath, "SUBSYSTEM=" + subsystem,
+        std::string("SEQNUM=1")}) {
+    message += entry;
+    message.push_back('\0');
+  }
+  return message;
+}
+
+int main(int argc, char *argv[]) {
+  std::filesystem::path device_dir =
+      std::filesystem::temp_directory_path() / "test_event_sources" /
+      "intel_backlight";
+  std::filesystem::create_directories(device_dir);
+  writeFile(device_dir / ACTUAL_BRIGHTNESS_FILE, "4000\n");
+  writeFile(device_dir / "brightness", "4000\n");
+
+  // parsing of uevents
+  std::string change = uevent("change", "backlight", "intel_backlight");
+  assert(UeventEventSource::isBacklightChange(change.data(), change.size(),
+                                              "intel_backlight"));
+  assert(!UeventEventSource::isBacklightChange(change.data(), change.size(),
+                                               "acpi_video0"));
+  std::string add = uevent("add", "backlight", "intel_backlight");
+  assert(!UeventEventSource::isBacklightChange(add.data(), add.size(),
+                                               "intel_backlight"));
+  std::string drm = uevent("change", "drm", "intel_backlight");
+  assert(!UeventEventSource::isBacklightChange(drm.data(), drm.size(),
+                                               "intel_backlight"));
+
+  {
+    // fake netlink socket, only the change of the device wakes up
+    int fds[2];
+    int paired = socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds);
+    assert(paired == 0);
+    UeventEventSource source(device_dir / "", fds[0]);
+    bool started = source.start();
+    assert(started);
+    auto next = std::async(std::launch::async,
+                           [&source]() { return source.waitAndGet(); });
+    sendUevent(fds[1], add);
+    sendUevent(fds[1], drm);
+    std::future_status status = next.wait_for(std::chrono::milliseconds(100));
+    assert(status == std::future_status::timeout);
+    writeFile(device_dir / ACTUAL_BRIGHTNESS_FILE, "3000\n");
+    sendUevent(fds[1], change);
+    std::optional<std::string> value = next.get();
+    assert(value == "3000\n");
+
+    // stop wakes up the waiter
+    next = std::async(std::launch::async,
+                      [&source]() { return source.waitAndGet(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    bool stopped = source.stop();
+    assert(stopped);
+    value = next.get();
+    assert(!value.has_value());
+    close(fds[1]);
+  }
+
+  {
+    // power supplies, any change of the subsystem reads them again
+    std::string supply = uevent("change", "power_supply", "AC");
+    assert(UeventEventSource::isChange(supply.data(), supply.size(),
+                                       "power_supply", ""));
+    assert(!UeventEventSource::isChange(change.data(), change.size(),
+                                        "power_supply", ""));
+    std::filesystem::path supply_dir =
+        device_dir.parent_path() / "power_supply";
+    std::filesystem::create_directories(supply_dir / "BAT0");
+    writeFile(supply_dir / "BAT0" / "type", "Battery\n");
+    writeFile(supply_dir / "BAT0" / "status", "Discharging\n");
+    // only a discharging battery
+    assert(!PowerSupplyEventSource::onExternalPower(supply_dir));
+    std::filesystem::create_directories(supply_dir / "AC");
+    writeFile(supply_dir / "AC" / "type", "Mains\n");
+    writeFile(supply_dir / "AC" / "online", "1\n");
+    assert(PowerSupplyEventSource::onExternalPower(supply_dir));
+
+    int fds[2];
+    int paired = socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds);
+    assert(paired == 0);
+    PowerSupplyEventSource source(supply_dir, fds[0]);
+    bool started = source.start();
+    assert(started);
+    assert(source.readFile() == "1\n");
+    auto next = std::async(std::launch::async,
+                           [&source]() { return source.waitAndGet(); });
+    sendUevent(fds[1], change);
+    std::future_status status = next.wait_for(std::chrono::milliseconds(100));
+    assert(status == std::future_status::timeout);
+    writeFile(supply_dir / "AC" / "online", "0\n");
+    sendUevent(fds[1], supply);
+    std::optional<std::string> value = next.get();
+    assert(value == "0\n");
+    bool stopped = source.stop();
+    assert(stopped);
+    close(fds[1]);
+  }
+
+  {
+    // a regular file never notifies, but can be read and stopped
+    SysfsPollEventSource source(device_dir / ACTUAL_BRIGHTNESS_FILE);
+    bool started = source.start();
+    assert(started);
+    assert(source.readFile() == "3000\n");
+    auto next = std::async(std::launch::async,
+                           [&source]() { return source.waitAndGet(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    bool stopped = source.stop();
+    assert(stopped);
+    std::optional<std::string> value = next.get();
+    assert(!value.has_value());
+  }
+
+  {
+    FakeEventSource source("100\n");
+    bool started = source.start();
+    assert(started);
+    assert(source.readFile() == "100\n");
+    source.inject("50\n");
+    source.inject("60\n");
+    std::optional<std::string> value = source.waitAndGet();
+    assert(value == "50\n");
+    value = source.waitAndGet();
+    assert(value == "60\n");
+    assert(source.readFile() == "60\n");
+    bool stopped = source.stop();
+    assert(stopped);
+    value = source.waitAndGet();
+    assert(!value.has_value());
+  }
+
+  {
+    // ambient light, mapped logarithmically and filtered
+    AmbientLightConfig conf;
+    conf.smoothing = 1.0;
+    conf.min_interval = std::chrono::milliseconds(10);
+    conf.max_interval = std::chrono::milliseconds(40);
+    AmbientLightFilter filter(conf);
+    assert(filter.levelFor(0) == quantize_brightness(conf.min_brightness));
+    assert(filter.levelFor(conf.max_lux) == BRIGHTNESS_LEVEL_SCALE);
+    assert(filter.levelFor(10) < filter.levelFor(100));
+    std::optional<uint32_t> level = filter.update(100);
+    assert(level == filter.levelFor(100));
+    // within the hysteresis
+    level = filter.update(101);
+    assert(!level.has_value());
+    level = filter.update(5000);
+    assert(level == BRIGHTNESS_LEVEL_SCALE);
+
+    conf.smoothing = 0.5;
+    AmbientLightFilter smoothed(conf);
+    smoothed.update(0);
+    std::optional<uint32_t> half = smoothed.update(1000);
+    assert(half && half.value() > filter.levelFor(0) &&
+           half.value() < BRIGHTNESS_LEVEL_SCALE);
+    conf.smoothing = 1.0;
+
+    std::optional<IioScanType> type =
+        AmbientLightEventSource::parseScanType("be:s12/16>>4");
+    assert(type && type->big_endian && type->is_signed &&
+           type->realbits == 12 && type->storagebits == 16 &&
+           type->shift == 4 && type->repeat == 1);
+    type = AmbientLightEventSource::parseScanType("le:u16/16X2>>0");
+    assert(type && type->storagebits == 16 && type->repeat == 2);
+    assert(!AmbientLightEventSource::parseScanType("le:u16/16X0>>0"));
+    assert(!AmbientLightEventSource::parseScanType("le:u16/16X-1>>0"));
+    assert(!AmbientLightEventSource::parseScanType("le:u12/12>>0"));
+    assert(!AmbientLightEventSource::parseScanType("illuminance"));
+
+    // fake iio tree, the first sensor gets polled
+    std::filesystem::path iio_dir = device_dir.parent_path() / "iio";
+    std::filesystem::path polled = iio_dir / "iio:device0";
+    std::filesystem::create_directories(polled);
+    std::filesystem::create_directories(iio_dir / "trigger0");
+    writeFile(polled / "in_illuminance_raw", "100\n");
+    writeFile(polled / "in_illuminance_scale", "0.5\n");
+    assert(AmbientLightEventSource::find(iio_dir) == polled);
+    assert(!AmbientLightEventSource::find(device_dir).has_value());
+    {
+      AmbientLightEventSource source(polled, conf, iio_dir);
+      bool started = source.start();
+      assert(started && !source.buffered());
+      assert(source.readFile() ==
+             std::to_string(filter.levelFor(50)) + "\n");
+      std::optional<std::string> value = source.waitAndGet();
+      assert(value == std::to_string(filter.levelFor(50)) + "\n");
+      writeFile(polled / "in_illuminance_raw", "2000\n");
+      value = source.waitAndGet();
+      assert(value == std::to_string(BRIGHTNESS_LEVEL_SCALE) + "\n");
+      auto next = std::async(std::launch::async,
+                             [&source]() { return source.waitAndGet(); });
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      bool stopped = source.stop();
+      assert(stopped);
+      value = next.get();
+      assert(!value.has_value());
+    }
+
+    // a sensor with a trigger gets read from its buffer, a fifo here
+    std::filesystem::path buffered = iio_dir / "iio:device1";
+    std::filesystem::create_directories(buffered / "scan_elements");
+    std::filesystem::create_directories(buffered / "buffer");
+    std::filesystem::create_directories(buffered / "trigger");
+    writeFile(buffered / "in_illuminance_raw", "0\n");
+    writeFile(buffered / "scan_elements" / "in_illuminance_en", "0\n");
+    writeFile(buffered / "scan_elements" / "in_illuminance_type",
+              "le:u16/16>>0\n");
+    writeFile(buffered / "scan_elements" / "in_timestamp_en", "1\n");
+    writeFile(buffered / "buffer" / "enable", "0\n");
+    writeFile(buffered / "trigger" / "current_trigger", "als-dev1\n");
+    std::filesystem::path dev_dir = iio_dir / "dev";
+    std::filesystem::create_directories(dev_dir);
+    int made = mkfifo((dev_dir / "iio:device1").c_str(), 0600);
+    assert(made == 0);
+    {
+      AmbientLightEventSource source(buffered, conf, dev_dir);
+      bool started = source.start();
+      assert(started && source.buffered());
+      assert(readFile(buffered / "buffer" / "enable") == "1");
+      assert(readFile(buffered / "scan_elements" / "in_illuminance_en") ==
+             "1");
+      assert(readFile(buffered / "scan_elements" / "in_timestamp_en") ==
+             "0");
+      int fifo = open((dev_dir / "iio:device1").c_str(),
+                      O_WRONLY | O_CLOEXEC);
+      assert(fifo >= 0);
+      // two queued samples of 10 and 1000 lx, only the latest counts
+      uint8_t samples[] = {10, 0, 0xe8, 0x03};
+      ssize_t written = write(fifo, samples, sizeof(samples));
+      assert(written == sizeof(samples));
+      std::optional<std::string> value = source.waitAndGet();
+      assert(value == std::to_string(BRIGHTNESS_LEVEL_SCALE) + "\n");
+      auto next = std::async(std::launch::async,
+                             [&source]() { return source.waitAndGet(); });
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      bool stopped = source.stop();
+      assert(stopped);
+      value = next.get();
+      assert(!value.has_value());
+      close(fifo);
+    }
+    assert(readFile(buffered / "buffer" / "enable") == "0");
+
+    // a repeated channel, every sample holds both elements
+    writeFile(buffered / "scan_elements" / "in_illuminance_type",
+              "le:u16/16X2>>0\n");
+    {
+      AmbientLightEventSource source(buffered, conf, dev_dir);
+      bool started = source.start();
+      assert(started && source.buffered());
+      int fifo = open((dev_dir / "iio:device1").c_str(),
+                      O_WRONLY | O_CLOEXEC);
+      assert(fifo >= 0);
+      // two samples (10, 1000) and (1000, 10) lx, the first element of the
+      // latest one counts
+      uint8_t samples[] = {10, 0, 0xe8, 0x03, 0xe8, 0x03, 10, 0};
+      ssize_t written = write(fifo, samples, sizeof(samples));
+      assert(written == sizeof(samples));
+      std::optional<std::string> value = source.waitAndGet();
+      assert(value == std::to_string(BRIGHTNESS_LEVEL_SCALE) + "\n");
+      bool stopped = source.stop();
+      assert(stopped);
+      close(fifo);
+    }
+  }
+
+  // selection per device
+  assert(parse_event_source_kind("uevent") == event_source_kind::uevent);
+  assert(!parse_event_source_kind("polling").has_value());
+  std::unique_ptr<BrightnessEventSource> automatic =
+      make_event_source(device_dir / "", event_source_kind::automatic);
+  assert(dynamic_cast<SysfsPollEventSource *>(automatic.get()));
+
+  std::filesystem::remove_all(device_dir.parent_path());
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
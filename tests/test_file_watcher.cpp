@@ -8,12 +8,16 @@
 #include <future>
 #include <iostream>
 #include <string>
+#include <thread>
 INITIALIZE_EASYLOGGINGPP
 
 int main(int argc, char *argv[]) {
+  // outside of the source tree, a test run leaves nothing behind
+  std::filesystem::path test_path =
+      std::filesystem::temp_directory_path() / "test_file_watcher";
   {
-    std::ofstream test_file("test");
-    FileWatcher fw(std::filesystem::path("test"));
+    std::ofstream test_file(test_path);
+    FileWatcher fw(test_path);
     assert(test_file.is_open());
 
     file_watch_error started = fw.startWatching();
@@ -37,6 +41,8 @@ int main(int argc, char *argv[]) {
     auto fw_wait_and_get = std::bind(&FileWatcher::waitAndGet, &fw);
     auto file_change_output = std::async(std::launch::async, fw_wait_and_get);
 
+    // the waiter has to wait before the change, it only sees later ones
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
     std::string test_string = "hilarious text";
 
     test_file << test_string;
@@ -53,6 +59,7 @@ int main(int argc, char *argv[]) {
     assert(test_return.has_value());
     assert(test_return.value() == test_string);
   }
+  std::filesystem::remove(test_path);
   std::cout << "Success!" << std::endl;
   return 0;
 }
@@ -0,0 +1,260 @@
+#include "CircuitBreaker.h"
+#include "GuardedBackend.h"
+#include "ProfileBackend.h"
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <easylogging++.h>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+INITIALIZE_EASYLOGGINGPP
+
+/*! \class StallingBackend
+ *  \brief backend like a colord blocked by a session switch, a call only
+ * returns once it responds again or gets cancelled
+ */
+class StallingBackend : public ProfileBackend {
+public:
+  bool setIccFromData(const uint8_t *data, size_t size,
+                      uint display_device_id = 0) override {
+    std::unique_lock<std::mutex> lk(_mut);
+    _calls++;
+    _cv.wait(lk, [&]() {
+      return _responding || (_cancellable && _cancelled[display_device_id]);
+    });
+    if (!_responding && _cancelled[display_device_id]) {
+      return false;
+    }
+    _applied[display_device_id].assign(data, data + size);
+    return true;
+  }
+  void prepareUpdate(uint display_device_id = 0) override {
+    std::lock_guard<std::mutex> lk(_mut);
+    _cancelled[display_device_id] = false;
+  }
+  bool cancelUpdate(uint display_device_id = 0) override {
+    {
+      std::lock_guard<std::mutex> lk(_mut);
+      _cancelled[display_device_id] = true;
+    }
+    _cv.notify_all();
+    return true;
+  }
+  void setResponding(bool responding) {
+    {
+      std::lock_guard<std::mutex> lk(_mut);
+      _responding = responding;
+    }
+    _cv.notify_all();
+  }
+  /*! \brief if false a cancelled call keeps blocking until it responds */
+  void setCancellable(bool cancellable) {
+    std::lock_guard<std::mutex> lk(_mut);
+    _cancellable = cancellable;
+  }
+  std::map<uint, std::vector<uint8_t>> applied() {
+    std::lock_guard<std::mutex> lk(_mut);
+    return _applied;
+  }
+  size_t calls() {
+    std::lock_guard<std::mutex> lk(_mut);
+    return _calls;
+  }
+
+protected:
+  bool _responding = true;
+  bool _cancellable = true;
+  size_t _calls = 0;
+  std::map<uint, bool> _cancelled;
+  std::map<uint, std::vector<uint8_t>> _applied;
+  std::mutex _mut;
+  std::condition_variable _cv;
+};
+
+double elapsed_ms(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - since)
+      .count();
+}
+
+int main(int argc, char *argv[]) {
+  el::Loggers::setLoggingLevel(el::Level::Warning);
+  CircuitBreakerConfig conf;
+  conf.timeout_threshold = 2;
+  conf.initial_backoff = std::chrono::milliseconds(50);
+  conf.max_backoff = std::chrono::milliseconds(150);
+
+  {
+    // opens after consecutive timeouts only, backs off exponentially
+    CircuitBreaker breaker(conf);
+    bool allowed = breaker.allow();
+    assert(allowed);
+    breaker.recordTimeout();
+    breaker.recordResponse();
+    breaker.recordTimeout();
+    assert(breaker.state() == breaker_state::closed);
+    breaker.recordTimeout();
+    allowed = breaker.allow();
+    assert(breaker.state() == breaker_state::open && !allowed);
+    std::this_thread::sleep_until(breaker.retryAt());
+    allowed = breaker.allow();
+    assert(allowed && breaker.state() == breaker_state::half_open);
+    // only one probe at a time
+    allowed = breaker.allow();
+    assert(!allowed);
+    breaker.recordTimeout();
+    assert(breaker.stats().backoff == std::chrono::milliseconds(100));
+    std::this_thread::sleep_until(breaker.retryAt());
+    allowed = breaker.allow();
+    assert(allowed);
+    breaker.recordTimeout();
+    assert(breaker.stats().backoff == conf.max_backoff);
+    std::this_thread::sleep_until(breaker.retryAt());
+    allowed = breaker.allow();
+    assert(allowed);
+    breaker.recordResponse();
+    assert(breaker.state() == breaker_state::closed);
+    BreakerStats stats = breaker.stats();
+    assert(stats.timeouts == 5 && stats.opened == 1 && stats.probes == 3);
+    assert(stats.rejected == 2);
+  }
+
+  auto stalling = std::make_shared<StallingBackend>();
+  GuardedBackend guarded(stalling, std::chrono::milliseconds(30), conf);
+  std::vector<uint8_t> profile(128, 1);
+  bool applied = guarded.setIccFromData(profile.data(), profile.size(), 0);
+  assert(applied);
+
+  // colord stalls: the calls return after the deadline instead of hanging,
+  // or right away while the retry of a timed out profile is still stuck. The
+  // upper bound only leaves room for a loaded machine
+  stalling->setResponding(false);
+  for (int i = 0; i < 2; i++) {
+    auto begin = std::chrono::steady_clock::now();
+    profile.assign(128, 2 + i);
+    applied = guarded.setIccFromData(profile.data(), profile.size(), 0);
+    double ms = elapsed_ms(begin);
+    assert(!applied);
+    assert(ms < 2000.0);
+  }
+  assert(guarded.stats().breaker.state == breaker_state::open);
+
+  // open: rejected without calling the backend, only the latest profile is
+  // kept. Waiting for the deadline would take 11 * 30 ms.
+  size_t calls = stalling->calls();
+  auto begin = std::chrono::steady_clock::now();
+  for (uint8_t value = 10; value < 20; value++) {
+    profile.assign(128, value);
+    applied = guarded.setIccFromData(profile.data(), profile.size(), 0);
+    assert(!applied);
+  }
+  profile.assign(64, 30);
+  applied = guarded.setIccFromData(profile.data(), profile.size(), 1);
+  assert(!applied);
+  assert(elapsed_ms(begin) < 300.0);
+  assert(stalling->calls() == calls);
+  GuardStats stats = guarded.stats();
+  assert(stats.pending == 2 && stats.breaker.rejected == 11);
+
+  // the probes keep timing out while colord stalls
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  stats = guarded.stats();
+  assert(stats.breaker.probes >= 1 && stats.breaker.timeouts >= 3);
+  assert(stats.breaker.state != breaker_state::closed);
+
+  // colord responds again: the latest profiles get applied without a new
+  // call
+  stalling->setResponding(true);
+  begin = std::chrono::steady_clock::now();
+  while (guarded.stats().recovered < 2 && elapsed_ms(begin) < 1000.0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  stats = guarded.stats();
+  assert(stats.breaker.state == breaker_state::closed);
+  assert(stats.pending == 0 && stats.recovered == 2);
+  std::map<uint, std::vector<uint8_t>> profiles = stalling->applied();
+  assert(profiles[0] == std::vector<uint8_t>(128, 19));
+  assert(profiles[1] == std::vector<uint8_t>(64, 30));
+
+  // preempted before it reached the backend
+  calls = stalling->calls();
+  guarded.prepareUpdate(0);
+  bool cancelled = guarded.cancelUpdate(0);
+  applied = guarded.setIccFromData(profile.data(), profile.size(), 0);
+  assert(cancelled && !applied);
+  assert(stalling->calls() == calls);
+
+  profile.assign(128, 40);
+  applied = guarded.setIccFromData(profile.data(), profile.size(), 0);
+  assert(applied);
+  std::cout << guarded.statsString() << std::endl;
+
+  {
+    // a call the backend doesn't give up: counted at the deadline, a newer
+    // call doesn't wait for it
+    auto blocking = std::make_shared<StallingBackend>();
+    GuardedBackend guarded(blocking, std::chrono::milliseconds(30), conf);
+    blocking->setCancellable(false);
+    blocking->setResponding(false);
+    std::vector<uint8_t> first(128, 50);
+    std::thread caller([&]() {
+      bool applied = guarded.setIccFromData(first.data(), first.size(), 0);
+      assert(applied);
+    });
+    begin = std::chrono::steady_clock::now();
+    while (guarded.stats().breaker.timeouts < 1 &&
+           elapsed_ms(begin) < 1000.0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    assert(guarded.stats().breaker.timeouts == 1);
+    profile.assign(128, 51);
+    begin = std::chrono::steady_clock::now();
+    applied = guarded.setIccFromData(profile.data(), profile.size(), 0);
+    assert(!applied && elapsed_ms(begin) < 300.0);
+    assert(guarded.stats().pending == 1);
+    // the stalled call returns late, then the kept profile gets applied
+    blocking->setResponding(true);
+    caller.join();
+    begin = std::chrono::steady_clock::now();
+    while (guarded.stats().recovered < 1 && elapsed_ms(begin) < 1000.0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    assert(guarded.stats().recovered == 1);
+    assert(blocking->applied()[0] == profile);
+  }
+
+  {
+    // the probe gets preempted before it reaches the backend, the breaker
+    // doesn't stay half_open and the profile is kept for the next probe
+    auto stalled = std::make_shared<StallingBackend>();
+    GuardedBackend guarded(stalled, std::chrono::milliseconds(30), conf);
+    stalled->setResponding(false);
+    for (int i = 0; i < 2; i++) {
+      applied = guarded.setIccFromData(profile.data(), profile.size(), 0);
+      assert(!applied);
+    }
+    assert(guarded.stats().breaker.state == breaker_state::open);
+    profile.assign(128, 60);
+    applied = guarded.setIccFromData(profile.data(), profile.size(), 0);
+    assert(!applied);
+    guarded.prepareUpdate(0);
+    cancelled = guarded.cancelUpdate(0);
+    assert(cancelled);
+    stalled->setResponding(true);
+    begin = std::chrono::steady_clock::now();
+    while (guarded.stats().recovered < 1 && elapsed_ms(begin) < 1000.0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    stats = guarded.stats();
+    assert(stats.recovered == 1 && stats.pending == 0);
+    assert(stats.breaker.state == breaker_state::closed);
+    assert(stalled->applied()[0] == profile);
+  }
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include "ProfileAtlas.h"
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <easylogging++.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <vector>
+INITIALIZE_EASYLOGGINGPP
+
+int main(int argc, char *argv[]) {
+  std::filesystem::path atlas_path =
+      std::filesystem::temp_directory_path() / "test_profile_atlas" /
+      "profiles.atlas";
+  std::filesystem::remove(atlas_path);
+
+  std::vector<uint8_t> blob(3000);
+  for (size_t i = 0; i < blob.size(); i++) {
+    blob[i] = static_cast<uint8_t>(i * 7);
+  }
+
+  {
+    // new atlas, filled with one profile
+    ProfileAtlas atlas(atlas_path);
+    assert(atlas.size() == 0);
+    assert(!atlas.find(1, 500).has_value());
+    bool inserted = atlas.insert(1, 500, blob.data(), blob.size());
+    assert(inserted);
+    inserted = atlas.insert(1, 500, blob.data(), blob.size());
+    assert(!inserted);
+    std::optional<ProfileBlob> found = atlas.find(1, 500);
+    assert(found.has_value());
+    assert(found->size == blob.size());
+    assert(std::memcmp(found->data, blob.data(), blob.size()) == 0);
+  }
+  {
+    // warm restart, profile served from the mapping
+    ProfileAtlas atlas(atlas_path);
+    assert(atlas.size() == 1);
+    std::optional<ProfileBlob> found = atlas.find(1, 500);
+    assert(found.has_value());
+    assert(std::memcmp(found->data, blob.data(), blob.size()) == 0);
+    assert(!atlas.find(2, 500).has_value());
+  }
+  {
+    // corrupt the last byte of the blob
+    std::fstream file(atlas_path,
+                      std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(-1, std::ios::end);
+    file.put(static_cast<char>(~blob.back()));
+  }
+  {
+    // corrupted atlas gets rebuilt
+    ProfileAtlas atlas(atlas_path);
+    assert(atlas.size() == 0);
+    assert(!atlas.find(1, 500).has_value());
+    bool inserted = atlas.insert(1, 500, blob.data(), blob.size());
+    assert(inserted);
+  }
+  {
+    // an offset of the first entry (after the 64 byte header and the ids)
+    // whose end wraps around past UINT64_MAX
+    uint64_t offset = UINT64_MAX - 100;
+    std::fstream file(atlas_path,
+                      std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(64 + 2 * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+  }
+  {
+    // rejected instead of read out of the mapping
+    ProfileAtlas atlas(atlas_path);
+    assert(atlas.size() == 0);
+    assert(!atlas.find(1, 500).has_value());
+  }
+  std::filesystem::remove_all(atlas_path.parent_path());
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,254 @@
+#include "BrightnessTargets.h"
+#include "DisplayFanOut.h"
+#include "PowerPolicy.h"
+#include "ProfileApplier.h"
+#include "ProfileBackend.h"
+#include "ProfileGenerator.h"
+#include "ProfilePipeline.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <easylogging++.h>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+INITIALIZE_EASYLOGGINGPP
+
+/*! \class SlowBackend
+ *  \brief backend taking as long as a colord round trip
+ */
+class SlowBackend : public ProfileBackend {
+public:
+  bool setIccFromData(const uint8_t *data, size_t size,
+                      uint display_device_id = 0) override {
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::lock_guard<std::mutex> lk(_mut);
+    _applied[display_device_id]++;
+    _windows[display_device_id] = {start, std::chrono::steady_clock::now()};
+    _sizes.push_back(size);
+    return size > 0;
+  }
+  std::map<uint, size_t> applied() const {
+    std::lock_guard<std::mutex> lk(_mut);
+    return _applied;
+  }
+  /*! \brief start and end of the last apply per display */
+  std::map<uint, std::pair<std::chrono::steady_clock::time_point,
+                           std::chrono::steady_clock::time_point>>
+  windows() const {
+    std::lock_guard<std::mutex> lk(_mut);
+    return _windows;
+  }
+
+protected:
+  std::map<uint, size_t> _applied;
+  std::map<uint, std::pair<std::chrono::steady_clock::time_point,
+                           std::chrono::steady_clock::time_point>>
+      _windows;
+  std::vector<size_t> _sizes;
+  mutable std::mutex _mut;
+};
+
+/*! \class PreemptibleBackend
+ *  \brief backend with a slow apply, which stops when cancelled, also
+ * before it started
+ */
+class PreemptibleBackend : public ProfileBackend {
+public:
+  bool setIccFromData(const uint8_t *data, size_t size,
+                      uint display_device_id = 0) override {
+    std::unique_lock<std::mutex> lk(_mut);
+    if (_cv.wait_for(lk, std::chrono::milliseconds(100),
+                     [this] { return _cancelled; })) {
+      return false;
+    }
+    _applied++;
+    return true;
+  }
+  void prepareUpdate(uint display_device_id = 0) override {
+    std::lock_guard<std::mutex> lk(_mut);
+    _cancelled = false;
+  }
+  bool cancelUpdate(uint display_device_id = 0) override {
+    {
+      std::lock_guard<std::mutex> lk(_mut);
+      _cancelled = true;
+    }
+    _cv.notify_all();
+    return true;
+  }
+
+protected:
+  bool _cancelled = false;
+  size_t _applied = 0;
+  std::mutex _mut;
+  std::condition_variable _cv;
+};
+
+int main(int argc, char *argv[]) {
+  el::Loggers::setLoggingLevel(el::Level::Warning);
+  auto backend = std::make_shared<SlowBackend>();
+  auto applier = std::make_shared<ProfileApplier>(backend, nullptr);
+  auto targets = std::make_shared<BrightnessTargets>();
+  ProfilePipeline pipeline(applier, targets);
+
+  uint32_t last_level = 0;
+  std::thread runner(
+      [&]() { last_level = pipeline.run(BRIGHTNESS_LEVEL_SCALE); });
+
+  // a burst faster than the backend, most profiles get replaced
+  for (uint32_t level = 0; level <= 200; level += 2) {
+    targets->post(0, level);
+    targets->post(1, level);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  targets->close();
+  runner.join();
+
+  // the latest level always gets applied, every display on its own
+  assert(last_level == 200);
+  std::map<uint, size_t> applied = backend->applied();
+  assert(applied[0] > 0 && applied[0] < 101);
+  assert(applied[1] > 0 && applied[1] < 101);
+  PipelineStats stats = pipeline.stats();
+  assert(stats.applied == applied[0] + applied[1]);
+  assert(stats.generated == stats.applied + stats.dropped);
+  assert(stats.apply_utilization > 0.0 && stats.apply_utilization <= 1.0);
+  assert(stats.generate_utilization <= 1.0);
+
+  {
+    // a newer level preempts the one being applied
+    auto preemptible = std::make_shared<PreemptibleBackend>();
+    auto preempt_applier =
+        std::make_shared<ProfileApplier>(preemptible, nullptr);
+    auto preempt_targets = std::make_shared<BrightnessTargets>();
+    ProfilePipeline preempt_pipeline(preempt_applier, preempt_targets);
+    uint32_t preempt_last = 0;
+    std::thread preempt_runner([&]() {
+      preempt_last = preempt_pipeline.run(BRIGHTNESS_LEVEL_SCALE);
+    });
+    auto begin = std::chrono::steady_clock::now();
+    preempt_targets->post(0, 100);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    preempt_targets->post(0, 200);
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    preempt_targets->close();
+    preempt_runner.join();
+    assert(preempt_last == 200);
+    PipelineStats preempt_stats = preempt_pipeline.stats();
+    assert(preempt_stats.preempted == 1);
+    assert(preempt_stats.applied == 1);
+    // without preemption both would have taken 100 ms each
+    assert(std::chrono::steady_clock::now() - begin <
+           std::chrono::milliseconds(300));
+  }
+
+  {
+    // a fanned out change gets applied to all displays at the same time
+    DisplayFanOut fan_out({0, 1, 2}, {{1, 0.5}, {2, 4.0}});
+    std::map<uint, uint32_t> levels = fan_out.levels(300);
+    assert(levels.size() == 3 && levels[0] == 300 && levels[1] == 150);
+    assert(levels[2] == BRIGHTNESS_LEVEL_SCALE);
+
+    auto fan_out_backend = std::make_shared<SlowBackend>();
+    auto fan_out_applier =
+        std::make_shared<ProfileApplier>(fan_out_backend, nullptr);
+    auto fan_out_targets = std::make_shared<BrightnessTargets>();
+    ProfilePipeline fan_out_pipeline(fan_out_applier, fan_out_targets);
+    std::thread fan_out_runner(
+        [&]() { fan_out_pipeline.run(BRIGHTNESS_LEVEL_SCALE); });
+    fan_out_targets->postBatch(levels);
+    while (fan_out_pipeline.stats().applied < 3) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // the displays got applied at the same time, not one after the other:
+    // every apply started before any of them ended
+    auto windows = fan_out_backend->windows();
+    assert(windows.size() == 3);
+    auto last_start = std::chrono::steady_clock::time_point::min();
+    auto first_end = std::chrono::steady_clock::time_point::max();
+    for (const auto &[display, window] : windows) {
+      last_start = std::max(last_start, window.first);
+      first_end = std::min(first_end, window.second);
+    }
+    assert(last_start < first_end);
+    fan_out_targets->close();
+    fan_out_runner.join();
+    PipelineStats fan_out_stats = fan_out_pipeline.stats();
+    assert(fan_out_stats.displays.size() == 3);
+    for (const auto &[display, display_stats] : fan_out_stats.displays) {
+      assert(display_stats.applied == 1 && display_stats.max_ms >= 19.0);
+    }
+  }
+
+  {
+    // on battery: paced and in coarser steps
+    assert(round_level(123, 10) == 120 && round_level(125, 10) == 130);
+    assert(round_level(999, 10) == BRIGHTNESS_LEVEL_SCALE);
+    assert(round_level(123, 1) == 123);
+
+    auto paced_backend = std::make_shared<SlowBackend>();
+    auto paced_applier =
+        std::make_shared<ProfileApplier>(paced_backend, nullptr);
+    auto paced_targets = std::make_shared<BrightnessTargets>();
+    auto paced_pipeline =
+        std::make_shared<ProfilePipeline>(paced_applier, paced_targets);
+    UpdatePolicy battery = BATTERY_UPDATE_POLICY;
+    battery.min_interval = std::chrono::milliseconds(100);
+    PowerPolicy policy(AC_UPDATE_POLICY, battery);
+    policy.setApplyCallback([paced_pipeline](const UpdatePolicy &current) {
+      paced_pipeline->setMinInterval(current.min_interval);
+      paced_pipeline->setLevelStep(current.level_step);
+    });
+    paced_pipeline->setAppliedCallback(
+        [&policy](const BrightnessTarget &target, bool applied) {
+          policy.countUpdate();
+        });
+    assert(!policy.onBattery() && policy.current().name == "ac");
+    assert(policy.setOnBattery(true) && !policy.setOnBattery(true));
+    assert(policy.current().level_step == 10);
+
+    uint32_t paced_last = 0;
+    std::thread paced_runner(
+        [&]() { paced_last = paced_pipeline->run(BRIGHTNESS_LEVEL_SCALE); });
+    // 300 ms of targets every ms, a batch every 100 ms instead of one per apply
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t level = 0;
+         std::chrono::steady_clock::now() - begin <
+         std::chrono::milliseconds(300);
+         level = (level + 1) % 500) {
+      paced_targets->post(0, level);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    paced_targets->post(0, 503);
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    paced_targets->close();
+    paced_runner.join();
+    assert(paced_last == 500);
+    std::map<uint, size_t> paced_applied = paced_backend->applied();
+    assert(paced_applied[0] >= 2 && paced_applied[0] <= 6);
+    std::array<PolicyStats, 2> policy_stats = policy.stats();
+    assert(policy_stats[0].updates == 0);
+    assert(policy_stats[1].updates == paced_applied[0]);
+    assert(policy_stats[1].active_s > 0.3);
+    std::cout << policy.statsString() << std::endl;
+  }
+
+  // idle exit with the level of the startup
+  auto idle_targets = std::make_shared<BrightnessTargets>();
+  ProfilePipeline idle_pipeline(applier, idle_targets);
+  assert(idle_pipeline.run(123, std::chrono::seconds(1)) == 123);
+
+  std::cout << pipeline.statsString() << std::endl;
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
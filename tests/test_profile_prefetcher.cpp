@@ -0,0 +1,73 @@
+#include "ProfileApplier.h"
+#include "ProfileAtlas.h"
+#include "ProfileGenerator.h"
+#include "ProfilePrefetcher.h"
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <easylogging++.h>
+#include <iostream>
+#include <memory>
+#include <thread>
+INITIALIZE_EASYLOGGINGPP
+
+bool waitForProfile(const ProfileAtlas &atlas, uint32_t level) {
+  for (int i = 0; i < 500; i++) {
+    if (atlas.find(SRGB_BASE_PROFILE_ID, level)) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+int main(int argc, char *argv[]) {
+  std::shared_ptr<ProfileAtlas> atlas = ProfileAtlas::inMemory();
+  auto applier = std::make_shared<ProfileApplier>(nullptr, atlas);
+  ProfilePrefetcher prefetcher(applier, 2);
+  bool started = prefetcher.start();
+  assert(started);
+
+  // no direction yet
+  prefetcher.observe(0, 900);
+  prefetcher.observe(0, 800);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  assert(atlas->size() == 0);
+
+  // same step twice, the next two levels get prefetched
+  prefetcher.observe(0, 700);
+  bool prefetched = waitForProfile(*atlas, 600);
+  assert(prefetched);
+  prefetched = waitForProfile(*atlas, 500);
+  assert(prefetched);
+  assert(!atlas->find(SRGB_BASE_PROFILE_ID, 400));
+
+  prefetcher.observe(0, 600);
+  prefetched = waitForProfile(*atlas, 400);
+  assert(prefetched);
+  // the profile is in the atlas before the thread counts it, joined it is
+  // done and the queue is empty by then
+  bool stopped = prefetcher.stop();
+  assert(stopped);
+  PrefetchStats stats = prefetcher.stats();
+  assert(stats.observed == 4);
+  assert(stats.prefetched == 3);
+  assert(stats.hits == 1);
+  assert(stats.wasted == 2);
+  started = prefetcher.start();
+  assert(started);
+
+  // other displays have their own history, no prediction beyond the scale
+  prefetcher.observe(1, BRIGHTNESS_LEVEL_SCALE - 200);
+  prefetcher.observe(1, BRIGHTNESS_LEVEL_SCALE - 100);
+  prefetcher.observe(1, BRIGHTNESS_LEVEL_SCALE);
+  stopped = prefetcher.stop();
+  assert(stopped);
+  stopped = prefetcher.stop();
+  assert(!stopped);
+  assert(prefetcher.stats().prefetched == 3);
+
+  std::cout << prefetcher.statsString() << std::endl;
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include "ColordHandler.h"
+#include "GHandles.h"
+#include "MockColord.h"
+#include "ProfileGenerator.h"
+#include "SealedProfile.h"
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <easylogging++.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+INITIALIZE_EASYLOGGINGPP
+
+// -----------------Helper  functions----------------
+/*! \brief content of the file colord got as Filename of the profile */
+std::vector<uint8_t> read_filename(MockColord &mock,
+                                   const std::string &object_path) {
+  std::ifstream file(mock.profile(object_path).filename, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                              std::istreambuf_iterator<char>());
+}
+// -------------------------------------
+
+int main(int argc, char *argv[]) {
+  std::vector<uint8_t> icc(4096);
+  for (size_t i = 0; i < icc.size(); i++) {
+    icc[i] = i % 251;
+  }
+
+  // sealed locally
+  {
+    SealedProfile sealed("test_sealed_profile", icc.data(), icc.size());
+    assert(sealed.fd() >= 0);
+    assert((fcntl(sealed.fd(), F_GET_SEALS) & SEALED_PROFILE_SEALS) ==
+           SEALED_PROFILE_SEALS);
+    uint8_t byte = 0;
+    ssize_t written = pwrite(sealed.fd(), &byte, 1, 0);
+    int write_errno = errno;
+    assert(written < 0 && write_errno == EPERM);
+    int truncated = ftruncate(sealed.fd(), 0);
+    int truncate_errno = errno;
+    assert(truncated != 0 && truncate_errno == EPERM);
+    void *mapping =
+        mmap(NULL, icc.size(), PROT_WRITE, MAP_SHARED, sealed.fd(), 0);
+    assert(mapping == MAP_FAILED);
+    // readable through the path set as Filename
+    std::vector<uint8_t> content(icc.size());
+    int path_fd = open(sealed.path().c_str(), O_RDONLY | O_CLOEXEC);
+    ssize_t read_size = pread(path_fd, content.data(), content.size(), 0);
+    assert(read_size == static_cast<ssize_t>(icc.size()));
+    close(path_fd);
+    assert(content == icc);
+  }
+
+  // passed to the mock colord on a private bus
+  GTestDBus *bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+  g_test_dbus_up(bus);
+  {
+    MockColord mock(g_test_dbus_get_bus_address(bus));
+    GErrorHandle error;
+    GDBusConnectionHandle connection(g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(bus),
+        static_cast<GDBusConnectionFlags>(
+            G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+            G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        NULL, NULL, error.out()));
+    assert(connection);
+
+    SealedProfile sealed("test_sealed_profile", icc.data(), icc.size());
+    std::optional<std::string> object_path = create_profile_with_fd(
+        connection.get(), "icc-mock", CD_OBJECT_SCOPE_TEMP, sealed.fd(),
+        sealed.path(), NULL, error.out());
+    assert(object_path == std::string(MOCK_PROFILE_PATH "0"));
+    assert(mock.calls() == 1);
+    MockCall call = mock.lastCall();
+    assert(call.with_fd);
+    assert(call.profile_id == "icc-mock");
+    assert(call.scope == "temp");
+    assert(call.filename == sealed.path().string());
+    assert((call.seals & SEALED_PROFILE_SEALS) == SEALED_PROFILE_SEALS);
+    assert(call.content == icc);
+    assert(call.write_refused);
+    assert(call.truncate_refused);
+
+    // a cancelled call reports the cancellation, like colord's client
+    GCancellableHandle cancellable(g_cancellable_new());
+    g_cancellable_cancel(cancellable.get());
+    object_path = create_profile_with_fd(
+        connection.get(), "icc-mock", CD_OBJECT_SCOPE_TEMP, sealed.fd(),
+        sealed.path(), cancellable.get(), error.out());
+    assert(!object_path);
+    assert(g_error_matches(error.get(), G_IO_ERROR, G_IO_ERROR_CANCELLED));
+  }
+
+  // through ColordHandler, libcolord looks for colord on the system bus
+  setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(bus), 1);
+  {
+    std::vector<uint8_t> half = generate_srgb_profile_data(0.5);
+    std::vector<uint8_t> dim = generate_srgb_profile_data(0.3);
+    MockColord mock(g_test_dbus_get_bus_address(bus), 2);
+    ColordHandler handler("test_sealed_profile");
+    bool sealed_used = handler.useSealedProfiles();
+    assert(sealed_used);
+    bool discovered = handler.discoverDisplayDevices();
+    assert(discovered && handler.displayDeviceCount() == 2);
+
+    bool applied = handler.setIccFromData(half.data(), half.size(), 0);
+    assert(applied);
+    assert(mock.calls() == 1);
+    MockCall call = mock.lastCall();
+    assert(call.with_fd && call.content == half);
+    assert((call.seals & SEALED_PROFILE_SEALS) == SEALED_PROFILE_SEALS);
+    assert(call.write_refused && call.truncate_refused);
+    // the display took over the sealed fd, its path still reads the profile
+    std::string shared = mock.deviceProfiles(0).front();
+    assert(read_filename(mock, shared) == half);
+
+    // the same level on another display shares the profile, also if colord
+    // only reports it once the creation failed with "already exists"
+    mock.failNextFinds(1);
+    applied = handler.setIccFromData(half.data(), half.size(), 1);
+    assert(applied);
+    assert(mock.calls() == 1);
+    assert(mock.deviceProfiles(1) == std::vector<std::string>{shared});
+    applied = handler.setIccFromData(half.data(), half.size(), 1);
+    assert(applied && mock.calls() == 1);
+
+    // a new level gets a new sealed fd, the shared profile stays on the
+    // other display
+    applied = handler.setIccFromData(dim.data(), dim.size(), 0);
+    assert(applied);
+    assert(mock.calls() == 2 && mock.lastCall().content == dim);
+    std::vector<std::string> profiles = mock.deviceProfiles(0);
+    assert(profiles.size() == 1 && profiles.front() != shared);
+    assert(read_filename(mock, profiles.front()) == dim);
+    assert(mock.deviceProfiles(1) == std::vector<std::string>{shared});
+  }
+  g_test_dbus_down(bus);
+  g_object_unref(bus);
+
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
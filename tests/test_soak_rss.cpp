@@ -0,0 +1,142 @@
+#include "ColordHandler.h"
+#include "GHandles.h"
+#include "MockColord.h"
+#include "ProfileApplier.h"
+#include "ProfileGenerator.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <easylogging++.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+INITIALIZE_EASYLOGGINGPP
+
+// every update is a few round trips to the mock colord
+#define DEFAULT_UPDATES 20000
+#define WARMUP_UPDATES 1500
+#define EDID_UPDATE_INTERVAL 100
+#define MAX_RSS_GROWTH_KB (16 * 1024)
+
+/*! \class SoakHandler
+ *  \brief ColordHandler with the profile from the edid reachable
+ */
+class SoakHandler : public ColordHandler {
+public:
+  using ColordHandler::ColordHandler;
+  using ColordHandler::createIccFromEdid;
+};
+
+// -----------------Helper  functions----------------
+long rssKb() {
+  std::ifstream statm("/proc/self/statm");
+  long size = 0, resident = 0;
+  statm >> size >> resident;
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/*! \brief edid with the primaries of sRGB and a gamma of 2.2 */
+void writeEdid(const std::filesystem::path &path) {
+  std::vector<uint8_t> edid(128, 0);
+  const uint8_t header[] = {0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00};
+  std::copy(std::begin(header), std::end(header), edid.begin());
+  edid[0x12] = 1; // version 1.4
+  edid[0x13] = 4;
+  edid[0x17] = 120; // gamma * 100 - 100
+  const uint8_t chromaticity[] = {0xee, 0x91, 0xa3, 0x54, 0x4c,
+                                  0x99, 0x26, 0x0f, 0x50, 0x54};
+  std::copy(std::begin(chromaticity), std::end(chromaticity),
+            edid.begin() + 0x19);
+  uint8_t sum = 0;
+  for (size_t i = 0; i < 127; i++) {
+    sum += edid[i];
+  }
+  edid[127] = static_cast<uint8_t>(256 - sum);
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(edid.data()), edid.size());
+}
+
+/*! \brief profile from the edid, serialized by libcolord and applied like
+ * the generated ones
+ */
+bool applyEdidProfile(SoakHandler &handler,
+                      const std::filesystem::path &edid_path) {
+  CdIccHandle icc = handler.createIccFromEdid(edid_path);
+  if (!icc) {
+    return false;
+  }
+  GErrorHandle error;
+  GBytesHandle data(
+      cd_icc_save_data(icc.get(), CD_ICC_SAVE_FLAGS_NONE, error.out()));
+  if (!data) {
+    return false;
+  }
+  gsize size = 0;
+  const uint8_t *bytes =
+      static_cast<const uint8_t *>(g_bytes_get_data(data.get(), &size));
+  return handler.setIccFromData(bytes, size, 0);
+}
+// -------------------------------------
+
+int main(int argc, char *argv[]) {
+  el::Loggers::setLoggingLevel(el::Level::Warning);
+  long updates = argc > 1 ? std::atol(argv[1]) : DEFAULT_UPDATES;
+  assert(updates > WARMUP_UPDATES);
+  std::filesystem::path edid_path =
+      std::filesystem::temp_directory_path() / "test_soak_rss.edid";
+  writeEdid(edid_path);
+
+  GTestDBus *bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+  g_test_dbus_up(bus);
+  // libcolord looks for colord on the system bus
+  setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(bus), 1);
+  int result = 0;
+  {
+    // the mock keeps every profile, after the warmup one per level exists
+    MockColord mock(g_test_dbus_get_bus_address(bus));
+    auto handler = std::make_shared<SoakHandler>("test_soak_rss");
+    bool discovered = handler->discoverDisplayDevices();
+    assert(discovered);
+    // no atlas, every update generates a new profile
+    ProfileApplier applier(handler, nullptr);
+
+    long baseline_kb = 0;
+    long applied = 0;
+    for (long i = 0; i < updates && result == 0; i++) {
+      uint32_t level = i % (BRIGHTNESS_LEVEL_SCALE + 1);
+      bool ok = i % EDID_UPDATE_INTERVAL == 0
+                    ? applyEdidProfile(*handler, edid_path)
+                    : applier.apply(level);
+      if (!ok) {
+        std::cout << "Update " << i << " failed!" << std::endl;
+        result = -1;
+      }
+      applied += ok;
+      if (i + 1 == WARMUP_UPDATES) {
+        baseline_kb = rssKb();
+      }
+    }
+    long growth_kb = rssKb() - baseline_kb;
+
+    std::cout << "Applied " << applied << " profiles through colord, RSS "
+              << "growth " << growth_kb << " kB (bound " << MAX_RSS_GROWTH_KB
+              << " kB)" << std::endl;
+    if (result == 0 && growth_kb > MAX_RSS_GROWTH_KB) {
+      std::cout << "RSS grew beyond the bound, leak?" << std::endl;
+      result = -1;
+    }
+  }
+  g_test_dbus_down(bus);
+  g_object_unref(bus);
+  std::filesystem::remove(edid_path);
+
+  if (result == 0) {
+    std::cout << "Success!" << std::endl;
+  }
+  return result;
+}
@@ -0,0 +1,75 @@
+#include "ThreadScheduling.h"
+#include <algorithm>
+#include <cassert>
+#include <easylogging++.h>
+#include <iostream>
+#include <optional>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+INITIALIZE_EASYLOGGINGPP
+
+int main(int argc, char *argv[]) {
+  // parsing
+  assert(parse_thread_role("apply") == thread_role::apply);
+  assert(!parse_thread_role("colord").has_value());
+
+  std::optional<ThreadScheduling> nice = parse_thread_scheduling("other:5");
+  assert(nice && nice->policy == SCHED_OTHER && nice->nice == 5);
+  assert(nice->cpus.empty());
+  std::optional<ThreadScheduling> fifo =
+      parse_thread_scheduling("fifo:10@0-2,5");
+  assert(fifo && fifo->policy == SCHED_FIFO && fifo->priority == 10);
+  assert((fifo->cpus == std::vector<int>{0, 1, 2, 5}));
+  assert(thread_scheduling_string(fifo.value()) == "fifo:10@0,1,2,5");
+  std::optional<ThreadScheduling> rr = parse_thread_scheduling("rr");
+  assert(rr && rr->policy == SCHED_RR && rr->priority > 0);
+  assert(parse_thread_scheduling("other")->nice == std::nullopt);
+  assert(!parse_thread_scheduling("other:-21").has_value());
+  assert(!parse_thread_scheduling("fifo:100").has_value());
+  assert(!parse_thread_scheduling("fifo:1x").has_value());
+  assert(!parse_thread_scheduling("idle").has_value());
+  assert(!parse_thread_scheduling("other@3-1").has_value());
+  assert(!parse_thread_scheduling("other@").has_value());
+
+  // a role without a scheduling keeps the inherited one
+  std::thread([]() {
+    bool applied = apply_thread_scheduling(thread_role::generator);
+    assert(applied);
+    assert(sched_getscheduler(0) == SCHED_OTHER);
+  }).join();
+
+  // a higher nice value than the one the test runs with and the first cpu,
+  // both allowed without privileges
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  int got_affinity = sched_getaffinity(0, sizeof(allowed), &allowed);
+  assert(got_affinity == 0);
+  int first_cpu = 0;
+  while (first_cpu < CPU_SETSIZE - 1 && !CPU_ISSET(first_cpu, &allowed)) {
+    first_cpu++;
+  }
+  int main_nice = getpriority(PRIO_PROCESS, syscall(SYS_gettid));
+  ThreadScheduling watcher = nice.value();
+  watcher.nice = std::min(main_nice + 5, 19);
+  watcher.cpus = {first_cpu};
+  set_thread_scheduling(thread_role::watcher, watcher);
+  std::thread([&]() {
+    bool applied = apply_thread_scheduling(thread_role::watcher);
+    assert(applied);
+    assert(getpriority(PRIO_PROCESS, syscall(SYS_gettid)) == watcher.nice);
+    cpu_set_t cpus;
+    int got_cpus =
+        pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    assert(got_cpus == 0);
+    assert(CPU_COUNT(&cpus) == 1 && CPU_ISSET(first_cpu, &cpus));
+  }).join();
+  // only the thread, not the process
+  assert(getpriority(PRIO_PROCESS, syscall(SYS_gettid)) == main_nice);
+
+  std::cout << "Success!" << std::endl;
+  return 0;
+}